@@ -23,18 +23,38 @@
 #include "lwip/pbuf.h"           // Manipulao de buffers de pacotes IP
 #include "lwip/tcp.h"            // Implementao do protocolo TCP
 #include "lwip/netif.h"          // Funes de interface de rede
+#include "lwip/apps/fs.h"        // Arquivos da interface web gravados na flash
 
 #include "hardware/i2c.h"        // Interface I2C
 #include "inc/ssd1306.h"         // Driver para display OLED
 #include "inc/font.h"            // Definies de fontes para o display
 #include "hardware/pio.h"        // Funes de I/O programvel
 #include "hardware/clocks.h"     // Funes de controle de clock
+#include "hardware/pwm.h"        // PWM para a sirene do alarme
 #include "animacoes_led.pio.h"   // Programa PIO para animaes de LED
+#include "inc/energia.h"         // Modo ocioso de baixo consumo
+#include "inc/fila_comandos.h"   // Fila de comandos da rede para o lao principal
+#include "inc/histograma.h"      // Histogramas de latncia
+#include "inc/servidor_http.h"   // Servidor HTTP (lwIP raw API)
+#include "inc/espelho_display.h" // Cpia remota do OLED
+#include "inc/controle_udp.h"     // Comandos em lote por UDP
+#include "inc/cenas.h"            // Cenas (estado alvo de vrios dispositivos)
+#include "inc/regras.h"           // Motor de regras de automao
+#include "inc/ponto_fixo.h"       // Converses dos sensores sem ponto flutuante
+#include "inc/pilha.h"            // Uso de pilha por pintura
+#include "inc/supervisor.h"       // Prazos das tarefas sobre o watchdog
+#include "inc/gravacao.h"         // Gravao das entradas para reproduo no host
+#include "inc/replicacao.h"       // Estados replicados entre as placas por multicast
+#include "inc/barramento_i2c.h"   // Fila de transaes I2C em segundo plano
 
 // Credenciais da rede WiFi - Cuidado ao compartilhar publicamente!
 #define WIFI_SSID "******"
 #define WIFI_PASSWORD "********"
 
+// Chave (16 bytes) do protocolo de controle UDP, compartilhada com o controlador
+// e com as outras placas da casa (replicao)
+#define CHAVE_CONTROLE "****************"
+
 /* ========== DEFINIES DE HARDWARE ========== */
 
 // Configurao da matriz de LEDs
@@ -45,6 +65,13 @@
 #define I2C_PORT i2c1           // Porta I2C utilizada
 #define I2C_SDA 14              // Pino SDA
 #define I2C_SCL 15              // Pino SCL
+// 1: Fast-mode Plus (1 MHz), s com pull-ups externos de ~2,2 kohm em SDA e SCL
+// e todos os dispositivos do barramento especificados para ele (o SSD1306
+//  para 400 kHz). Bordas lentas corrompem bits sem disparar a queda.
+#ifndef I2C_FAST_MODE_PLUS
+#define I2C_FAST_MODE_PLUS 0
+#endif
+#define I2C_FREQUENCIA (I2C_FAST_MODE_PLUS ? BARRAMENTO_I2C_FAST_MODE_PLUS_HZ : BARRAMENTO_I2C_FAST_MODE_HZ)
 #define ENDERECO 0x3C           // Endereo I2C do display
 #define WIDTH 128               // Largura do display em pixels
 #define HEIGHT 64               // Altura do display em pixels
@@ -63,8 +90,12 @@
 // Pinos para o sensor ultrassnico do Alarme
 #define TRIG_PIN_2 18              // Pino de trigger do sensor
 #define ECHO_PIN_2 19              // Pino de echo do sensor
+#define ECO_TEMPO_MAXIMO_US 30000  // Espera mxima por cada borda do eco (~5 m)
 
 #define BUZZER 21                  // Pino do buzzer
+#define FREQ_SIRENE 2500           // Frequncia do bip em Hz
+#define BIP_MS 80                  // Durao de cada bip
+#define INTERVALO_BIP_MS 50        // Intervalo entre bipes
 
 // Pino para o sensor de luz (LDR)
 #define ldr_pin 16
@@ -74,6 +105,11 @@
 #define ADC_JOYSTICK_Y 27  // Pino ADC para eixo Y
 
 #define Botao_A 5          // pino do boto A
+#define Botao_B 6          // pino do boto B (prxima cena)
+
+// Oramento de tempo das etapas do lao (as tarefas tm o seu na tabela)
+#define ORCAMENTO_COMANDOS_MS 1000     // Inclui gravar as cenas na flash
+#define ORCAMENTO_ATUALIZACAO_MS 250   // Matriz e a espera pelo quadro anterior do OLED
 
 // Variveis globais para controle dos dispositivos
 PIO pio;                       // Controlador PIO
@@ -94,28 +130,258 @@ bool estado_display = false;
 bool estado_alarme = false;
 bool Alarme_Acionado = false;
 
+// Comandos recebidos pela rede, aplicados pelo lao principal
+enum {
+    COMANDO_LUZ_SALA,
+    COMANDO_LUZ_COZINHA,
+    COMANDO_LUZ_QUARTO,
+    COMANDO_LUZ_BANHEIRO,
+    COMANDO_LUZ_QUINTAL,
+    COMANDO_DISPLAY,
+    COMANDO_ALARME,
+    COMANDO_LED_ON,
+    COMANDO_LED_OFF,
+    COMANDO_CENA,
+};
+
+fila_comandos_t fila_rede;          // Callbacks lwIP -> lao principal
+histograma_t latencia_comando;      // Comando enfileirado -> aplicado
+histograma_t tempo_cena;            // CPU para aplicar uma cena
+histograma_t tempo_atualizacao;     // Atualizao da matriz e do display
+int cena_botao = -1;                // ltima cena escolhida pelo boto B
+volatile bool cena_botao_pendente = false; // Boto B pressionado, cena ainda no aplicada
+
+// Profundidade de pilha de cada etapa do lao e do handler dos botes
+PILHA_PONTO(pilha_comandos, "comandos");
+PILHA_PONTO(pilha_tarefas, "tarefas");
+PILHA_PONTO(pilha_atualizacao, "atualizacao");
+PILHA_PONTO(pilha_botoes, "botoes");
+
+int supervisao_comandos = -1;       // Etapas do lao no supervisor
+int supervisao_atualizacao = -1;
+
+int32_t temperatura_atual = 0;      // ltima leitura do sensor interno (centsimos de C)
+bool sirene_ativa = false;          // Sirene tocando (controlada por alarme de timer)
+bool sirene_bip = false;            // Fase atual da sirene (bip ou intervalo)
+uint16_t nivel_sirene = 0;          // Nvel PWM para 50% de ciclo
+
+// Tags SSI da pgina (web/index.shtml), na ordem dos ndices abaixo
+enum {
+    SSI_TEMPERATURA,
+    SSI_SALA,
+    SSI_COZINHA,
+    SSI_QUARTO,
+    SSI_BANHEIRO,
+    SSI_QUINTAL,
+    SSI_TV,
+    SSI_ALARME,
+    SSI_ACIONADO,
+    SSI_CENAS,
+};
+
+// De "sala" a "alarme", os nomes seguem a ordem dos bits de estado_palavra()
+// e tambm identificam os dispositivos nas cenas
+const char *const tags_ssi[] = {
+    "temp", "sala", "cozinha", "quarto", "banheiro", "quintal", "tv", "alarme", "acionado", "cenas",
+};
+
+// Prazo para apagar as mensagens de desligamento do display (nil_time = nenhum)
+absolute_time_t prazo_limpar_display;
+
+// Tarefas peridicas do lao principal, executadas quando o prazo vence
+typedef struct {
+    const char *nome;
+    uint32_t periodo_ms;
+    void (*executar)(void);
+    uint32_t orcamento_ms;     // Tempo mximo por execuo (supervisor)
+    absolute_time_t proximo;
+    int supervisao;            // ndice no supervisor
+} tarefa_t;
+
 /* ========== PROTTIPOS DE FUNES ========== */
 void gpio_led_bitdog(void);    // Inicializa os GPIOs dos LEDs
-static err_t tcp_server_accept(void *arg, struct tcp_pcb *newpcb, err_t err); // Callback para conexes TCP
-static err_t tcp_server_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err); // Callback para recebimento de dados
-float temp_read(void);         // L a temperatura interna
-void user_request(char **request); // Processa as requisies do usurio
+int32_t temp_read(void);       // L a temperatura interna (centsimos de C)
+resultado_requisicao_t user_request(char **request); // Processa as requisies do usurio
 void ligar_luz();              // Controla a matriz de LEDs
 void ligar_display();          // Controla o display OLED
 void send_trigger_pulse();     // Envia pulso para o sensor ultrassnico
-float measure_distance_cm();   // Mede a distncia com o sensor ultrassnico
-void luz_frente_controlada();  // Controla os LEDs frontais baseado em sensores
-void Alarme();
+uint32_t measure_distance_mm(uint trigger_pin, uint echo_pin); // Mede a distncia com o sensor ultrassnico
 void Som_Alarme();
 void gpio_irq_handler(uint gpio, uint32_t events);
+uint32_t estado_palavra(void); // Empacota os estados dos dispositivos
+void definir_estados(uint32_t palavra); // Desempacota a palavra de estados
+void limpar_display(void);     // Apaga as mensagens de desligamento
+void enviar_display(void);     // Atualiza o OLED e o espelho remoto
+void imprimir_energia(void);   // Imprime o relatrio de energia
+void verificar_pilha(void);    // Imprime o uso de pilha ao passar do limiar
+int iniciar_gravacao(char *buf, size_t tamanho); // Comea a gravao das entradas
+int parar_gravacao(char *buf, size_t tamanho);   // Encerra a gravao das entradas
+uint16_t ler_adc(uint canal);  // L um canal do ADC (entra na gravao)
+absolute_time_t executar_tarefas(void); // Executa as tarefas vencidas
+void atualizar_temperatura(void); // L o sensor de temperatura para o cache
+void processar_comandos(void); // Aplica os comandos enfileirados pela rede
+void aplicar_cena(int indice); // Aplica uma cena numa nica transio
+int latencia_relatorio(char *buf, size_t tamanho); // Resumo das latncias
+static u16_t tratar_ssi(int indice, char *destino, int tamanho); // Valores das tags SSI
+
+tarefa_t tarefas[] = {
+    {"regras", 100, regras_avaliar, 250},         // At dois ultrassnicos sem eco (60 ms cada)
+    {"temperatura", 1000, atualizar_temperatura, 20},
+    {"energia", 3600000, imprimir_energia, 100},
+    {"pilha", 10000, verificar_pilha, 100},
+    {"gravacao", 100, gravacao_descarregar, 1000},  // printf espera pelo USB
+    {"replicacao", 100, replicacao_rodada, 500},    // Apaga o setor das pocas a cada 512 gravaes
+    {"i2c", 100, barramento_i2c_vigiar, 5},
+};
+
+// Cada tarefa e as etapas "comandos" e "atualizacao" ocupam uma vaga no supervisor
+_Static_assert(count_of(tarefas) + 2 <= SUPERVISOR_MAX_TAREFAS, "aumente SUPERVISOR_MAX_TAREFAS");
+
+// Rotas de diagnstico respondidas em texto simples
+const rota_texto_t rotas_texto[] = {
+    {"GET /energia", energia_relatorio},
+    {"GET /latencia", latencia_relatorio},
+    {"GET /memoria", servidor_http_memoria},
+    {"GET /udp", controle_udp_relatorio},
+    {"GET /cenas", cenas_relatorio},
+    {"GET /regras", regras_relatorio},
+    {"GET /pilha", pilha_relatorio},
+    {"GET /supervisor", supervisor_relatorio},
+    {"GET /gravacao/iniciar", iniciar_gravacao},
+    {"GET /gravacao/parar", parar_gravacao},
+    {"GET /gravacao", gravacao_relatorio},
+    {"GET /replicacao", replicacao_relatorio},
+    {"GET /i2c", barramento_i2c_relatorio},
+#if PONTO_FIXO_MEDIR
+    {"GET /ponto_fixo", ponto_fixo_relatorio},
+#endif
+};
+
+// Rotas que alteram o estado de um dispositivo
+typedef struct {
+    const char *caminho;
+    uint8_t comando;
+} rota_comando_t;
+
+const rota_comando_t rotas_comando[] = {
+    {"GET /mudar_estado_luz_sala", COMANDO_LUZ_SALA},
+    {"GET /mudar_estado_luz_cozinha", COMANDO_LUZ_COZINHA},
+    {"GET /mudar_estado_luz_quarto", COMANDO_LUZ_QUARTO},
+    {"GET /mudar_estado_luz_banheiro", COMANDO_LUZ_BANHEIRO},
+    {"GET /mudar_estado_luz_quintal", COMANDO_LUZ_QUINTAL},
+    {"GET /mudar_estado_display", COMANDO_DISPLAY},
+    {"GET /mudar_estado_alarme", COMANDO_ALARME},
+    {"GET /on", COMANDO_LED_ON},
+    {"GET /off", COMANDO_LED_OFF},
+};
+
+// Espelho do OLED: quadro nico ou fluxo de deltas (web/display.html)
+const rota_binaria_t rotas_binarias[] = {
+    {"/display", "application/octet-stream", espelho_codificar, false},
+    {"/display/fluxo", "application/octet-stream", espelho_codificar, true},
+};
+
+// Entradas e sadas do motor de regras, na ordem dos ndices do bytecode
+enum {
+    ENTRADA_ESCURO,
+    ENTRADA_DIST_FRENTE,
+    ENTRADA_DIST_ALARME,
+    ENTRADA_EIXO_X,
+    ENTRADA_EIXO_Y,
+    ENTRADA_ALARME,
+};
+
+enum {
+    SAIDA_LUZ_FRENTE,
+    SAIDA_ALARME,
+};
+
+int32_t ler_escuro(void);
+int32_t ler_dist_frente(void);
+int32_t ler_dist_alarme(void);
+int32_t ler_eixo_x(void);
+int32_t ler_eixo_y(void);
+int32_t ler_alarme_ligado(void);
+void escrever_luz_frente(bool ativa);
+void acionar_alarme(bool ativa);
+bool alarme_acionado(void);
+
+// Os ultrassnicos bloqueiam o lao durante a medio: s so disparados
+// quando uma regra chega a eles
+const entrada_regra_t entradas_regras[] = {
+    {"escuro", ler_escuro, false, 0},
+    {"dist_frente", ler_dist_frente, true, 0},
+    {"dist_alarme", ler_dist_alarme, true, 0},
+    {"eixo_x", ler_eixo_x, false, 32},
+    {"eixo_y", ler_eixo_y, false, 32},
+    {"alarme", ler_alarme_ligado, false, 0},
+};
+
+const saida_regra_t saidas_regras[] = {
+    {"luz_frente", escrever_luz_frente, NULL},
+    {"alarme", acionar_alarme, alarme_acionado},
+};
+
+// Constante de 16 bits do bytecode (little-endian)
+#define K16(v) OP_CONST, (uint8_t)((v) & 0xFF), (uint8_t)(((v) >> 8) & 0xFF)
+
+// Regras de fbrica; fonte em tools/regras_padrao.txt (tools/regras.py gera
+// a mesma tabela)
+const uint8_t regras_padrao[] = {
+    'R', REGRAS_VERSAO, 2,
+    // luz_frente seguir: escuro && dist_frente < 15
+    SAIDA_LUZ_FRENTE, REGRA_SEGUIR, 10,
+    OP_ENTRADA, ENTRADA_ESCURO, OP_SE_FALSO, 6,
+    OP_ENTRADA, ENTRADA_DIST_FRENTE, K16(15), OP_MENOR,
+    // alarme acionar: alarme && (eixo_x < 1800 || eixo_x > 2200 ||
+    //                            eixo_y < 1800 || eixo_y > 2200 || dist_alarme < 15)
+    SAIDA_ALARME, REGRA_ACIONAR, 42,
+    OP_ENTRADA, ENTRADA_ALARME, OP_SE_FALSO, 38,
+    OP_ENTRADA, ENTRADA_EIXO_X, K16(1800), OP_MENOR, OP_SE_VERDADEIRO, 6,
+    OP_ENTRADA, ENTRADA_EIXO_X, K16(2200), OP_MAIOR, OP_SE_VERDADEIRO, 6,
+    OP_ENTRADA, ENTRADA_EIXO_Y, K16(1800), OP_MENOR, OP_SE_VERDADEIRO, 6,
+    OP_ENTRADA, ENTRADA_EIXO_Y, K16(2200), OP_MAIOR, OP_SE_VERDADEIRO, 6,
+    OP_ENTRADA, ENTRADA_DIST_ALARME, K16(15), OP_MENOR,
+};
+
+const servidor_http_config_t config_http = {
+    .rotas_texto = rotas_texto,
+    .num_rotas_texto = count_of(rotas_texto),
+    .comando = user_request,
+    .ssi = tratar_ssi,
+    .tags_ssi = tags_ssi,
+    .num_tags_ssi = count_of(tags_ssi),
+    .rotas_binarias = rotas_binarias,
+    .num_rotas_binarias = count_of(rotas_binarias),
+};
 
 /* ========== IMPLEMENTAO DAS FUNES ========== */
 
 // Funo principal
 int main() {
+    // Marca a rea livre das pilhas antes de qualquer interrupo da aplicao
+    pilha_pintar();
+
     // Inicializa todas as bibliotecas padro
     stdio_init_all();
 
+    // Inicia a contabilizao de tempo ativo/ocioso
+    energia_init();
+    prazo_limpar_display = nil_time;
+    espelho_init();
+    histograma_limpar(&latencia_comando);
+    histograma_limpar(&tempo_cena);
+    histograma_limpar(&tempo_atualizacao);
+
+    // Cenas gravadas na flash (ou as de fbrica)
+    cenas_iniciar(&tags_ssi[SSI_SALA]);
+
+    // Automao (luz da frente e alarme) pelas regras de fbrica
+    if (!regras_iniciar(entradas_regras, count_of(entradas_regras), saidas_regras, count_of(saidas_regras),
+                        regras_padrao, sizeof(regras_padrao))) {
+        printf("Regras de fbrica invlidas\n");
+    }
+
     // Inicializa os GPIOs dos LEDs
     gpio_led_bitdog();
 
@@ -125,15 +391,13 @@ int main() {
     sm = pio_claim_unused_sm(pio, true);
     animacoes_led_program_init(pio, sm, offset, matriz_leds);
 
-    // Configurao do I2C para o display OLED
-    i2c_init(I2C_PORT, 400 * 1000);  // Inicializa I2C a 400kHz
-    gpio_set_function(I2C_SDA, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL, GPIO_FUNC_I2C);
-    gpio_pull_up(I2C_SDA);
-    gpio_pull_up(I2C_SCL);
+    // Configurao do I2C para o display OLED (e futuros sensores)
+    barramento_i2c_iniciar(I2C_PORT, I2C_SDA, I2C_SCL, I2C_FREQUENCIA);
     
     // Inicializao do display OLED
-    ssd1306_init(&ssd, WIDTH, HEIGHT, false, ENDERECO, I2C_PORT);
+    if (!ssd1306_init(&ssd, WIDTH, HEIGHT, false, ENDERECO, I2C_PORT)) {
+        return -1;
+    }
     ssd1306_config(&ssd);
     ssd1306_send_data(&ssd);
     ssd1306_fill(&ssd, false);  // Limpa o display
@@ -141,6 +405,7 @@ int main() {
 
     // Inicializa a interrupo no boto A
     gpio_set_irq_enabled_with_callback(Botao_A, GPIO_IRQ_EDGE_FALL, true, &gpio_irq_handler);
+    gpio_set_irq_enabled(Botao_B, GPIO_IRQ_EDGE_FALL, true);
 
     // Inicializa o chip WiFi
     while (cyw43_arch_init()) {
@@ -164,52 +429,115 @@ int main() {
     }
     printf("Conectado ao Wi-Fi\n");
 
+    // Modo de economia do CYW43: o rdio dorme entre beacons
+    energia_configurar_wifi(CYW43_AGGRESSIVE_PM);
+
     // Exibe o IP atribudo ao dispositivo
     if (netif_default) {
         printf("IP do dispositivo: %s\n", ipaddr_ntoa(&netif_default->ip_addr));
     }
 
-    // Configura o servidor TCP na porta 80 (HTTP)
-    struct tcp_pcb *server = tcp_new();
-    if (!server) {
-        printf("Falha ao criar servidor TCP\n");
+    // Configura o servidor HTTP na porta 80
+    if (!servidor_http_iniciar(&config_http, 80)) {
         return -1;
     }
+    printf("Servidor ouvindo na porta 80\n");
 
-    // Associa o servidor  porta 80
-    if (tcp_bind(server, IP_ADDR_ANY, 80) != ERR_OK) {
-        printf("Falha ao associar servidor TCP  porta 80\n");
+    // Controle em lote por UDP
+    if (!controle_udp_iniciar((const uint8_t *)CHAVE_CONTROLE, estado_palavra)) {
         return -1;
     }
+    printf("Controle UDP na porta %u\n", CONTROLE_UDP_PORTA);
+
+    // Reincio pelo supervisor: volta aos estados de antes da falha (o
+    // contexto gravado  a palavra de estados), antes que a replicao os
+    // anuncie. O alarme acionado no volta: a sirene s com nova deteco.
+    uint32_t estados_anteriores;
+    if (supervisor_contexto_anterior(&estados_anteriores)) {
+        definir_estados(estados_anteriores);
+        printf("Estados restaurados aps reincio: %02lx\n", (unsigned long)estados_anteriores);
+    }
 
-    // Coloca o servidor em modo de escuta
-    server = tcp_listen(server);
-    tcp_accept(server, tcp_server_accept);
-    printf("Servidor ouvindo na porta 80\n");
+    // Replicao dos estados com as outras placas; sem ela a placa segue sozinha
+    if (replicacao_iniciar((const uint8_t *)CHAVE_CONTROLE, estado_palavra, definir_estados)) {
+        printf("Replicao no grupo %s:%u\n", REPLICACAO_GRUPO, REPLICACAO_PORTA);
+    }
 
     // Inicializa o ADC para leitura de temperatura
     adc_init();
     adc_set_temp_sensor_enabled(true);
 
-    // Loop principal do programa
+    // Supervisor: oramento de cada tarefa e de cada etapa do lao; a partir
+    // daqui o watchdog est ligado
+    for (uint i = 0; i < count_of(tarefas); i++) {
+        tarefas[i].supervisao = supervisor_registrar(tarefas[i].nome, tarefas[i].orcamento_ms);
+        if (tarefas[i].supervisao < 0) {
+            printf("Supervisor sem vaga para a tarefa %s\n", tarefas[i].nome);
+            return -1;
+        }
+    }
+    supervisao_comandos = supervisor_registrar("comandos", ORCAMENTO_COMANDOS_MS);
+    supervisao_atualizacao = supervisor_registrar("atualizacao", ORCAMENTO_ATUALIZACAO_MS);
+    if (supervisao_comandos < 0 || supervisao_atualizacao < 0) {
+        printf("Supervisor sem vaga para as etapas do lao\n");
+        return -1;
+    }
+    supervisor_iniciar(estado_palavra);
+
+    // Gravao das entradas desde o boot, se configurada (inc/gravacao.h)
+    if (GRAVACAO_NA_PARTIDA) {
+        gravacao_iniciar(estado_palavra());
+        controle_udp_gravar_sessao();
+    }
+
+    // Loop principal do programa. A pilha lwIP roda inteira no contexto de
+    // IRQ do CYW43 (threadsafe_background); o lao s aplica os comandos
+    // que os callbacks deixam na fila.
+    uint32_t palavra_exibida = ~0u;
     while (true) {
-        // Controla os LEDs frontais baseado nos sensores
-        luz_frente_controlada();
-        
-        // Atualiza o estado da matriz de LEDs
-        ligar_luz();
-        
-        // Atualiza o display OLED
-        ligar_display();
+        supervisor_alimentar();
+
+        // Aplica os comandos recebidos pela rede
+        supervisor_comecar(supervisao_comandos);
+        pilha_entrar(&pilha_comandos);
+        processar_comandos();
+        pilha_sair(&pilha_comandos);
+        supervisor_terminar(supervisao_comandos);
+
+        // Executa os sensores/alarme cujo prazo venceu
+        pilha_entrar(&pilha_tarefas);
+        absolute_time_t prazo = executar_tarefas();
+        pilha_sair(&pilha_tarefas);
+
+        // Publica as mudanas locais para as outras placas e aplica as delas
+        replicacao_sincronizar();
+
+        // Atualiza a matriz de LEDs e o display somente quando algum estado muda
+        uint32_t palavra = estado_palavra();
+        if (palavra != palavra_exibida) {
+            uint32_t inicio = time_us_32();
+            palavra_exibida = palavra;
+            supervisor_comecar(supervisao_atualizacao);
+            pilha_entrar(&pilha_atualizacao);
+            ligar_luz();
+            ligar_display();
+            pilha_sair(&pilha_atualizacao);
+            supervisor_terminar(supervisao_atualizacao);
+            histograma_registrar(&tempo_atualizacao, time_us_32() - inicio);
+        }
 
-        // Verifica o alarme, e aciona se necessrio
-        Alarme();
-        
-        // Processa eventos de rede
-        cyw43_arch_poll();
-        
-        // Pequena pausa para reduzir uso da CPU
-        sleep_ms(100);
+        // Apaga a mensagem de desligamento depois de exibida por 2 s
+        if (!is_nil_time(prazo_limpar_display)) {
+            if (time_reached(prazo_limpar_display)) {
+                prazo_limpar_display = nil_time;
+                limpar_display();
+            } else if (absolute_time_diff_us(prazo_limpar_display, prazo) > 0) {
+                prazo = prazo_limpar_display;
+            }
+        }
+
+        // Dorme at o prximo prazo ou at um evento (boto, requisio HTTP)
+        energia_dormir_ate(prazo);
     }
 
     // Desliga o WiFi antes de encerrar
@@ -250,9 +578,14 @@ void gpio_led_bitdog(void) {
     gpio_init(ECHO_PIN_2);
     gpio_set_dir(ECHO_PIN_2, GPIO_IN);
 
-    // Inicializao do Buzzer
-    gpio_init(BUZZER);
-    gpio_set_dir(BUZZER, GPIO_OUT);
+    // Inicializao do Buzzer no PWM, em silncio at a sirene ser acionada
+    gpio_set_function(BUZZER, GPIO_FUNC_PWM);
+    uint slice_buzzer = pwm_gpio_to_slice_num(BUZZER);
+    uint32_t wrap = clock_get_hz(clk_sys) / FREQ_SIRENE - 1;
+    pwm_set_wrap(slice_buzzer, wrap);
+    pwm_set_gpio_level(BUZZER, 0);
+    pwm_set_enabled(slice_buzzer, true);
+    nivel_sirene = wrap / 2;
 
     // Configura o sensor de luz (LDR)
     gpio_init(ldr_pin);
@@ -267,6 +600,10 @@ void gpio_led_bitdog(void) {
     gpio_init(Botao_A);
     gpio_set_dir(Botao_A, GPIO_IN);
     gpio_pull_up(Botao_A);
+
+    gpio_init(Botao_B);
+    gpio_set_dir(Botao_B, GPIO_IN);
+    gpio_pull_up(Botao_B);
 }
 
 /* ========== FUNES DE CONTROLE ========== */
@@ -310,6 +647,7 @@ void ligar_luz() {
 // Controla o display OLED
 void ligar_display() {
     bool cor = true;  // Cor branca para o texto
+    bool mudou = false;  // Quadro redesenhado; enviado uma s vez no final
 
     // Limpa e desenha a moldura do display
     ssd1306_fill(&ssd, !cor);
@@ -325,8 +663,7 @@ void ligar_display() {
         ssd1306_draw_string(&ssd, "TELEVISAO ", 30, 30);
         ssd1306_draw_string(&ssd, "LIGADA", 38, 40);
 
-        // Atualiza o display
-        ssd1306_send_data(&ssd);
+        mudou = true;
 
         tv = 1;
     } else {
@@ -338,15 +675,10 @@ void ligar_display() {
         ssd1306_draw_string(&ssd, "TELEVISAO ", 30, 30);
         ssd1306_draw_string(&ssd, "DESLIGADA", 28, 40);
 
-        // Atualiza o display
-        ssd1306_send_data(&ssd);
-
-        sleep_ms(2000);
+        mudou = true;
 
-        ssd1306_fill(&ssd, !cor);
-
-        // Atualiza o display
-        ssd1306_send_data(&ssd);
+        // Agenda o apagamento sem bloquear o lao principal
+        prazo_limpar_display = make_timeout_time_ms(2000);
 
         tv = 0; // para evitar multiplos desligamentos
         }
@@ -360,8 +692,7 @@ void ligar_display() {
         ssd1306_draw_string(&ssd, "ALARME", 35, 30);
         ssd1306_draw_string(&ssd, "LIGADO", 35, 40);
 
-        // Atualiza o display
-        ssd1306_send_data(&ssd);
+        mudou = true;
 
         tv_alarme = 1; // Para evitar multiplos desligamento de alarme
 
@@ -374,8 +705,7 @@ void ligar_display() {
             ssd1306_draw_string(&ssd, "ALARME", 35, 30);    
             ssd1306_draw_string(&ssd, "ACIONADO", 28, 40);
 
-        // Atualiza o display
-        ssd1306_send_data(&ssd);
+        mudou = true;
         }
     } else {
         if (tv_alarme == 1){
@@ -386,19 +716,100 @@ void ligar_display() {
         ssd1306_draw_string(&ssd, "ALARME", 35, 30);
         ssd1306_draw_string(&ssd, "DESLIGADO", 28, 40);
 
-        // Atualiza o display
-        ssd1306_send_data(&ssd);
+        mudou = true;
 
-        sleep_ms(2000);
+        // Agenda o apagamento sem bloquear o lao principal
+        prazo_limpar_display = make_timeout_time_ms(2000);
 
-        ssd1306_fill(&ssd, !cor);
+        tv_alarme = 0; // para no desligar novamente
+        }
+    }
 
-        // Atualiza o display
-        ssd1306_send_data(&ssd);
+    // S o quadro final vai ao OLED (e ao espelho)
+    if (mudou) {
+        enviar_display();
+    }
+}
 
-        tv_alarme = 0; // para no desligar novamente
+// Apaga a mensagem de desligamento, ou redesenha o estado que continua ativo
+void limpar_display(void) {
+    if (estado_display || estado_alarme) {
+        ligar_display();
+        return;
+    }
+    ssd1306_fill(&ssd, false);
+    enviar_display();
+}
+
+// Envia o quadro ao OLED e publica a cpia para os clientes do espelho
+void enviar_display(void) {
+    ssd1306_send_data(&ssd);
+    cyw43_arch_lwip_begin();
+    if (espelho_publicar(ssd.ram_buffer + 1)) {
+        servidor_http_notificar();
+    }
+    cyw43_arch_lwip_end();
+}
+
+// Empacota os estados dos dispositivos numa palavra (um bit por estado)
+uint32_t estado_palavra(void) {
+    return (estado_led_sala     << 0) |
+           (estado_led_cozinha  << 1) |
+           (estado_led_quarto   << 2) |
+           (estado_led_banheiro << 3) |
+           (estado_led_quintal  << 4) |
+           (estado_display      << 5) |
+           (estado_alarme       << 6) |
+           (Alarme_Acionado     << 7);
+}
+
+// Aplica uma palavra de estados; o bit do alarme acionado s  limpo
+// junto com o alarme
+void definir_estados(uint32_t palavra) {
+    estado_led_sala     = palavra & (1u << 0);
+    estado_led_cozinha  = palavra & (1u << 1);
+    estado_led_quarto   = palavra & (1u << 2);
+    estado_led_banheiro = palavra & (1u << 3);
+    estado_led_quintal  = palavra & (1u << 4);
+    estado_display      = palavra & (1u << 5);
+    estado_alarme       = palavra & (1u << 6);
+    if (!estado_alarme) {
+        Alarme_Acionado = false;
+    }
+}
+
+// Executa as tarefas cujo prazo venceu e retorna o prazo mais prximo
+absolute_time_t executar_tarefas(void) {
+    absolute_time_t prazo = at_the_end_of_time;
+    for (uint i = 0; i < count_of(tarefas); i++) {
+        tarefa_t *t = &tarefas[i];
+        if (time_reached(t->proximo)) {
+            supervisor_comecar(t->supervisao);
+            t->executar();
+            supervisor_terminar(t->supervisao);
+            t->proximo = make_timeout_time_ms(t->periodo_ms);
+        }
+        if (absolute_time_diff_us(t->proximo, prazo) > 0) {
+            prazo = t->proximo;
         }
     }
+    return prazo;
+}
+
+// Imprime o relatrio de energia no stdio
+void imprimir_energia(void) {
+    char relatorio[320];
+    energia_relatorio(relatorio, sizeof(relatorio));
+    printf("%s", relatorio);
+}
+
+// Imprime o relatrio de pilha quando uma regio ou ponto passa do limiar
+void verificar_pilha(void) {
+    if (pilha_verificar()) {
+        char relatorio[400];
+        pilha_relatorio(relatorio, sizeof(relatorio));
+        printf("Uso de pilha acima de %d%%:\n%s", PILHA_LIMIAR_AVISO_PCT, relatorio);
+    }
 }
 
 /* ========== FUNES DOS SENSORES ========== */
@@ -418,7 +829,7 @@ void send_trigger_pulse_2() {
 }
 
 // Mede a distncia usando o sensor ultrassnico genrico
-float measure_distance_cm(uint trigger_pin, uint echo_pin) {
+uint32_t measure_distance_mm(uint trigger_pin, uint echo_pin) {
 
     // Envia pulso de trigger
     gpio_put(trigger_pin, 0);
@@ -427,91 +838,112 @@ float measure_distance_cm(uint trigger_pin, uint echo_pin) {
     sleep_us(10);
     gpio_put(trigger_pin, 0);
 
-    // Espera o pino ECHO ficar em HIGH
-    while (gpio_get(echo_pin) == 0);
+    // Espera o pino ECHO ficar em HIGH. Sem sensor ele no sobe: a leitura
+    // vale como sem eco, em vez de prender o lao at o supervisor reiniciar.
+    uint32_t espera = time_us_32();
+    bool subiu = true;
+    while (gpio_get(echo_pin) == 0) {
+        if (time_us_32() - espera > ECO_TEMPO_MAXIMO_US) {
+            subiu = false;
+            break;
+        }
+    }
 
     absolute_time_t start = get_absolute_time();
 
     // Espera o pino ECHO voltar para LOW
-    while (gpio_get(echo_pin) == 1);
+    while (subiu && gpio_get(echo_pin) == 1) {
+        if (absolute_time_diff_us(start, get_absolute_time()) > ECO_TEMPO_MAXIMO_US) {
+            break;
+        }
+    }
 
     absolute_time_t end = get_absolute_time();
-    int64_t pulse_duration = absolute_time_diff_us(start, end);
+    int64_t pulse_duration = subiu ? absolute_time_diff_us(start, end) : ECO_TEMPO_MAXIMO_US;
+    if (pulse_duration > ECO_TEMPO_MAXIMO_US) {
+        pulse_duration = ECO_TEMPO_MAXIMO_US;
+    }
+    gravacao_eco(echo_pin, (uint32_t)pulse_duration);
+
+    // Converte para milmetros
+    return ponto_fixo_distancia_mm((uint32_t)pulse_duration);
+}
 
-    // Converte para centmetros
-    float distance_cm = pulse_duration / 58.0;
 
-    return distance_cm;
+// Entradas do motor de regras
+int32_t ler_escuro(void) {
+    bool nivel = gpio_get(ldr_pin);
+    gravacao_nivel(ldr_pin, nivel);
+    return !nivel;
 }
 
+int32_t ler_dist_frente(void) {
+    return (int32_t)(measure_distance_mm(TRIG_PIN, ECHO_PIN) / 10);
+}
 
-// Controla os LEDs frontais baseado nos sensores
-void luz_frente_controlada() {
-    float dist1 = measure_distance_cm(TRIG_PIN, ECHO_PIN);
-    
-    // Aciona os LEDs se houver objeto prximo e estiver escuro
-    if ((dist1 < 15) && (!gpio_get(ldr_pin))) {
-        gpio_put(LED_BLUE_PIN, 1);
-        gpio_put(LED_GREEN_PIN, 1);
-        gpio_put(LED_RED_PIN, 1);
-    } else {
-        gpio_put(LED_BLUE_PIN, 0);
-        gpio_put(LED_GREEN_PIN, 0);
-        gpio_put(LED_RED_PIN, 0);
-    }
+int32_t ler_dist_alarme(void) {
+    return (int32_t)(measure_distance_mm(TRIG_PIN_2, ECHO_PIN_2) / 10);
 }
 
-/**
- * Gera um som de alerta no Buzzer.
- */
-void Som_Alarme() {
-    const uint buzzer_pin = BUZZER;
-    const int freq = 2500;           // Frequncia em Hz
-    const int duration_ms = 80;      // Durao de cada bip
-    const int interval_ms = 50;      // Intervalo entre bipes
-
-    int period_us = 1000000 / freq;  // Perodo total da onda
-    int half_period_us = period_us / 2;
-
-    for (int i = 0; i < 8; i++) {
-        uint32_t start_time = to_ms_since_boot(get_absolute_time());
-        while (to_ms_since_boot(get_absolute_time()) - start_time < duration_ms) {
-            gpio_put(buzzer_pin, 1);
-            sleep_us(half_period_us);
-            gpio_put(buzzer_pin, 0);
-            sleep_us(half_period_us);
-        }
-        sleep_ms(interval_ms);
-    }
+// Joystick: simula a abertura das portas
+int32_t ler_eixo_x(void) {
+    Eixo_x_value = ler_adc(0);
+    return Eixo_x_value;
 }
 
-// Funo verefica se houve violao em deteco de objetos proximos ou violao das portas, e aciona o alarme
-void Alarme(){
-    // calcula a distncia do objeto ao ultrassnico
-    float dist2 = measure_distance_cm(TRIG_PIN_2, ECHO_PIN_2);
+int32_t ler_eixo_y(void) {
+    Eixo_Y_value = ler_adc(1);
+    return Eixo_Y_value;
+}
 
-    // Leitura dos sensores
-    adc_select_input(0);
-    Eixo_x_value = adc_read();
-    adc_select_input(1);
-    Eixo_Y_value = adc_read();
+int32_t ler_alarme_ligado(void) {
+    return estado_alarme;
+}
 
-    // Caso o alarme esteja ativado, e houver abertura das portas, h o acionamneto do alarme
-    if (estado_alarme){
-        if (((Eixo_Y_value > 2200) || (Eixo_Y_value < 1800)) || ((Eixo_x_value > 2200) || (Eixo_x_value < 1800)))
-    {
-        Alarme_Acionado = true;
-    }
-    // deteco de objetos proximo ultrassnico resulta no acionamento do alarme    
-    if (dist2 < 15){
+// Sadas do motor de regras: LEDs da frente e acionamento do alarme
+void escrever_luz_frente(bool ativa) {
+    gpio_put(LED_BLUE_PIN, ativa);
+    gpio_put(LED_GREEN_PIN, ativa);
+    gpio_put(LED_RED_PIN, ativa);
+}
+
+// O alarme acionado s  liberado ao desligar o alarme
+void acionar_alarme(bool ativa) {
+    if (ativa) {
         Alarme_Acionado = true;
+        Som_Alarme();
     }
+}
 
-    // chama a funco que faz atuao do som no buzzer
-    if (Alarme_Acionado){
-        Som_Alarme();
+bool alarme_acionado(void) {
+    return Alarme_Acionado;
+}
+
+// Alterna entre bip e intervalo; roda no alarme de timer, sem ocupar a CPU
+static int64_t passo_sirene(alarm_id_t id, void *dados) {
+    if (!Alarme_Acionado) {
+        pwm_set_gpio_level(BUZZER, 0);
+        sirene_bip = false;
+        sirene_ativa = false;
+        return 0;
     }
+    sirene_bip = !sirene_bip;
+    pwm_set_gpio_level(BUZZER, sirene_bip ? nivel_sirene : 0);
+    return (sirene_bip ? BIP_MS : INTERVALO_BIP_MS) * 1000;
+}
+
+/**
+ * Gera um som de alerta no Buzzer.
+ * A onda de 2,5 kHz sai do PWM e a cadncia dos bipes  feita por um alarme de
+ * timer, ento a sirene no bloqueia o lao principal. Para sozinha quando o
+ * alarme  desacionado.
+ */
+void Som_Alarme() {
+    if (sirene_ativa) {
+        return;
     }
+    sirene_ativa = true;
+    add_alarm_in_us(0, passo_sirene, NULL, true);
 }
 
 /* ========== HANDLER DE INTERRUPO ========== */
@@ -519,7 +951,9 @@ void Alarme(){
 // Tratamento das interrupes dos botes
 void gpio_irq_handler(uint gpio, uint32_t events) {
     static uint32_t last_time = 0;
+    pilha_entrar(&pilha_botoes);
     uint32_t current_time = to_us_since_boot(get_absolute_time());
+    gravacao_borda(gpio, events, gpio_get(gpio));
 
     // Debouncing de 300ms
     if (current_time - last_time > 300000) {
@@ -531,123 +965,297 @@ void gpio_irq_handler(uint gpio, uint32_t events) {
             if(!estado_alarme){
                 Alarme_Acionado = false;
             }
+
+            // Acorda o lao principal para atualizar matriz e display
+            energia_sinalizar_evento();
+        }
+
+        // Boto B pressionado: o lao principal aplica a prxima cena
+        if (gpio == Botao_B && !gpio_get(Botao_B)) {
+            cena_botao_pendente = true;
+            energia_sinalizar_evento();
         }
     }
+    pilha_sair(&pilha_botoes);
 }
 
 /* ========== FUNES DE REDE ========== */
 
-// Callback para aceitar novas conexes TCP
-static err_t tcp_server_accept(void *arg, struct tcp_pcb *newpcb, err_t err) {
-    tcp_recv(newpcb, tcp_server_recv);
-    return ERR_OK;
+// Rotas da gravao de entradas (contexto lwIP): respondem com o relatrio
+int iniciar_gravacao(char *buf, size_t tamanho) {
+    gravacao_iniciar(estado_palavra());
+    controle_udp_gravar_sessao();
+    return gravacao_relatorio(buf, tamanho);
 }
 
-// Processa as requisies do usurio
-void user_request(char **request) {
-    // Verifica qual comando foi recebido e altera o estado correspondente
-    if (strstr(*request, "GET /mudar_estado_luz_sala") != NULL) {
-        estado_led_sala = !estado_led_sala;
+int parar_gravacao(char *buf, size_t tamanho) {
+    gravacao_parar();
+    return gravacao_relatorio(buf, tamanho);
+}
+
+// Parmetros da rota dada ("GET /cena?nome=noite" -> "noite"); NULL se a
+// requisio  de outra rota
+static const char *consulta_rota(const char *request, const char *rota, size_t *tamanho) {
+    const char *inicio = strstr(request, rota);
+    if (!inicio) {
+        return NULL;
     }
-    else if (strstr(*request, "GET /mudar_estado_luz_cozinha") != NULL) {
-        estado_led_cozinha = !estado_led_cozinha;
+    inicio += strlen(rota);
+    *tamanho = strcspn(inicio, " \r\n");
+    return inicio;
+}
+
+// Processa as requisies do usurio. Executa no contexto lwIP: o comando 
+// apenas enfileirado e aplicado pelo lao principal.
+resultado_requisicao_t user_request(char **request) {
+    size_t tamanho;
+    const char *consulta;
+
+    // Ativao de cena: um nico comando para todos os dispositivos da cena
+    if ((consulta = consulta_rota(*request, "GET /cena?nome=", &tamanho)) != NULL) {
+        int indice = cenas_buscar(consulta, tamanho);
+        if (indice < 0) {
+            return REQUISICAO_SEM_COMANDO;
+        }
+        if (!fila_inserir(&fila_rede, COMANDO_CENA, indice)) {
+            return REQUISICAO_FILA_CHEIA;
+        }
+        energia_sinalizar_evento();
+        return REQUISICAO_ENFILEIRADA;
     }
-    else if (strstr(*request, "GET /mudar_estado_luz_quarto") != NULL) {
-        estado_led_quarto = !estado_led_quarto;
+
+    // Nova tabela de regras, instalada pelo lao principal
+    if ((consulta = consulta_rota(*request, "GET /carregar_regras?t=", &tamanho)) != NULL) {
+        switch (regras_receber(consulta, tamanho)) {
+        case REGRAS_CARGA_ACEITA:
+            energia_sinalizar_evento();
+            return REQUISICAO_ENFILEIRADA;
+        case REGRAS_CARGA_OCUPADA:
+            return REQUISICAO_FILA_CHEIA;
+        case REGRAS_CARGA_INVALIDA:
+            break;
+        }
+        return REQUISICAO_SEM_COMANDO;
     }
-    else if (strstr(*request, "GET /mudar_estado_luz_banheiro") != NULL) {
-        estado_led_banheiro = !estado_led_banheiro;
+
+    // Edio de cena, aplicada e gravada na flash pelo lao principal
+    if ((consulta = consulta_rota(*request, "GET /cena/editar?", &tamanho)) != NULL) {
+        switch (cenas_editar(consulta, tamanho)) {
+        case CENA_EDICAO_ACEITA:
+            energia_sinalizar_evento();
+            return REQUISICAO_ENFILEIRADA;
+        case CENA_EDICAO_OCUPADA:
+            return REQUISICAO_FILA_CHEIA;
+        case CENA_EDICAO_INVALIDA:
+            break;
+        }
+        return REQUISICAO_SEM_COMANDO;
     }
-    else if (strstr(*request, "GET /mudar_estado_luz_quintal") != NULL) {
-        estado_led_quintal = !estado_led_quintal;
+
+    // Verifica qual comando foi recebido e enfileira o correspondente
+    for (uint i = 0; i < count_of(rotas_comando); i++) {
+        if (strstr(*request, rotas_comando[i].caminho) != NULL) {
+            if (!fila_inserir(&fila_rede, rotas_comando[i].comando, 0)) {
+                return REQUISICAO_FILA_CHEIA;
+            }
+            energia_sinalizar_evento();
+            return REQUISICAO_ENFILEIRADA;
+        }
     }
-    else if (strstr(*request, "GET /mudar_estado_display") != NULL) {
+    return REQUISICAO_SEM_COMANDO;
+}
+
+// Altera o estado correspondente a um comando
+void aplicar_comando(const comando_t *comando) {
+    switch (comando->tipo) {
+    case COMANDO_LUZ_SALA:
+        estado_led_sala = !estado_led_sala;
+        break;
+    case COMANDO_LUZ_COZINHA:
+        estado_led_cozinha = !estado_led_cozinha;
+        break;
+    case COMANDO_LUZ_QUARTO:
+        estado_led_quarto = !estado_led_quarto;
+        break;
+    case COMANDO_LUZ_BANHEIRO:
+        estado_led_banheiro = !estado_led_banheiro;
+        break;
+    case COMANDO_LUZ_QUINTAL:
+        estado_led_quintal = !estado_led_quintal;
+        break;
+    case COMANDO_DISPLAY:
         estado_display = !estado_display;
-    }
-    else if (strstr(*request, "GET /mudar_estado_alarme") != NULL) {
+        break;
+    case COMANDO_ALARME:
         estado_alarme = !estado_alarme;
         if(!estado_alarme){
             Alarme_Acionado = false;
         }
-    }
-    else if (strstr(*request, "GET /on") != NULL) {
+        break;
+    case COMANDO_LED_ON:
         cyw43_arch_gpio_put(LED_PIN, 1);
-    }
-    else if (strstr(*request, "GET /off") != NULL) {
+        break;
+    case COMANDO_LED_OFF:
         cyw43_arch_gpio_put(LED_PIN, 0);
+        break;
+    case COMANDO_CENA:
+        aplicar_cena(comando->argumento);
+        break;
     }
 }
 
-// L a temperatura interna do RP2040
-float temp_read(void) {
-    adc_select_input(4);  // Seleciona o canal do sensor de temperatura
-    uint16_t raw_value = adc_read();
-    
-    // Frmula de converso para temperatura (documentao do RP2040)
-    const float conversion_factor = 3.3f / (1 << 12);
-    float temperature = 27.0f - ((raw_value * conversion_factor) - 0.706f) / 0.001721f;
-    
-    return temperature;
+// Leva todos os dispositivos da cena ao estado alvo numa nica transio; a
+// matriz e o display so atualizados uma vez, no lao principal
+void aplicar_cena(int indice) {
+    uint32_t inicio = time_us_32();
+    definir_estados(cenas_aplicar(indice, estado_palavra()));
+    histograma_registrar(&tempo_cena, time_us_32() - inicio);
 }
 
-// Callback para recebimento de dados TCP (requisies HTTP)
-static err_t tcp_server_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
-    if (!p) {
-        tcp_close(tpcb);
-        tcp_recv(tpcb, NULL);
-        return ERR_OK;
+// Retira da fila e aplica os comandos deixados pelos callbacks de rede
+void processar_comandos(void) {
+    // Todo comando aceito at a marca j est na fila
+    cyw43_arch_lwip_begin();
+    uint32_t marca = servidor_http_marca();
+    cyw43_arch_lwip_end();
+
+    comando_t comando;
+    while (true) {
+        cyw43_arch_lwip_begin();
+        bool ha_comando = fila_retirar(&fila_rede, &comando);
+        cyw43_arch_lwip_end();
+        if (!ha_comando) {
+            break;
+        }
+        aplicar_comando(&comando);
+        histograma_registrar(&latencia_comando, time_us_32() - comando.instante_us);
     }
 
-    // Copia a requisio para um buffer
-    char *request = (char *)malloc(p->len + 1);
-    memcpy(request, p->payload, p->len);
-    request[p->len] = '\0';
+    // Lotes UDP: cada um  aplicado inteiro e confirmado com o estado
+    // resultante antes da atualizao (nica) da matriz e do display
+    lote_udp_t lote;
+    while (true) {
+        cyw43_arch_lwip_begin();
+        bool ha_lote = controle_udp_retirar(&lote);
+        cyw43_arch_lwip_end();
+        if (!ha_lote) {
+            break;
+        }
+        definir_estados(controle_udp_aplicar(&lote, estado_palavra()));
+        cyw43_arch_lwip_begin();
+        controle_udp_confirmar(&lote, estado_palavra());
+        cyw43_arch_lwip_end();
+    }
 
-    printf("Request: %s\n", request);
+    // Prxima cena pedida pelo boto B
+    if (cena_botao_pendente) {
+        cena_botao_pendente = false;
+        cena_botao = cenas_proxima(cena_botao);
+        if (cena_botao >= 0) {
+            aplicar_cena(cena_botao);
+        }
+    }
 
-    // Processa a requisio do usurio
-    user_request(&request);
+    // Edio de cena ou tabela de regras recebida pela rede. As cenas so
+    // gravadas na flash fora do bloqueio do lwIP.
+    cyw43_arch_lwip_begin();
+    bool cenas_mudaram = cenas_aplicar_edicao();
+    regras_instalar_pendente();
+    cyw43_arch_lwip_end();
+    if (cenas_mudaram) {
+        cenas_gravar();
+    }
+
+    // S agora os navegadores so redirecionados: a pgina j sai com o
+    // estado resultante
+    cyw43_arch_lwip_begin();
+    servidor_http_confirmar(marca);
+    cyw43_arch_lwip_end();
+}
+
+// Resumo das latncias de HTTP e da fila de comandos
+int latencia_relatorio(char *buf, size_t tamanho) {
+    int n = histograma_formatar(&latencia_http, "http", buf, tamanho);
+    if (n < 0 || (size_t)n >= tamanho) {
+        return n;
+    }
+    n += histograma_formatar(&latencia_comando, "comando", buf + n, tamanho - n);
+    if ((size_t)n >= tamanho) {
+        return n;
+    }
+    n += snprintf(buf + n, tamanho - n, "comandos_descartados=%lu\n",
+                  (unsigned long)fila_rede.descartados);
+    if ((size_t)n >= tamanho) {
+        return n;
+    }
+    n += histograma_formatar(&tempo_cena, "cena", buf + n, tamanho - n);
+    if ((size_t)n >= tamanho) {
+        return n;
+    }
+    n += histograma_formatar(&tempo_atualizacao, "atualizacao", buf + n, tamanho - n);
+    return n;
+}
+
+// L a temperatura interna do RP2040
+int32_t temp_read(void) {
+    uint16_t raw_value = ler_adc(4);  // Canal do sensor de temperatura
     
-    // L a temperatura atual
-    float temperature = temp_read();
-
-    // HTML da pgina web
-    char html[2096];
-    snprintf(html, sizeof(html),
-             "HTTP/1.1 200 OK\r\n"
-             "Content-Type: text/html\r\n"
-             "\r\n"
-             "<!DOCTYPE html>\n"
-             "<html>\n"
-             "<head>\n"
-             "<title>Controle Residencial</title>\n"
-             "<style>\n"
-             "body { background-color:rgb(170, 240, 181); font-family: Arial, sans-serif; text-align: center; margin-top: 50px; }\n"
-             "h1 { font-size: 40px; margin-bottom: 20px; }\n"
-             "button { background-color: LightBlue; font-size: 20px; margin: 5px; padding: 10px 20px; border-radius: 10px; }\n"
-             ".temperature { font-size: 24px; margin-top: 20px; color: #333; }\n"
-             "</style>\n"
-             "</head>\n"
-             "<body>\n"
-             "<h1>Controle Residencial</h1>\n"
-             "<form action=\"./mudar_estado_luz_sala\"><button>Luz da Sala</button></form>\n"
-             "<form action=\"./mudar_estado_luz_cozinha\"><button>Luz da Cozinha</button></form>\n"
-             "<form action=\"./mudar_estado_luz_quarto\"><button>Luz do Quarto</button></form>\n"
-             "<form action=\"./mudar_estado_luz_banheiro\"><button>Luz do Banheiro</button></form>\n"
-             "<form action=\"./mudar_estado_luz_quintal\"><button>Luz do Quintal</button></form>\n"
-             "<form action=\"./mudar_estado_alarme\"><button>Alarme</button></form>\n"
-              "<p class=\"temperature\">Temperatura Interna: %.2f &deg;C</p>\n"
-             "</body>\n"
-             "</html>\n",
-             temperature);
-
-    // Envia a resposta HTTP
-    tcp_write(tpcb, html, strlen(html), TCP_WRITE_FLAG_COPY);
-    tcp_output(tpcb);
-
-    // Libera a memria alocada
-    free(request);
-    pbuf_free(p);
-
-    return ERR_OK;
-}
\ No newline at end of file
+    // Frmula de converso para temperatura (documentao do RP2040), em inteiros
+    return ponto_fixo_temperatura(raw_value);
+}
+
+// L um canal do ADC; toda leitura entra na gravao de entradas
+uint16_t ler_adc(uint canal) {
+    adc_select_input(canal);
+    uint16_t valor = adc_read();
+    gravacao_adc(canal, valor);
+    return valor;
+}
+
+// Atualiza o cache de temperatura; o ADC  lido apenas pelo lao principal
+void atualizar_temperatura(void) {
+    temperatura_atual = temp_read();
+}
+
+/* ========== PGINA WEB ========== */
+
+// Texto de cada tag SSI da pgina, com a mesma assinatura de tSSIHandler do httpd
+static u16_t tratar_ssi(int indice, char *destino, int tamanho) {
+    int n = 0;
+    switch (indice) {
+    case SSI_TEMPERATURA:
+        n = ponto_fixo_formatar(destino, tamanho, temperatura_atual, 2);
+        break;
+    case SSI_SALA:
+        n = snprintf(destino, tamanho, "%s", estado_led_sala ? "ligado" : "");
+        break;
+    case SSI_COZINHA:
+        n = snprintf(destino, tamanho, "%s", estado_led_cozinha ? "ligado" : "");
+        break;
+    case SSI_QUARTO:
+        n = snprintf(destino, tamanho, "%s", estado_led_quarto ? "ligado" : "");
+        break;
+    case SSI_BANHEIRO:
+        n = snprintf(destino, tamanho, "%s", estado_led_banheiro ? "ligado" : "");
+        break;
+    case SSI_QUINTAL:
+        n = snprintf(destino, tamanho, "%s", estado_led_quintal ? "ligado" : "");
+        break;
+    case SSI_TV:
+        n = snprintf(destino, tamanho, "%s", estado_display ? "ligado" : "");
+        break;
+    case SSI_ALARME:
+        n = snprintf(destino, tamanho, "%s", Alarme_Acionado ? "disparado" : (estado_alarme ? "ligado" : ""));
+        break;
+    case SSI_ACIONADO:
+        n = snprintf(destino, tamanho, "%s", Alarme_Acionado ? "ACIONADO" : (estado_alarme ? "ligado" : "desligado"));
+        break;
+    case SSI_CENAS:
+        n = cenas_botoes(destino, tamanho);
+        break;
+    }
+    if (n < 0) {
+        return 0;
+    }
+    return n < tamanho ? n : tamanho - 1;
+}
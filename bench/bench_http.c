@@ -0,0 +1,610 @@
+/*
+ * Benchmark do servidor HTTP (inc/servidor_http.c) no host
+ *
+ * O servidor roda sobre o lwIP em processo, com a interface loopback e um
+ * relógio simulado: tempo real acrescido de saltos de 1 ms sempre que uma
+ * volta do laço não tem nada a fazer (timers do lwIP, leitores lentos,
+ * reconexões). Os clientes do gerador de carga usam a mesma pilha, pela API
+ * raw, contra 127.0.0.1:80.
+ *
+ * O resultado sai em JSON na saída padrão, para comparar versões.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "lwip/init.h"
+#include "lwip/sys.h"
+#include "lwip/timeouts.h"
+#include "lwip/netif.h"
+#include "lwip/tcp.h"
+#include "lwip/stats.h"
+#include "lwip/memp.h"
+
+#include "pico/stdlib.h"
+#include "servidor_http.h"
+#include "fila_comandos.h"
+#include "histograma.h"
+#include "pilha.h"
+
+#define MAX_ROTAS 16
+#define RECONEXAO_MS 10            // Espera do cliente antes de reconectar
+#define PORTA_HTTP 80
+
+/* ========== RELÓGIO SIMULADO ========== */
+
+static struct timespec partida;
+static uint64_t deslocamento_us;   // Saltos acumulados nas voltas ociosas
+
+static uint64_t agora_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    uint64_t real = (uint64_t)(t.tv_sec - partida.tv_sec) * 1000000u +
+                    (t.tv_nsec - partida.tv_nsec) / 1000;
+    return real + deslocamento_us;
+}
+
+// Relógio do lwIP (timers TCP)
+u32_t sys_now(void) {
+    return (u32_t)(agora_us() / 1000);
+}
+
+// Relógio dos módulos de inc/ (latência medida pelo servidor)
+uint32_t time_us_32(void) {
+    return (uint32_t)agora_us();
+}
+
+// Sem pintura de pilha no host: os pontos de medição não fazem nada
+void pilha_entrar(pilha_ponto_t *ponto) {
+    (void)ponto;
+}
+
+void pilha_sair(pilha_ponto_t *ponto) {
+    (void)ponto;
+}
+
+/* ========== APLICAÇÃO DE TESTE ========== */
+
+// Mesmas tags de web/index.shtml; os valores são fixos
+static const char *const tags_ssi[] = {
+    "temp", "sala", "cozinha", "quarto", "banheiro", "quintal", "tv", "alarme", "acionado", "cenas",
+};
+#define SSI_CENAS 9
+
+// Botões das cenas de fábrica, como cenas_botoes() os gera no firmware
+static const char botoes_cenas[] = "<button name=\"nome\" value=\"noite\">noite</button>"
+                                   "<button name=\"nome\" value=\"fora\">fora</button>"
+                                   "<button name=\"nome\" value=\"chegada\">chegada</button>"
+                                   "<button name=\"nome\" value=\"cinema\">cinema</button>";
+
+// Fila de comandos como no firmware, esvaziada a cada volta do laço
+static fila_comandos_t fila;
+
+static u16_t ssi_bench(int indice, char *destino, int tamanho) {
+    int n = snprintf(destino, tamanho, "%s",
+                     indice == 0 ? "27.50" : (indice == SSI_CENAS ? botoes_cenas : "ligado"));
+    if (n < 0) {
+        return 0;
+    }
+    return n < tamanho ? n : tamanho - 1;
+}
+
+static resultado_requisicao_t comando_bench(char **request) {
+    if (strstr(*request, "GET /mudar_estado_") == NULL && strstr(*request, "GET /on") == NULL &&
+        strstr(*request, "GET /off") == NULL) {
+        return REQUISICAO_SEM_COMANDO;
+    }
+    return fila_inserir(&fila, 0, 0) ? REQUISICAO_ENFILEIRADA : REQUISICAO_FILA_CHEIA;
+}
+
+static int latencia_bench(char *buf, size_t tamanho) {
+    return histograma_formatar(&latencia_http, "http", buf, tamanho);
+}
+
+static const rota_texto_t rotas_texto[] = {
+    {"GET /latencia", latencia_bench},
+    {"GET /memoria", servidor_http_memoria},
+};
+
+// Sem rotas binárias: o espelho do display não faz parte da carga
+static const servidor_http_config_t config_http = {
+    .rotas_texto = rotas_texto,
+    .num_rotas_texto = count_of(rotas_texto),
+    .comando = comando_bench,
+    .ssi = ssi_bench,
+    .tags_ssi = tags_ssi,
+    .num_tags_ssi = count_of(tags_ssi),
+};
+
+/* ========== GERADOR DE CARGA ========== */
+
+typedef struct {
+    char caminho[64];
+    uint32_t peso;
+    uint32_t concluidas;
+    histograma_t latencia;
+} rota_t;
+
+typedef enum {
+    CLIENTE_OCIOSO,      // Sem conexão; conecta quando vencer reconectar_ms
+    CLIENTE_CONECTANDO,
+    CLIENTE_PRONTO,      // Conectado, envia a próxima requisição
+    CLIENTE_AGUARDANDO,  // Requisição enviada, lendo a resposta
+    CLIENTE_FECHAR,      // Fecha a conexão na próxima volta
+} estado_cliente_t;
+
+typedef struct {
+    struct tcp_pcb *pcb;
+    estado_cliente_t estado;
+    bool lento;                  // Libera a janela aos poucos (tcp_recved)
+    uint32_t reconectar_ms;
+    uint32_t respostas_conexao;  // Respostas completas na conexão atual
+    uint32_t bytes_conexao;      // Bytes recebidos na conexão atual
+    rota_t *rota;
+    uint64_t inicio_us;
+    char cabecalho[512];
+    size_t tam_cabecalho;
+    bool cabecalho_completo;
+    int status;
+    long corpo_esperado;
+    long corpo_recebido;
+    uint32_t a_confirmar;        // Bytes lidos e ainda não liberados na janela
+    uint32_t ultimo_ms;
+} cliente_t;
+
+// Parâmetros da execução
+static struct {
+    int clientes;
+    uint32_t requisicoes;
+    bool keepalive;
+    uint32_t por_conexao;        // Requisições por conexão (0 = sem limite)
+    int lentos;
+    uint32_t taxa_lenta;         // Bytes por ms liberados por um leitor lento
+    uint32_t semente;
+    uint32_t limite_ms;          // Tempo simulado máximo
+} opcoes = {8, 10000, true, 0, 0, 256, 1, 600000};
+
+static rota_t rotas[MAX_ROTAS];
+static int num_rotas;
+static uint32_t peso_total;
+
+static cliente_t clientes[BENCH_MAX_CLIENTES];
+
+// Contadores da execução
+static uint32_t emitidas, concluidas, falhas;
+static uint32_t conexoes_abertas, conexoes_recusadas, conexoes_perdidas, sem_memoria;
+static uint32_t contagem_status[5], status_outros;  // 200, 303, 304, 404, 503
+static uint32_t eventos;                        // Progresso dos clientes na volta do laço
+static histograma_t latencia_clientes;
+static uint32_t aleatorio;
+
+static uint32_t sortear(void) {
+    aleatorio ^= aleatorio << 13;
+    aleatorio ^= aleatorio >> 17;
+    aleatorio ^= aleatorio << 5;
+    return aleatorio;
+}
+
+static rota_t *sortear_rota(void) {
+    uint32_t r = sortear() % peso_total;
+    for (int i = 0; i < num_rotas; i++) {
+        if (r < rotas[i].peso) {
+            return &rotas[i];
+        }
+        r -= rotas[i].peso;
+    }
+    return &rotas[num_rotas - 1];
+}
+
+static void contar_status(int status) {
+    static const int codigos[] = {200, 303, 304, 404, 503};
+    for (uint i = 0; i < count_of(codigos); i++) {
+        if (status == codigos[i]) {
+            contagem_status[i]++;
+            return;
+        }
+    }
+    status_outros++;
+}
+
+static err_t cliente_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
+static void cliente_err(void *arg, err_t err);
+
+static void enviar_requisicao(cliente_t *c) {
+    char requisicao[256];
+    c->rota = sortear_rota();
+    bool fechar = !opcoes.keepalive ||
+                  (opcoes.por_conexao && c->respostas_conexao + 1 >= opcoes.por_conexao);
+    int n = snprintf(requisicao, sizeof(requisicao),
+                     "GET %s HTTP/1.1\r\n"
+                     "Host: bench\r\n"
+                     "Accept-Encoding: gzip\r\n"
+                     "%s"
+                     "\r\n",
+                     c->rota->caminho, fechar ? "Connection: close\r\n" : "");
+    if (tcp_write(c->pcb, requisicao, n, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+        // Sem memória na pilha: tenta de novo na próxima volta
+        return;
+    }
+    tcp_output(c->pcb);
+    eventos++;
+    c->tam_cabecalho = 0;
+    c->cabecalho_completo = false;
+    c->corpo_recebido = 0;
+    c->inicio_us = agora_us();
+    c->estado = CLIENTE_AGUARDANDO;
+    emitidas++;
+}
+
+static void concluir_resposta(cliente_t *c) {
+    uint32_t latencia = (uint32_t)(agora_us() - c->inicio_us);
+    histograma_registrar(&latencia_clientes, latencia);
+    histograma_registrar(&c->rota->latencia, latencia);
+    c->rota->concluidas++;
+    contar_status(c->status);
+    concluidas++;
+    c->respostas_conexao++;
+    bool fechar = !opcoes.keepalive || (opcoes.por_conexao && c->respostas_conexao >= opcoes.por_conexao);
+    c->estado = fechar ? CLIENTE_FECHAR : CLIENTE_PRONTO;
+}
+
+// Interpreta a resposta: linha de status, Content-Length e corpo
+static void consumir(cliente_t *c, const char *dados, size_t n) {
+    while (n > 0 && c->estado == CLIENTE_AGUARDANDO) {
+        if (!c->cabecalho_completo) {
+            if (c->tam_cabecalho == sizeof(c->cabecalho) - 1) {
+                falhas++;
+                c->estado = CLIENTE_FECHAR;
+                return;
+            }
+            c->cabecalho[c->tam_cabecalho++] = *dados++;
+            c->cabecalho[c->tam_cabecalho] = '\0';
+            n--;
+            if (c->tam_cabecalho >= 4 && memcmp(c->cabecalho + c->tam_cabecalho - 4, "\r\n\r\n", 4) == 0) {
+                const char *tamanho = strstr(c->cabecalho, "Content-Length: ");
+                c->cabecalho_completo = true;
+                c->status = strncmp(c->cabecalho, "HTTP/1.", 7) == 0 ? atoi(c->cabecalho + 9) : 0;
+                c->corpo_esperado = tamanho ? strtol(tamanho + 16, NULL, 10) : 0;
+                if (c->corpo_esperado == 0) {
+                    concluir_resposta(c);
+                }
+            }
+        } else {
+            size_t k = (size_t)(c->corpo_esperado - c->corpo_recebido);
+            if (k > n) {
+                k = n;
+            }
+            c->corpo_recebido += k;
+            dados += k;
+            n -= k;
+            if (c->corpo_recebido >= c->corpo_esperado) {
+                concluir_resposta(c);
+            }
+        }
+    }
+}
+
+static err_t cliente_conectado(void *arg, struct tcp_pcb *tpcb, err_t err) {
+    cliente_t *c = (cliente_t *)arg;
+    eventos++;
+    conexoes_abertas++;
+    c->estado = CLIENTE_PRONTO;
+    return ERR_OK;
+}
+
+static err_t cliente_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
+    cliente_t *c = (cliente_t *)arg;
+    eventos++;
+    if (!p) {
+        // Servidor fechou; uma resposta incompleta conta como falha
+        if (c->estado == CLIENTE_AGUARDANDO) {
+            falhas++;
+        }
+        c->estado = CLIENTE_FECHAR;
+        return ERR_OK;
+    }
+    for (struct pbuf *q = p; q; q = q->next) {
+        consumir(c, (const char *)q->payload, q->len);
+    }
+    c->bytes_conexao += p->tot_len;
+    if (c->lento) {
+        c->a_confirmar += p->tot_len;
+    } else {
+        tcp_recved(tpcb, p->tot_len);
+    }
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+// A PCB já foi liberada pelo lwIP
+static void cliente_err(void *arg, err_t err) {
+    cliente_t *c = (cliente_t *)arg;
+    eventos++;
+    if (c->bytes_conexao == 0 && c->respostas_conexao == 0 &&
+        (c->estado == CLIENTE_CONECTANDO || c->estado == CLIENTE_AGUARDANDO || c->estado == CLIENTE_PRONTO)) {
+        // Recusada pelo servidor (sem bloco de conexão): a requisição é refeita
+        conexoes_recusadas++;
+        if (c->estado == CLIENTE_AGUARDANDO) {
+            emitidas--;
+        }
+    } else {
+        conexoes_perdidas++;
+        if (c->estado == CLIENTE_AGUARDANDO) {
+            falhas++;
+        }
+    }
+    c->pcb = NULL;
+    c->estado = CLIENTE_OCIOSO;
+    c->a_confirmar = 0;
+    c->reconectar_ms = sys_now() + RECONEXAO_MS;
+}
+
+static void conectar(cliente_t *c) {
+    c->pcb = tcp_new();
+    if (!c->pcb) {
+        sem_memoria++;
+        c->reconectar_ms = sys_now() + RECONEXAO_MS;
+        return;
+    }
+    ip_addr_t destino;
+    IP4_ADDR(ip_2_ip4(&destino), 127, 0, 0, 1);
+    c->respostas_conexao = 0;
+    c->bytes_conexao = 0;
+    c->a_confirmar = 0;
+    tcp_arg(c->pcb, c);
+    tcp_recv(c->pcb, cliente_recv);
+    tcp_err(c->pcb, cliente_err);
+    c->estado = CLIENTE_CONECTANDO;
+    eventos++;
+    if (tcp_connect(c->pcb, &destino, PORTA_HTTP, cliente_conectado) != ERR_OK) {
+        tcp_arg(c->pcb, NULL);
+        tcp_err(c->pcb, NULL);
+        tcp_abort(c->pcb);
+        c->pcb = NULL;
+        c->estado = CLIENTE_OCIOSO;
+        c->reconectar_ms = sys_now() + RECONEXAO_MS;
+        sem_memoria++;
+    }
+}
+
+static void fechar_cliente(cliente_t *c) {
+    tcp_arg(c->pcb, NULL);
+    tcp_recv(c->pcb, NULL);
+    tcp_err(c->pcb, NULL);
+    if (tcp_close(c->pcb) != ERR_OK) {
+        tcp_abort(c->pcb);
+    }
+    c->pcb = NULL;
+    c->estado = CLIENTE_OCIOSO;
+    c->reconectar_ms = sys_now();
+    eventos++;
+}
+
+// Avança cada cliente que não depende de um callback do lwIP
+static void atender_clientes(void) {
+    uint32_t agora = sys_now();
+    for (int i = 0; i < opcoes.clientes; i++) {
+        cliente_t *c = &clientes[i];
+        switch (c->estado) {
+        case CLIENTE_OCIOSO:
+            if (emitidas < opcoes.requisicoes && (int32_t)(agora - c->reconectar_ms) >= 0) {
+                conectar(c);
+            }
+            break;
+        case CLIENTE_PRONTO:
+            if (emitidas < opcoes.requisicoes) {
+                enviar_requisicao(c);
+            }
+            break;
+        case CLIENTE_FECHAR:
+            fechar_cliente(c);
+            break;
+        default:
+            break;
+        }
+
+        // Leitor lento: abre a janela a uma taxa fixa
+        if (c->lento && c->pcb && agora != c->ultimo_ms) {
+            uint32_t cota = (agora - c->ultimo_ms) * opcoes.taxa_lenta;
+            uint32_t n = c->a_confirmar < cota ? c->a_confirmar : cota;
+            if (n > 0xffff) {
+                n = 0xffff;
+            }
+            if (n > 0) {
+                tcp_recved(c->pcb, (u16_t)n);
+                c->a_confirmar -= n;
+                eventos++;
+            }
+            c->ultimo_ms = agora;
+        }
+    }
+}
+
+/* ========== OPÇÕES E RELATÓRIO ========== */
+
+// Lista "caminho:peso,caminho:peso,..."
+static bool ler_rotas(const char *texto) {
+    char copia[1024];
+    snprintf(copia, sizeof(copia), "%s", texto);
+    num_rotas = 0;
+    peso_total = 0;
+    for (char *item = strtok(copia, ","); item; item = strtok(NULL, ",")) {
+        if (num_rotas == MAX_ROTAS) {
+            return false;
+        }
+        char *dois_pontos = strrchr(item, ':');
+        rota_t *r = &rotas[num_rotas++];
+        memset(r, 0, sizeof(*r));
+        r->peso = dois_pontos ? (uint32_t)strtoul(dois_pontos + 1, NULL, 10) : 1;
+        if (dois_pontos) {
+            *dois_pontos = '\0';
+        }
+        snprintf(r->caminho, sizeof(r->caminho), "%s", item);
+        histograma_limpar(&r->latencia);
+        peso_total += r->peso;
+    }
+    return num_rotas > 0 && peso_total > 0;
+}
+
+static void uso(const char *programa) {
+    fprintf(stderr,
+            "uso: %s [opções]\n"
+            "  --clientes N       conexões simultâneas (padrão 8, máximo %d)\n"
+            "  --requisicoes N    total de requisições (padrão 10000)\n"
+            "  --keepalive 0|1    conexões persistentes (padrão 1)\n"
+            "  --por-conexao N    requisições antes de reconectar (padrão 0 = sem limite)\n"
+            "  --rotas LISTA      caminho:peso,... (padrão /:40,/estilo.css:20,/app.js:20,\n"
+            "                     /mudar_estado_luz_sala:15,/latencia:5)\n"
+            "  --lentos N         clientes que leem devagar (padrão 0)\n"
+            "  --taxa-lenta B     bytes/ms lidos por um cliente lento (padrão 256)\n"
+            "  --semente N        semente do sorteio das rotas (padrão 1)\n"
+            "  --limite-s N       tempo simulado máximo (padrão 600)\n",
+            programa, BENCH_MAX_CLIENTES);
+}
+
+static void imprimir_latencia(const histograma_t *h) {
+    printf("{\"p50\": %lu, \"p99\": %lu, \"p999\": %lu, \"max\": %lu}",
+           (unsigned long)histograma_percentil(h, 500), (unsigned long)histograma_percentil(h, 990),
+           (unsigned long)histograma_percentil(h, 999), (unsigned long)h->maximo);
+}
+
+static void imprimir_memp(const char *nome, memp_t tipo, bool virgula) {
+    const struct stats_mem *s = lwip_stats.memp[tipo];
+    printf("    \"%s\": {\"max\": %lu, \"err\": %lu}%s\n", nome, (unsigned long)s->max,
+           (unsigned long)s->err, virgula ? "," : "");
+}
+
+static void imprimir_relatorio(uint64_t duracao_us, uint64_t real_us, bool interrompido) {
+    printf("{\n");
+    printf("  \"clientes\": %d, \"lentos\": %d, \"keepalive\": %s, \"por_conexao\": %lu,\n",
+           opcoes.clientes, opcoes.lentos, opcoes.keepalive ? "true" : "false",
+           (unsigned long)opcoes.por_conexao);
+    printf("  \"conexoes_servidor\": %d, \"interrompido\": %s,\n", HTTP_MAX_CONEXOES,
+           interrompido ? "true" : "false");
+    printf("  \"concluidas\": %lu, \"falhas\": %lu,\n", (unsigned long)concluidas, (unsigned long)falhas);
+    printf("  \"duracao_ms\": %.1f, \"duracao_real_ms\": %.1f, \"vazao_rps\": %.1f,\n",
+           duracao_us / 1000.0, real_us / 1000.0, duracao_us ? concluidas * 1e6 / duracao_us : 0.0);
+    printf("  \"latencia_us\": ");
+    imprimir_latencia(&latencia_clientes);
+    printf(",\n  \"latencia_servidor_us\": ");
+    imprimir_latencia(&latencia_http);
+    printf(",\n  \"status\": {\"200\": %lu, \"303\": %lu, \"304\": %lu, \"404\": %lu, \"503\": %lu, \"outros\": %lu},\n",
+           (unsigned long)contagem_status[0], (unsigned long)contagem_status[1], (unsigned long)contagem_status[2],
+           (unsigned long)contagem_status[3], (unsigned long)contagem_status[4], (unsigned long)status_outros);
+    printf("  \"conexoes\": {\"abertas\": %lu, \"recusadas\": %lu, \"perdidas\": %lu, \"sem_memoria\": %lu},\n",
+           (unsigned long)conexoes_abertas, (unsigned long)conexoes_recusadas,
+           (unsigned long)conexoes_perdidas, (unsigned long)sem_memoria);
+    printf("  \"erros_envio\": %lu, \"comandos_descartados\": %lu,\n", (unsigned long)erros_envio_http,
+           (unsigned long)fila.descartados);
+
+    printf("  \"rotas\": [\n");
+    for (int i = 0; i < num_rotas; i++) {
+        printf("    {\"caminho\": \"%s\", \"peso\": %lu, \"concluidas\": %lu, \"latencia_us\": ", rotas[i].caminho,
+               (unsigned long)rotas[i].peso, (unsigned long)rotas[i].concluidas);
+        imprimir_latencia(&rotas[i].latencia);
+        printf("}%s\n", i + 1 < num_rotas ? "," : "");
+    }
+    printf("  ],\n");
+
+    printf("  \"pools\": [\n");
+    for (int i = 0; i < NUM_POOLS_HTTP; i++) {
+        const pool_t *p = pools_http[i];
+        printf("    {\"nome\": \"%s\", \"blocos\": %u, \"maximo\": %u, \"falhas\": %lu}%s\n", p->nome,
+               p->num_blocos, p->maximo_em_uso, (unsigned long)p->falhas, i + 1 < NUM_POOLS_HTTP ? "," : "");
+    }
+    printf("  ],\n");
+
+    // Memória do lwIP (compartilhada com os clientes do benchmark)
+    printf("  \"lwip\": {\n");
+    printf("    \"mem\": {\"max\": %lu, \"err\": %lu},\n", (unsigned long)lwip_stats.mem.max,
+           (unsigned long)lwip_stats.mem.err);
+    imprimir_memp("tcp_pcb", MEMP_TCP_PCB, true);
+    imprimir_memp("tcp_seg", MEMP_TCP_SEG, true);
+    imprimir_memp("pbuf", MEMP_PBUF, false);
+    printf("  }\n");
+    printf("}\n");
+}
+
+int main(int argc, char **argv) {
+    static const struct option longas[] = {
+        {"clientes", required_argument, NULL, 'c'},
+        {"requisicoes", required_argument, NULL, 'n'},
+        {"keepalive", required_argument, NULL, 'k'},
+        {"por-conexao", required_argument, NULL, 'p'},
+        {"rotas", required_argument, NULL, 'r'},
+        {"lentos", required_argument, NULL, 'l'},
+        {"taxa-lenta", required_argument, NULL, 't'},
+        {"semente", required_argument, NULL, 's'},
+        {"limite-s", required_argument, NULL, 'L'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    const char *lista_rotas = "/:40,/estilo.css:20,/app.js:20,/mudar_estado_luz_sala:15,/latencia:5";
+    int opcao;
+    while ((opcao = getopt_long(argc, argv, "c:n:k:p:r:l:t:s:L:h", longas, NULL)) != -1) {
+        switch (opcao) {
+        case 'c': opcoes.clientes = atoi(optarg); break;
+        case 'n': opcoes.requisicoes = strtoul(optarg, NULL, 10); break;
+        case 'k': opcoes.keepalive = atoi(optarg) != 0; break;
+        case 'p': opcoes.por_conexao = strtoul(optarg, NULL, 10); break;
+        case 'r': lista_rotas = optarg; break;
+        case 'l': opcoes.lentos = atoi(optarg); break;
+        case 't': opcoes.taxa_lenta = strtoul(optarg, NULL, 10); break;
+        case 's': opcoes.semente = strtoul(optarg, NULL, 10); break;
+        case 'L': opcoes.limite_ms = strtoul(optarg, NULL, 10) * 1000; break;
+        default: uso(argv[0]); return 2;
+        }
+    }
+    if (opcoes.clientes < 1 || opcoes.clientes > BENCH_MAX_CLIENTES || opcoes.lentos > opcoes.clientes ||
+        !ler_rotas(lista_rotas)) {
+        uso(argv[0]);
+        return 2;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &partida);
+    aleatorio = opcoes.semente ? opcoes.semente : 1;
+    srand(opcoes.semente);
+    histograma_limpar(&latencia_clientes);
+
+    lwip_init();
+    if (!servidor_http_iniciar(&config_http, PORTA_HTTP)) {
+        return 1;
+    }
+    for (int i = 0; i < opcoes.clientes; i++) {
+        clientes[i].estado = CLIENTE_OCIOSO;
+        clientes[i].lento = i < opcoes.lentos;
+        clientes[i].reconectar_ms = sys_now();
+    }
+
+    bool interrompido = false;
+    while (concluidas + falhas < opcoes.requisicoes) {
+        if (sys_now() > opcoes.limite_ms) {
+            interrompido = true;
+            break;
+        }
+        uint32_t antes = eventos + lwip_stats.tcp.recv;
+
+        netif_poll_all();
+        sys_check_timeouts();
+        atender_clientes();
+
+        // O laço principal do firmware aplica os comandos a cada despertar e
+        // então redireciona quem os enviou
+        uint32_t marca = servidor_http_marca();
+        comando_t comando;
+        while (fila_retirar(&fila, &comando)) {
+        }
+        servidor_http_confirmar(marca);
+
+        if (eventos + lwip_stats.tcp.recv == antes) {
+            deslocamento_us += 1000;
+        }
+    }
+
+    uint64_t duracao_us = agora_us();
+    imprimir_relatorio(duracao_us, duracao_us - deslocamento_us, interrompido);
+    return (falhas || interrompido) ? 1 : 0;
+}
@@ -0,0 +1,12 @@
+#ifndef BENCH_ANIMACOES_LED_PIO_H
+#define BENCH_ANIMACOES_LED_PIO_H
+
+// No firmware este cabeçalho é gerado pelo pioasm a partir de
+// extra/animacoes_led.pio; no host só o programa e a inicialização existem
+#include "hardware/pio.h"
+
+extern const pio_program_t animacoes_led_program;
+
+void animacoes_led_program_init(PIO pio, uint sm, uint offset, uint pino);
+
+#endif
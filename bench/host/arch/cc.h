@@ -0,0 +1,17 @@
+#ifndef BENCH_ARCH_CC_H
+#define BENCH_ARCH_CC_H
+
+// Porta mínima do lwIP para o host (NO_SYS, sem threads). sys_now() é o
+// relógio simulado do benchmark, em bench_http.c.
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LWIP_TIMEVAL_PRIVATE 0
+#include <sys/time.h>
+
+#define LWIP_RAND() ((u32_t)rand())
+
+#define LWIP_PLATFORM_DIAG(x) do { printf x; } while (0)
+#define LWIP_PLATFORM_ASSERT(x) do { fprintf(stderr, "lwIP: %s (%s:%d)\n", x, __FILE__, __LINE__); abort(); } while (0)
+
+#endif
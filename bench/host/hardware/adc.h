@@ -0,0 +1,12 @@
+#ifndef BENCH_HARDWARE_ADC_H
+#define BENCH_HARDWARE_ADC_H
+
+#include "pico/stdlib.h"
+
+void adc_init(void);
+void adc_gpio_init(uint gpio);
+void adc_select_input(uint canal);
+uint16_t adc_read(void);
+void adc_set_temp_sensor_enabled(bool habilitar);
+
+#endif
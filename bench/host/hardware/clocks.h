@@ -0,0 +1,19 @@
+#ifndef BENCH_HARDWARE_CLOCKS_H
+#define BENCH_HARDWARE_CLOCKS_H
+
+#include "pico/stdlib.h"
+
+enum clock_index {
+    clk_gpout0 = 0,
+    clk_ref = 4,
+    clk_sys = 5,
+    clk_peri = 6,
+};
+
+#define CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX 0x1
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS 0x0
+
+uint32_t clock_get_hz(enum clock_index relogio);
+bool clock_configure(enum clock_index relogio, uint32_t fonte, uint32_t fonte_aux, uint32_t freq_origem, uint32_t freq);
+
+#endif
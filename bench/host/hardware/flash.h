@@ -0,0 +1,19 @@
+#ifndef BENCH_HARDWARE_FLASH_H
+#define BENCH_HARDWARE_FLASH_H
+
+// Flash simulada em RAM, mapeada em XIP_BASE como na placa
+#include "pico/stdlib.h"
+
+#define FLASH_PAGE_SIZE 256
+#define FLASH_SECTOR_SIZE 4096
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES (64 * 1024)
+#endif
+
+extern uint8_t flash_simulada[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE ((uintptr_t)flash_simulada)
+
+void flash_range_erase(uint32_t deslocamento, size_t tamanho);
+void flash_range_program(uint32_t deslocamento, const uint8_t *dados, size_t tamanho);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef BENCH_HARDWARE_I2C_H
+#define BENCH_HARDWARE_I2C_H
+
+#include "pico/stdlib.h"
+
+typedef struct i2c_inst i2c_inst_t;
+
+extern i2c_inst_t *const i2c0;
+extern i2c_inst_t *const i2c1;
+
+// O firmware usa o bloco I2C só por inc/barramento_i2c.h, substituído em
+// reproduzir.c
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef BENCH_HARDWARE_PIO_H
+#define BENCH_HARDWARE_PIO_H
+
+#include "pico/stdlib.h"
+
+typedef struct pio_hw pio_hw_t;
+typedef pio_hw_t *PIO;
+
+typedef struct {
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin;
+} pio_program_t;
+
+extern PIO const pio0;
+
+uint pio_add_program(PIO pio, const pio_program_t *programa);
+int pio_claim_unused_sm(PIO pio, bool obrigatorio);
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t dado);
+
+#endif
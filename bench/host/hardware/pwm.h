@@ -0,0 +1,14 @@
+#ifndef BENCH_HARDWARE_PWM_H
+#define BENCH_HARDWARE_PWM_H
+
+#include "pico/stdlib.h"
+
+static inline uint pwm_gpio_to_slice_num(uint gpio) {
+    return (gpio >> 1) & 7;
+}
+
+void pwm_set_wrap(uint fatia, uint16_t topo);
+void pwm_set_gpio_level(uint gpio, uint16_t nivel);
+void pwm_set_enabled(uint fatia, bool habilitar);
+
+#endif
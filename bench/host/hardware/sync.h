@@ -0,0 +1,12 @@
+#ifndef BENCH_HARDWARE_SYNC_H
+#define BENCH_HARDWARE_SYNC_H
+
+// O host roda em uma única thread: não há interrupções a mascarar
+#include <stdint.h>
+
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t estado) { (void)estado; }
+static inline void __dmb(void) { }
+static inline void __sev(void) { }
+
+#endif
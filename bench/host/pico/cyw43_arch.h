@@ -0,0 +1,30 @@
+#ifndef BENCH_PICO_CYW43_ARCH_H
+#define BENCH_PICO_CYW43_ARCH_H
+
+// Chip WiFi sem rádio: a conexão sempre funciona e o lwIP roda na mesma
+// thread, então o bloqueio do lwIP não faz nada
+#include "pico/stdlib.h"
+
+#define CYW43_WL_GPIO_LED_PIN 0
+#define CYW43_AUTH_WPA2_AES_PSK 0x00400004
+#define CYW43_DEFAULT_PM 0xA11142
+#define CYW43_AGGRESSIVE_PM 0xA11C82
+#define CYW43_PERFORMANCE_PM 0x111022
+
+typedef struct {
+    int itf_state;
+} cyw43_t;
+
+extern cyw43_t cyw43_state;
+
+int cyw43_arch_init(void);
+void cyw43_arch_deinit(void);
+void cyw43_arch_enable_sta_mode(void);
+int cyw43_arch_wifi_connect_timeout_ms(const char *ssid, const char *senha, uint32_t autenticacao, uint32_t tempo_ms);
+void cyw43_arch_gpio_put(uint pino, bool valor);
+int cyw43_wifi_pm(cyw43_t *self, uint32_t modo);
+
+static inline void cyw43_arch_lwip_begin(void) { }
+static inline void cyw43_arch_lwip_end(void) { }
+
+#endif
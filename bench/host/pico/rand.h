@@ -0,0 +1,8 @@
+#ifndef BENCH_PICO_RAND_H
+#define BENCH_PICO_RAND_H
+
+#include <stdint.h>
+
+uint32_t get_rand_32(void);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef BENCH_PICO_STDLIB_H
+#define BENCH_PICO_STDLIB_H
+
+// Substitutos do SDK da Pico usados no host. O benchmark do servidor HTTP só
+// usa o relógio; a reprodução de gravações (reproduzir.c) implementa os
+// demais sobre o seu tempo virtual.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+// Relógio simulado, em microssegundos
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+
+// Instantes em microssegundos desde o boot, como no SDK sem
+// PICO_OPAQUE_ABSOLUTE_TIME_T
+typedef uint64_t absolute_time_t;
+
+extern const absolute_time_t nil_time;
+extern const absolute_time_t at_the_end_of_time;
+
+static inline uint64_t to_us_since_boot(absolute_time_t t) {
+    return t;
+}
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t) {
+    return (uint32_t)(t / 1000);
+}
+
+static inline bool is_nil_time(absolute_time_t t) {
+    return t == 0;
+}
+
+static inline int64_t absolute_time_diff_us(absolute_time_t de, absolute_time_t ate) {
+    return (int64_t)(ate - de);
+}
+
+absolute_time_t get_absolute_time(void);
+absolute_time_t make_timeout_time_us(uint64_t us);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+bool time_reached(absolute_time_t t);
+bool best_effort_wfe_or_timeout(absolute_time_t prazo);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+static inline void tight_loop_contents(void) {
+}
+
+// Alarmes de timer
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *dados);
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *dados, bool disparar_se_passado);
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *dados, bool disparar_se_passado);
+
+// GPIO
+#define GPIO_IN 0
+#define GPIO_OUT 1
+#define GPIO_FUNC_I2C 3
+#define GPIO_FUNC_PWM 4
+#define GPIO_IRQ_EDGE_FALL 0x4u
+#define GPIO_IRQ_EDGE_RISE 0x8u
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t eventos);
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool saida);
+void gpio_put(uint gpio, bool valor);
+bool gpio_get(uint gpio);
+void gpio_pull_up(uint gpio);
+void gpio_set_function(uint gpio, uint funcao);
+void gpio_set_irq_enabled(uint gpio, uint32_t eventos, bool habilitar);
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t eventos, bool habilitar, gpio_irq_callback_t callback);
+
+void stdio_init_all(void);
+
+#endif
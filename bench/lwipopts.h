@@ -0,0 +1,44 @@
+#ifndef BENCH_LWIPOPTS_H
+#define BENCH_LWIPOPTS_H
+
+// Mesma configuração do firmware, com os ajustes para rodar no host: os
+// clientes do gerador de carga dividem a pilha com o servidor, então as
+// memórias compartilhadas crescem com o número máximo de clientes.
+#include "../extra/lwipopts.h"
+
+#ifndef BENCH_MAX_CLIENTES
+#define BENCH_MAX_CLIENTES 64
+#endif
+
+// Conexões do servidor limitadas ao valor do firmware (MEMP_NUM_TCP_PCB em
+// extra/lwipopts.h); pode ser alterado com -DHTTP_MAX_CONEXOES=n
+#ifndef HTTP_MAX_CONEXOES
+#define HTTP_MAX_CONEXOES 4
+#endif
+
+#undef MEMP_NUM_TCP_PCB
+#define MEMP_NUM_TCP_PCB (HTTP_MAX_CONEXOES + BENCH_MAX_CLIENTES)
+#undef MEMP_NUM_TCP_SEG
+#define MEMP_NUM_TCP_SEG (16 + 2 * BENCH_MAX_CLIENTES)
+#undef MEM_SIZE
+#define MEM_SIZE (8192 + BENCH_MAX_CLIENTES * 1024)
+
+// Interface loopback (127.0.0.1), entregue por netif_poll_all no laço do benchmark
+#define LWIP_HAVE_LOOPIF 1
+#define LWIP_NETIF_LOOPBACK 1
+
+#undef LWIP_DHCP
+#define LWIP_DHCP 0
+#undef LWIP_AUTOIP
+#define LWIP_AUTOIP 0
+#undef LWIP_DNS
+#define LWIP_DNS 0
+
+// Sem threads: nenhuma proteção de seção crítica
+#define SYS_LIGHTWEIGHT_PROT 0
+
+// Contadores de erro dos pools do lwIP para o relatório
+#define LWIP_STATS 1
+#define LWIP_STATS_DISPLAY 0
+
+#endif /* BENCH_LWIPOPTS_H */
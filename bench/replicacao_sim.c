@@ -0,0 +1,369 @@
+/*
+ * Simulação da replicação entre placas (inc/replica.c) no host
+ *
+ * Várias réplicas trocam datagramas por um multicast simulado, com tempo
+ * virtual em ms: cada cópia de um datagrama se perde com a probabilidade
+ * dada, independente das outras, e chega depois de uma latência sorteada.
+ * Cada nó tem o seu relógio (ms desde o próprio boot, com defasagem
+ * sorteada), executa a rodada a cada 100 ms como a tarefa do firmware e
+ * aplica na hora o que muda o seu estado, como o laço acordado pelo
+ * callback; reparos e resumos pedidos saem na rodada seguinte.
+ *
+ * As mudanças seguem um processo de Poisson em nós e dispositivos
+ * sorteados. Uma mudança convergiu quando todos os nós têm, para o
+ * dispositivo, uma versão igual ou mais nova que a dela. Depois da duração
+ * vem uma cauda sem mudanças, e no fim os estados devem ser iguais.
+ *
+ * O resultado sai em JSON na saída padrão.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <math.h>
+
+#include "replica.h"
+
+#define MAX_NOS 64
+#define RODADA_MS 100              // Período da tarefa "replicacao" do firmware
+
+typedef struct {
+    uint64_t t;
+    int destino;
+    uint16_t tamanho;
+    uint8_t dados[REPLICA_TAMANHO_MAXIMO];
+} entrega_t;
+
+typedef struct {
+    replica_t replica;
+    uint32_t estado;               // Palavra de estados do "firmware"
+    uint64_t boot_ms;              // Relógio do nó = t - boot_ms
+    uint64_t proxima_rodada;
+} no_t;
+
+typedef struct {
+    uint64_t t;
+    int dispositivo;
+    versao_replica_t versao;
+    uint64_t convergiu;            // 0 = ainda não
+} mudanca_t;
+
+static struct {
+    int nos;
+    double perda;
+    uint32_t latencia_min_ms, latencia_max_ms;
+    uint32_t duracao_s, cauda_s;
+    double mudancas_por_min;
+    uint32_t defasagem_s;
+    uint64_t semente;
+} opcoes = {4, 0.1, 1, 20, 300, 10, 30.0, 3600, 1};
+
+static no_t nos[MAX_NOS];
+static uint64_t agora;
+
+// Datagramas em voo: heap mínimo pelo instante de entrega
+static entrega_t *em_voo;
+static size_t num_em_voo, capacidade_em_voo;
+
+static mudanca_t *mudancas;
+static size_t num_mudancas, capacidade_mudancas, primeira_pendente;
+
+static struct {
+    uint32_t deltas, resumos;
+    uint64_t bytes_deltas, bytes_resumos;
+    uint64_t copias, perdidas, entregues;
+} trafego;
+
+static uint64_t aleatorio;
+
+static uint64_t sortear(void) {
+    aleatorio ^= aleatorio << 13;
+    aleatorio ^= aleatorio >> 7;
+    aleatorio ^= aleatorio << 17;
+    return aleatorio;
+}
+
+static double sortear_unitario(void) {
+    return (sortear() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static uint32_t sortear_entre(uint32_t minimo, uint32_t maximo) {
+    return minimo + (uint32_t)(sortear() % (maximo - minimo + 1));
+}
+
+static uint64_t relogio(const no_t *n) {
+    return agora - n->boot_ms;
+}
+
+static void colocar_em_voo(const entrega_t *e) {
+    if (num_em_voo == capacidade_em_voo) {
+        capacidade_em_voo = capacidade_em_voo ? 2 * capacidade_em_voo : 256;
+        em_voo = realloc(em_voo, capacidade_em_voo * sizeof(*em_voo));
+    }
+    size_t i = num_em_voo++;
+    while (i > 0 && em_voo[(i - 1) / 2].t > e->t) {
+        em_voo[i] = em_voo[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    em_voo[i] = *e;
+}
+
+static entrega_t retirar_em_voo(void) {
+    entrega_t topo = em_voo[0];
+    entrega_t ultimo = em_voo[--num_em_voo];
+    size_t i = 0;
+    for (;;) {
+        size_t filho = 2 * i + 1;
+        if (filho >= num_em_voo) {
+            break;
+        }
+        if (filho + 1 < num_em_voo && em_voo[filho + 1].t < em_voo[filho].t) {
+            filho++;
+        }
+        if (em_voo[filho].t >= ultimo.t) {
+            break;
+        }
+        em_voo[i] = em_voo[filho];
+        i = filho;
+    }
+    if (num_em_voo) {
+        em_voo[i] = ultimo;
+    }
+    return topo;
+}
+
+// Multicast: uma cópia para cada outro nó, com perda e latência próprias
+static void enviar_pendentes(int origem) {
+    entrega_t e;
+    size_t n;
+    while ((n = replica_mensagem(&nos[origem].replica, relogio(&nos[origem]), e.dados)) > 0) {
+        if (e.dados[3] == REPLICA_DELTA) {
+            trafego.deltas++;
+            trafego.bytes_deltas += n;
+        } else {
+            trafego.resumos++;
+            trafego.bytes_resumos += n;
+        }
+        e.tamanho = (uint16_t)n;
+        for (int d = 0; d < opcoes.nos; d++) {
+            if (d == origem) {
+                continue;
+            }
+            trafego.copias++;
+            if (sortear_unitario() < opcoes.perda) {
+                trafego.perdidas++;
+                continue;
+            }
+            e.destino = d;
+            e.t = agora + sortear_entre(opcoes.latencia_min_ms, opcoes.latencia_max_ms);
+            colocar_em_voo(&e);
+        }
+    }
+}
+
+static void sincronizar(int i) {
+    no_t *n = &nos[i];
+    n->estado = replica_sincronizar(&n->replica, n->estado, relogio(n));
+    enviar_pendentes(i);
+}
+
+static void mudar(void) {
+    int i = (int)(sortear() % opcoes.nos);
+    int d = (int)(sortear() % REPLICA_DISPOSITIVOS);
+    nos[i].estado ^= 1u << d;
+    sincronizar(i);
+
+    if (num_mudancas == capacidade_mudancas) {
+        capacidade_mudancas = capacidade_mudancas ? 2 * capacidade_mudancas : 256;
+        mudancas = realloc(mudancas, capacidade_mudancas * sizeof(*mudancas));
+    }
+    mudancas[num_mudancas++] = (mudanca_t){agora, d, nos[i].replica.versoes[d], 0};
+}
+
+static bool convergiu(const mudanca_t *m) {
+    for (int i = 0; i < opcoes.nos; i++) {
+        if (replica_comparar(nos[i].replica.versoes[m->dispositivo], m->versao) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void verificar_convergencia(void) {
+    for (size_t k = primeira_pendente; k < num_mudancas; k++) {
+        if (!mudancas[k].convergiu && convergiu(&mudancas[k])) {
+            mudancas[k].convergiu = agora;
+        }
+    }
+    while (primeira_pendente < num_mudancas && mudancas[primeira_pendente].convergiu) {
+        primeira_pendente++;
+    }
+}
+
+static bool estados_iguais(void) {
+    for (int i = 1; i < opcoes.nos; i++) {
+        if (nos[i].replica.valores != nos[0].replica.valores ||
+            (nos[i].estado & REPLICA_MASCARA) != (nos[0].estado & REPLICA_MASCARA)) {
+            return false;
+        }
+        for (int d = 0; d < REPLICA_DISPOSITIVOS; d++) {
+            if (replica_comparar(nos[i].replica.versoes[d], nos[0].replica.versoes[d]) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static int comparar_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void imprimir_relatorio(void) {
+    uint64_t *tempos = malloc((num_mudancas ? num_mudancas : 1) * sizeof(*tempos));
+    size_t convergidas = 0;
+    for (size_t k = 0; k < num_mudancas; k++) {
+        if (mudancas[k].convergiu) {
+            tempos[convergidas++] = mudancas[k].convergiu - mudancas[k].t;
+        }
+    }
+    qsort(tempos, convergidas, sizeof(*tempos), comparar_u64);
+#define PERCENTIL(p) (convergidas ? tempos[(convergidas - 1) * (p) / 100] : 0)
+
+    uint32_t locais = 0, remotas = 0, reparos = 0, suprimidos = 0, entradas = 0;
+    for (int i = 0; i < opcoes.nos; i++) {
+        const replica_t *r = &nos[i].replica;
+        locais += r->contadores.locais;
+        remotas += r->contadores.remotas;
+        reparos += r->contadores.reparos;
+        suprimidos += r->contadores.suprimidos;
+        entradas += r->contadores.entradas;
+    }
+    double no_segundos = (double)opcoes.nos * (opcoes.duracao_s + opcoes.cauda_s);
+    uint32_t mensagens = trafego.deltas + trafego.resumos;
+    uint64_t bytes = trafego.bytes_deltas + trafego.bytes_resumos;
+
+    printf("{\n");
+    printf("  \"nos\": %d, \"perda\": %.3f, \"latencia_ms\": [%lu, %lu], \"duracao_s\": %lu, \"cauda_s\": %lu,\n",
+           opcoes.nos, opcoes.perda, (unsigned long)opcoes.latencia_min_ms, (unsigned long)opcoes.latencia_max_ms,
+           (unsigned long)opcoes.duracao_s, (unsigned long)opcoes.cauda_s);
+    printf("  \"mudancas\": %zu, \"convergidas\": %zu, \"nao_convergidas\": %zu, \"estados_iguais\": %s,\n",
+           num_mudancas, convergidas, num_mudancas - convergidas, estados_iguais() ? "true" : "false");
+    printf("  \"convergencia_ms\": {\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu},\n",
+           (unsigned long long)PERCENTIL(50), (unsigned long long)PERCENTIL(90),
+           (unsigned long long)PERCENTIL(99), (unsigned long long)(convergidas ? tempos[convergidas - 1] : 0));
+    printf("  \"mensagens\": {\"deltas\": %lu, \"resumos\": %lu, \"entradas_delta\": %lu, "
+           "\"bytes_deltas\": %llu, \"bytes_resumos\": %llu},\n",
+           (unsigned long)trafego.deltas, (unsigned long)trafego.resumos, (unsigned long)entradas,
+           (unsigned long long)trafego.bytes_deltas, (unsigned long long)trafego.bytes_resumos);
+    printf("  \"por_no_por_s\": {\"mensagens\": %.2f, \"bytes\": %.1f},\n", mensagens / no_segundos,
+           bytes / no_segundos);
+    printf("  \"deltas_por_mudanca\": %.2f, \"bytes_delta_por_mudanca\": %.1f,\n",
+           num_mudancas ? (double)trafego.deltas / num_mudancas : 0.0,
+           num_mudancas ? (double)trafego.bytes_deltas / num_mudancas : 0.0);
+    printf("  \"copias\": {\"enviadas\": %llu, \"perdidas\": %llu, \"entregues\": %llu},\n",
+           (unsigned long long)trafego.copias, (unsigned long long)trafego.perdidas,
+           (unsigned long long)trafego.entregues);
+    printf("  \"replicas\": {\"locais\": %lu, \"remotas\": %lu, \"reparos\": %lu, \"suprimidos\": %lu}\n",
+           (unsigned long)locais, (unsigned long)remotas, (unsigned long)reparos, (unsigned long)suprimidos);
+    printf("}\n");
+#undef PERCENTIL
+    free(tempos);
+}
+
+static void uso(const char *programa) {
+    fprintf(stderr,
+            "uso: %s [opções]\n"
+            "  --nos N              placas no grupo (padrão 4, máximo %d)\n"
+            "  --perda P            probabilidade de perda de cada cópia (padrão 0.1)\n"
+            "  --latencia-min-ms N  latência mínima de entrega (padrão 1)\n"
+            "  --latencia-max-ms N  latência máxima de entrega (padrão 20)\n"
+            "  --duracao-s N        tempo com mudanças (padrão 300)\n"
+            "  --cauda-s N          tempo final sem mudanças (padrão 10)\n"
+            "  --mudancas-por-min X mudanças na casa toda (padrão 30)\n"
+            "  --defasagem-s N      diferença máxima entre os boots (padrão 3600)\n"
+            "  --semente N          semente dos sorteios (padrão 1)\n",
+            programa, MAX_NOS);
+}
+
+int main(int argc, char **argv) {
+    static const struct option longas[] = {
+        {"nos", required_argument, NULL, 'n'},
+        {"perda", required_argument, NULL, 'p'},
+        {"latencia-min-ms", required_argument, NULL, 'l'},
+        {"latencia-max-ms", required_argument, NULL, 'L'},
+        {"duracao-s", required_argument, NULL, 'd'},
+        {"cauda-s", required_argument, NULL, 'c'},
+        {"mudancas-por-min", required_argument, NULL, 'm'},
+        {"defasagem-s", required_argument, NULL, 'D'},
+        {"semente", required_argument, NULL, 's'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    int opcao;
+    while ((opcao = getopt_long(argc, argv, "n:p:l:L:d:c:m:D:s:h", longas, NULL)) != -1) {
+        switch (opcao) {
+        case 'n': opcoes.nos = atoi(optarg); break;
+        case 'p': opcoes.perda = atof(optarg); break;
+        case 'l': opcoes.latencia_min_ms = strtoul(optarg, NULL, 10); break;
+        case 'L': opcoes.latencia_max_ms = strtoul(optarg, NULL, 10); break;
+        case 'd': opcoes.duracao_s = strtoul(optarg, NULL, 10); break;
+        case 'c': opcoes.cauda_s = strtoul(optarg, NULL, 10); break;
+        case 'm': opcoes.mudancas_por_min = atof(optarg); break;
+        case 'D': opcoes.defasagem_s = strtoul(optarg, NULL, 10); break;
+        case 's': opcoes.semente = strtoull(optarg, NULL, 10); break;
+        default: uso(argv[0]); return 2;
+        }
+    }
+    if (opcoes.nos < 2 || opcoes.nos > MAX_NOS || opcoes.perda < 0 || opcoes.perda >= 1 ||
+        opcoes.latencia_min_ms > opcoes.latencia_max_ms || opcoes.mudancas_por_min <= 0) {
+        uso(argv[0]);
+        return 2;
+    }
+    aleatorio = opcoes.semente ? opcoes.semente : 1;
+
+    // O tempo global começa depois do boot mais recente
+    static const uint8_t chave[SIPHASH_TAMANHO_CHAVE] = "replicacao-sim..";
+    agora = (uint64_t)opcoes.defasagem_s * 1000 + 1000;
+    for (int i = 0; i < opcoes.nos; i++) {
+        no_t *n = &nos[i];
+        n->boot_ms = sortear() % ((uint64_t)opcoes.defasagem_s * 1000 + 1);
+        replica_iniciar(&n->replica, chave, 0x10000000u + (uint32_t)i, 1, 0, relogio(n));
+        n->proxima_rodada = agora + sortear() % RODADA_MS;
+    }
+
+    uint64_t inicio = agora;
+    uint64_t fim_mudancas = inicio + (uint64_t)opcoes.duracao_s * 1000;
+    uint64_t fim = fim_mudancas + (uint64_t)opcoes.cauda_s * 1000;
+    double media_ms = 60000.0 / opcoes.mudancas_por_min;
+    uint64_t proxima_mudanca = inicio + (uint64_t)(-log(1.0 - sortear_unitario()) * media_ms);
+
+    while (agora < fim) {
+        // Entrega o que chegou até agora; o nó aplica e responde na hora
+        while (num_em_voo && em_voo[0].t <= agora) {
+            entrega_t e = retirar_em_voo();
+            no_t *n = &nos[e.destino];
+            trafego.entregues++;
+            if (replica_receber(&n->replica, e.dados, e.tamanho, relogio(n))) {
+                sincronizar(e.destino);
+            }
+        }
+        while (agora < fim_mudancas && proxima_mudanca <= agora) {
+            mudar();
+            proxima_mudanca += 1 + (uint64_t)(-log(1.0 - sortear_unitario()) * media_ms);
+        }
+        for (int i = 0; i < opcoes.nos; i++) {
+            if (nos[i].proxima_rodada <= agora) {
+                enviar_pendentes(i);
+                nos[i].proxima_rodada += RODADA_MS;
+            }
+        }
+        verificar_convergencia();
+        agora++;
+    }
+
+    imprimir_relatorio();
+    return estados_iguais() ? 0 : 1;
+}
@@ -0,0 +1,1484 @@
+/*
+ * Reprodução no host de uma gravação de entradas do firmware (inc/gravacao.h)
+ *
+ * O firmware inteiro (Projeto_webserver.c e inc/) roda sobre os substitutos
+ * do SDK em host/ e sobre um relógio virtual que começa no instante da
+ * gravação. As entradas gravadas voltam ao firmware assim:
+ *   - eventos (bordas dos botões e dados TCP) são entregues no instante
+ *     gravado, quando o laço dorme em best_effort_wfe_or_timeout;
+ *   - amostras (eco, ADC, LDR) respondem às leituras do firmware: cada
+ *     leitura consome a amostra mais recente até o instante atual mais a
+ *     tolerância, ou repete a anterior se não houver nenhuma nova.
+ * O eco de um ultrassônico avança o relógio pela duração do pulso gravado.
+ *
+ * As saídas (quadros da matriz e do OLED, respostas HTTP e pinos de saída)
+ * vão para um registro em texto, uma por linha:
+ *   <t_us> <tipo> <conteudo>
+ * com t_us contado do início da gravação. Com --referencia, o registro é
+ * comparado com o de uma execução anterior, tipo a tipo e na ordem
+ * (ignorando os instantes), e o código de saída é 1 se houver diferença.
+ *
+ * O resumo sai em JSON na saída padrão: entradas consumidas, tempo de CPU do
+ * host por etapa do laço (as mesmas do supervisor, mais o recebimento HTTP
+ * e o handler dos botões), saídas e diferenças. O texto impresso pelo
+ * firmware vai para a saída de erro.
+ *
+ * Uso:
+ *   reproduzir gravacao.grv [--saida saidas.txt] [--referencia saidas_antes.txt]
+ *              [--tolerancia-ms 50] [--folga-ms 1000]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <getopt.h>
+#include <setjmp.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "lwip/udp.h"
+#include "lwip/igmp.h"
+
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "pico/rand.h"
+#include "hardware/adc.h"
+#include "hardware/clocks.h"
+#include "hardware/flash.h"
+#include "hardware/i2c.h"
+#include "hardware/pio.h"
+#include "hardware/pwm.h"
+#include "animacoes_led.pio.h"
+
+#include "barramento_i2c.h"
+#include "gravacao.h"
+#include "pilha.h"
+#include "supervisor.h"
+
+#define MAX_CANAIS 16
+#define MAX_ALARMES 8
+#define MAX_ETAPAS 16
+#define MAX_PCBS_UDP 4
+#define NUM_PINOS 30
+#define PIXELS_MATRIZ 25
+#define ECO_PADRAO_US 5800           // Eco sem amostra gravada (1 m)
+#define ADC_PADRAO 2048              // Joystick centrado
+#define ADC_TEMPERATURA_PADRAO 876   // ~27 °C
+#define MAX_DIFERENCAS_MOSTRADAS 10
+#define MAX_TIPOS_SAIDA 16
+
+// Firmware (Projeto_webserver.c compilado com main=firmware_main)
+int firmware_main(void);
+void definir_estados(uint32_t palavra);
+void acionar_alarme(bool ativa);
+
+/* ========== GRAVAÇÃO ========== */
+
+typedef struct {
+    uint64_t t;                  // Instante absoluto (relógio virtual)
+    uint8_t tipo;
+    uint32_t a, b, c;            // Campos do registro, conforme o tipo
+    const uint8_t *dados;        // GRAV_TCP_DADOS e GRAV_UDP_DADOS
+    uint16_t tamanho;
+} registro_t;
+
+typedef struct {
+    uint64_t t;
+    uint32_t valor;
+} amostra_t;
+
+// Amostras de uma entrada lida sob demanda (eco de um pino, canal do ADC,
+// nível de um pino), na ordem gravada
+typedef struct {
+    uint8_t tipo, id;
+    amostra_t *itens;
+    size_t n, capacidade;
+    size_t proxima;              // Primeira amostra ainda não consumida
+    uint32_t leituras, repetidas, puladas;
+} canal_t;
+
+static uint8_t *arquivo;
+static registro_t *eventos;
+static size_t num_eventos, capacidade_eventos, evento_atual;
+static canal_t canais[MAX_CANAIS];
+static size_t num_canais;
+
+static struct {
+    uint32_t versao, estado, inicio_us;
+    uint64_t inicio, fim;        // Relógio virtual no início e no último registro
+    uint32_t registros, perdidos;
+    bool terminada;              // Tem GRAV_FIM
+} gravacao;
+
+// Sessão do controle UDP gravada (GRAV_UDP_SESSAO)
+static uint32_t sessao_udp = 0x5EED0001u;
+
+static struct {
+    uint64_t tolerancia_us;
+    uint64_t folga_us;
+    const char *saida;
+    const char *referencia;
+} opcoes = {50000, 1000000, NULL, NULL};
+
+static bool ler_varint(const uint8_t **p, const uint8_t *fim, uint32_t *valor) {
+    uint32_t v = 0;
+    for (int deslocamento = 0; deslocamento < 35; deslocamento += 7) {
+        if (*p >= fim) {
+            return false;
+        }
+        uint8_t b = *(*p)++;
+        v |= (uint32_t)(b & 0x7F) << deslocamento;
+        if (!(b & 0x80)) {
+            *valor = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ler_byte(const uint8_t **p, const uint8_t *fim, uint32_t *valor) {
+    if (*p >= fim) {
+        return false;
+    }
+    *valor = *(*p)++;
+    return true;
+}
+
+static canal_t *buscar_canal(uint8_t tipo, uint8_t id, bool criar) {
+    for (size_t i = 0; i < num_canais; i++) {
+        if (canais[i].tipo == tipo && canais[i].id == id) {
+            return &canais[i];
+        }
+    }
+    if (!criar || num_canais == MAX_CANAIS) {
+        return NULL;
+    }
+    canal_t *c = &canais[num_canais++];
+    c->tipo = tipo;
+    c->id = id;
+    return c;
+}
+
+static void guardar_amostra(uint8_t tipo, uint8_t id, uint64_t t, uint32_t valor) {
+    canal_t *c = buscar_canal(tipo, id, true);
+    if (!c) {
+        return;
+    }
+    if (c->n == c->capacidade) {
+        c->capacidade = c->capacidade ? 2 * c->capacidade : 256;
+        c->itens = realloc(c->itens, c->capacidade * sizeof(amostra_t));
+    }
+    c->itens[c->n++] = (amostra_t){t, valor};
+}
+
+static void guardar_evento(const registro_t *r) {
+    if (num_eventos == capacidade_eventos) {
+        capacidade_eventos = capacidade_eventos ? 2 * capacidade_eventos : 256;
+        eventos = realloc(eventos, capacidade_eventos * sizeof(registro_t));
+    }
+    eventos[num_eventos++] = *r;
+}
+
+// Lê o arquivo inteiro e separa eventos e amostras
+static bool carregar_gravacao(const char *caminho) {
+    FILE *f = fopen(caminho, "rb");
+    if (!f) {
+        perror(caminho);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long tamanho = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    arquivo = malloc(tamanho > 0 ? tamanho : 1);
+    if (fread(arquivo, 1, tamanho, f) != (size_t)tamanho) {
+        fclose(f);
+        fprintf(stderr, "%s: erro de leitura\n", caminho);
+        return false;
+    }
+    fclose(f);
+
+    const uint8_t *p = arquivo;
+    const uint8_t *fim = arquivo + tamanho;
+    uint64_t t = 0;
+    bool cabecalho = false;
+    while (p < fim) {
+        registro_t r = {0};
+        uint32_t dt;
+        const uint8_t *inicio = p;
+        r.tipo = *p++;
+        bool ok = ler_varint(&p, fim, &dt);
+        t += dt;
+        r.t = t;
+        switch (r.tipo) {
+        case GRAV_CABECALHO:
+            ok = ok && ler_byte(&p, fim, &gravacao.versao) && ler_varint(&p, fim, &gravacao.estado) && p + 4 <= fim;
+            if (ok) {
+                gravacao.inicio_us = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+                p += 4;
+                t = gravacao.inicio_us;
+                gravacao.inicio = t;
+                cabecalho = true;
+            }
+            break;
+        case GRAV_ECO:
+            ok = ok && ler_byte(&p, fim, &r.a) && ler_varint(&p, fim, &r.b);
+            break;
+        case GRAV_ADC:
+            ok = ok && ler_byte(&p, fim, &r.a) && ler_varint(&p, fim, &r.b);
+            break;
+        case GRAV_NIVEL:
+            ok = ok && ler_byte(&p, fim, &r.a) && ler_byte(&p, fim, &r.b);
+            break;
+        case GRAV_BORDA:
+            ok = ok && ler_byte(&p, fim, &r.a) && ler_byte(&p, fim, &r.b) && ler_byte(&p, fim, &r.c);
+            break;
+        case GRAV_TCP_ABRIR:
+        case GRAV_TCP_FECHAR:
+            ok = ok && ler_varint(&p, fim, &r.a);
+            break;
+        case GRAV_TCP_DADOS:
+        case GRAV_UDP_DADOS:
+            ok = ok && ler_varint(&p, fim, &r.a) && ler_varint(&p, fim, &r.b) && r.b <= (uint32_t)(fim - p);
+            if (ok) {
+                r.dados = p;
+                r.tamanho = (uint16_t)r.b;
+                p += r.b;
+            }
+            break;
+        case GRAV_UDP_SESSAO:
+            ok = ok && p + 4 <= fim;
+            if (ok) {
+                sessao_udp = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+                p += 4;
+            }
+            break;
+        case GRAV_PERDA:
+            ok = ok && ler_varint(&p, fim, &r.a);
+            gravacao.perdidos += r.a;
+            break;
+        case GRAV_FIM:
+            gravacao.terminada = true;
+            break;
+        default:
+            ok = false;
+            break;
+        }
+        if (!ok || (!cabecalho && r.tipo != GRAV_CABECALHO)) {
+            fprintf(stderr, "%s: registro inválido (tipo 0x%02x) no byte %ld\n", caminho, r.tipo,
+                    (long)(inicio - arquivo));
+            return false;
+        }
+        if (gravacao.terminada) {
+            break;
+        }
+        gravacao.registros++;
+        gravacao.fim = t;
+
+        switch (r.tipo) {
+        case GRAV_ECO:
+        case GRAV_ADC:
+        case GRAV_NIVEL:
+            guardar_amostra(r.tipo, (uint8_t)r.a, r.t, r.b);
+            break;
+        case GRAV_BORDA:
+        case GRAV_TCP_ABRIR:
+        case GRAV_TCP_DADOS:
+        case GRAV_TCP_FECHAR:
+        case GRAV_UDP_DADOS:
+            guardar_evento(&r);
+            break;
+        }
+    }
+    if (!cabecalho) {
+        fprintf(stderr, "%s: gravação vazia\n", caminho);
+        return false;
+    }
+    if (gravacao.versao != GRAVACAO_VERSAO) {
+        fprintf(stderr, "%s: versão %lu não suportada\n", caminho, (unsigned long)gravacao.versao);
+        return false;
+    }
+    return true;
+}
+
+/* ========== RELÓGIO VIRTUAL E ALARMES ========== */
+
+static uint64_t agora;
+static jmp_buf fim_reproducao;
+
+typedef struct {
+    bool ativo;
+    uint64_t t;
+    alarm_callback_t callback;
+    void *dados;
+} alarme_t;
+
+static alarme_t alarmes[MAX_ALARMES];
+
+const absolute_time_t nil_time = 0;
+const absolute_time_t at_the_end_of_time = INT64_MAX;     // Como no SDK
+
+static uint64_t proximo_alarme(void) {
+    uint64_t t = UINT64_MAX;
+    for (int i = 0; i < MAX_ALARMES; i++) {
+        if (alarmes[i].ativo && alarmes[i].t < t) {
+            t = alarmes[i].t;
+        }
+    }
+    return t;
+}
+
+// Leva o relógio até t, disparando no caminho os alarmes vencidos (como
+// interrupções de timer durante uma espera)
+static void avancar_ate(uint64_t t) {
+    uint64_t proximo;
+    while ((proximo = proximo_alarme()) <= t) {
+        for (int i = 0; i < MAX_ALARMES; i++) {
+            alarme_t *a = &alarmes[i];
+            if (!a->ativo || a->t != proximo) {
+                continue;
+            }
+            if (agora < a->t) {
+                agora = a->t;
+            }
+            a->ativo = false;
+            int64_t repetir = a->callback(i + 1, a->dados);
+            if (repetir != 0) {
+                a->t = repetir > 0 ? a->t + (uint64_t)repetir : agora + (uint64_t)(-repetir);
+                a->ativo = true;
+            }
+        }
+    }
+    if (agora < t) {
+        agora = t;
+    }
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t)agora;
+}
+
+uint64_t time_us_64(void) {
+    return agora;
+}
+
+absolute_time_t get_absolute_time(void) {
+    return agora;
+}
+
+absolute_time_t make_timeout_time_us(uint64_t us) {
+    return agora + us;
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms) {
+    return agora + (uint64_t)ms * 1000;
+}
+
+bool time_reached(absolute_time_t t) {
+    return agora >= t;
+}
+
+void sleep_us(uint64_t us) {
+    avancar_ate(agora + us);
+}
+
+void sleep_ms(uint32_t ms) {
+    avancar_ate(agora + (uint64_t)ms * 1000);
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *dados, bool disparar_se_passado) {
+    (void)disparar_se_passado;
+    for (int i = 0; i < MAX_ALARMES; i++) {
+        if (!alarmes[i].ativo) {
+            alarmes[i] = (alarme_t){true, agora + us, callback, dados};
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *dados, bool disparar_se_passado) {
+    return add_alarm_in_us((uint64_t)ms * 1000, callback, dados, disparar_se_passado);
+}
+
+/* ========== ETAPAS (TEMPO DE CPU DO HOST) ========== */
+
+typedef struct {
+    const char *nome;
+    uint64_t *duracoes_ns;
+    size_t n, capacidade;
+    uint64_t inicio_ns;
+} etapa_t;
+
+static etapa_t etapas[MAX_ETAPAS];
+static int num_etapas;
+
+static uint64_t relogio_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + t.tv_nsec;
+}
+
+static int registrar_etapa(const char *nome) {
+    for (int i = 0; i < num_etapas; i++) {
+        if (strcmp(etapas[i].nome, nome) == 0) {
+            return i;
+        }
+    }
+    if (num_etapas == MAX_ETAPAS) {
+        return -1;
+    }
+    etapas[num_etapas].nome = nome;
+    return num_etapas++;
+}
+
+static void comecar_etapa(int i) {
+    if (i >= 0) {
+        etapas[i].inicio_ns = relogio_ns();
+    }
+}
+
+static void terminar_etapa(int i) {
+    if (i < 0) {
+        return;
+    }
+    etapa_t *e = &etapas[i];
+    if (e->n == e->capacidade) {
+        e->capacidade = e->capacidade ? 2 * e->capacidade : 256;
+        e->duracoes_ns = realloc(e->duracoes_ns, e->capacidade * sizeof(uint64_t));
+    }
+    e->duracoes_ns[e->n++] = relogio_ns() - e->inicio_ns;
+}
+
+static int etapa_http = -1, etapa_botoes = -1, etapa_udp = -1;
+
+// Supervisor do firmware: aqui só mede cada tarefa e etapa do laço. É
+// chamado logo antes do laço principal, onde a gravação começa.
+int supervisor_registrar(const char *nome, uint32_t orcamento_ms) {
+    (void)orcamento_ms;
+    return registrar_etapa(nome);
+}
+
+// A reprodução parte da palavra de estados gravada, não de uma falha
+bool supervisor_contexto_anterior(uint32_t *contexto) {
+    (void)contexto;
+    return false;
+}
+
+void supervisor_iniciar(uint32_t (*contexto)(void)) {
+    (void)contexto;
+    if (agora < gravacao.inicio) {
+        agora = gravacao.inicio;
+    }
+    definir_estados(gravacao.estado);
+    if (gravacao.estado & (1u << 7)) {
+        acionar_alarme(true);
+    }
+}
+
+void supervisor_comecar(int tarefa) {
+    comecar_etapa(tarefa);
+}
+
+void supervisor_terminar(int tarefa) {
+    terminar_etapa(tarefa);
+}
+
+void supervisor_alimentar(void) {
+}
+
+int supervisor_relatorio(char *buf, size_t tamanho) {
+    return snprintf(buf, tamanho, "supervisor: reproducao\n");
+}
+
+// Sem pintura de pilha no host
+void pilha_pintar(void) {
+}
+
+void pilha_entrar(pilha_ponto_t *ponto) {
+    (void)ponto;
+}
+
+void pilha_sair(pilha_ponto_t *ponto) {
+    (void)ponto;
+}
+
+bool pilha_verificar(void) {
+    return false;
+}
+
+int pilha_relatorio(char *buf, size_t tamanho) {
+    return snprintf(buf, tamanho, "pilha: reproducao\n");
+}
+
+/* ========== REGISTRO DE SAÍDAS ========== */
+
+typedef struct {
+    char **linhas;
+    size_t n, capacidade;
+} registro_saidas_t;
+
+static registro_saidas_t saidas;
+static uint32_t contagem_matriz, contagem_oled, contagem_http, contagem_gpio;
+
+static void registrar_saida(const char *formato, ...) __attribute__((format(printf, 1, 2)));
+
+static void registrar_saida(const char *formato, ...) {
+    char linha[512];
+    int n = snprintf(linha, sizeof(linha), "%llu ", (unsigned long long)(agora - gravacao.inicio));
+    va_list args;
+    va_start(args, formato);
+    vsnprintf(linha + n, sizeof(linha) - n, formato, args);
+    va_end(args);
+    if (saidas.n == saidas.capacidade) {
+        saidas.capacidade = saidas.capacidade ? 2 * saidas.capacidade : 1024;
+        saidas.linhas = realloc(saidas.linhas, saidas.capacidade * sizeof(char *));
+    }
+    saidas.linhas[saidas.n++] = strdup(linha);
+}
+
+static uint32_t crc32(const uint8_t *dados, size_t tamanho) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < tamanho; i++) {
+        crc ^= dados[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/* ========== GPIO, ADC, PWM, CLOCKS ========== */
+
+static struct {
+    bool saida, nivel, pull_up, botao, eco_alto;
+    uint32_t irq;
+    uint64_t eco_fim;
+} pinos[NUM_PINOS];
+
+static gpio_irq_callback_t callback_gpio;
+static uint32_t mascara_exibida;       // Pinos de saída no último registro
+static uint canal_adc;
+
+// Consome a amostra do canal para uma leitura feita agora
+static bool ler_amostra(uint8_t tipo, uint8_t id, uint32_t *valor) {
+    canal_t *c = buscar_canal(tipo, id, false);
+    if (!c || c->n == 0) {
+        return false;
+    }
+    c->leituras++;
+    size_t j = c->proxima;
+    if (j < c->n && c->itens[j].t <= agora + opcoes.tolerancia_us) {
+        while (j + 1 < c->n && c->itens[j + 1].t <= agora + opcoes.tolerancia_us) {
+            j++;
+        }
+        c->puladas += j - c->proxima;
+        c->proxima = j + 1;
+    } else {
+        c->repetidas++;
+        j = c->proxima ? c->proxima - 1 : 0;
+    }
+    *valor = c->itens[j].valor;
+    return true;
+}
+
+void gpio_init(uint gpio) {
+    pinos[gpio].saida = false;
+    pinos[gpio].nivel = false;
+}
+
+void gpio_set_dir(uint gpio, bool saida) {
+    pinos[gpio].saida = saida;
+}
+
+void gpio_put(uint gpio, bool valor) {
+    pinos[gpio].nivel = valor;
+}
+
+void gpio_pull_up(uint gpio) {
+    pinos[gpio].pull_up = true;
+    pinos[gpio].nivel = true;
+}
+
+void gpio_set_function(uint gpio, uint funcao) {
+    (void)gpio;
+    (void)funcao;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t eventos_irq, bool habilitar) {
+    if (habilitar) {
+        pinos[gpio].irq |= eventos_irq;
+    } else {
+        pinos[gpio].irq &= ~eventos_irq;
+    }
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t eventos_irq, bool habilitar,
+                                        gpio_irq_callback_t callback) {
+    gpio_set_irq_enabled(gpio, eventos_irq, habilitar);
+    callback_gpio = callback;
+}
+
+// Saídas e botões devolvem o nível atual; pinos com nível gravado (LDR), a
+// amostra; os demais são ecos de ultrassônico: sobem na primeira leitura e
+// descem na seguinte, com o relógio avançado pela duração do pulso gravado
+bool gpio_get(uint gpio) {
+    uint32_t valor;
+    if (pinos[gpio].saida || pinos[gpio].botao || pinos[gpio].pull_up) {
+        return pinos[gpio].nivel;
+    }
+    if (ler_amostra(GRAV_NIVEL, gpio, &valor)) {
+        return valor != 0;
+    }
+    if (!pinos[gpio].eco_alto) {
+        pinos[gpio].eco_alto = true;
+        pinos[gpio].eco_fim = agora + (ler_amostra(GRAV_ECO, gpio, &valor) ? valor : ECO_PADRAO_US);
+        return true;
+    }
+    avancar_ate(pinos[gpio].eco_fim);
+    pinos[gpio].eco_alto = false;
+    return false;
+}
+
+void adc_init(void) {
+}
+
+void adc_gpio_init(uint gpio) {
+    (void)gpio;
+}
+
+void adc_set_temp_sensor_enabled(bool habilitar) {
+    (void)habilitar;
+}
+
+void adc_select_input(uint canal) {
+    canal_adc = canal;
+}
+
+uint16_t adc_read(void) {
+    uint32_t valor;
+    if (ler_amostra(GRAV_ADC, canal_adc, &valor)) {
+        return (uint16_t)valor;
+    }
+    return canal_adc == 4 ? ADC_TEMPERATURA_PADRAO : ADC_PADRAO;
+}
+
+void pwm_set_wrap(uint fatia, uint16_t topo) {
+    (void)fatia;
+    (void)topo;
+}
+
+void pwm_set_gpio_level(uint gpio, uint16_t nivel) {
+    (void)gpio;
+    (void)nivel;
+}
+
+void pwm_set_enabled(uint fatia, bool habilitar) {
+    (void)fatia;
+    (void)habilitar;
+}
+
+uint32_t clock_get_hz(enum clock_index relogio) {
+    (void)relogio;
+    return 125000000;
+}
+
+bool clock_configure(enum clock_index relogio, uint32_t fonte, uint32_t fonte_aux, uint32_t freq_origem,
+                     uint32_t freq) {
+    (void)relogio;
+    (void)fonte;
+    (void)fonte_aux;
+    (void)freq_origem;
+    (void)freq;
+    return true;
+}
+
+void stdio_init_all(void) {
+}
+
+// Só o controle UDP sorteia no boot: devolve a sessão da gravação, para que
+// os lotes gravados sejam aceitos como foram na placa
+uint32_t get_rand_32(void) {
+    return sessao_udp;
+}
+
+/* ========== FLASH, MATRIZ (PIO) E OLED (I2C) ========== */
+
+uint8_t flash_simulada[PICO_FLASH_SIZE_BYTES];
+
+void flash_range_erase(uint32_t deslocamento, size_t tamanho) {
+    memset(flash_simulada + deslocamento, 0xFF, tamanho);
+}
+
+void flash_range_program(uint32_t deslocamento, const uint8_t *dados, size_t tamanho) {
+    memcpy(flash_simulada + deslocamento, dados, tamanho);
+}
+
+struct pio_hw {
+    int numero;
+};
+
+static struct pio_hw pio_simulado;
+PIO const pio0 = &pio_simulado;
+const pio_program_t animacoes_led_program = {NULL, 0, -1};
+
+static uint32_t pixels[PIXELS_MATRIZ];
+static int num_pixels;
+
+uint pio_add_program(PIO pio, const pio_program_t *programa) {
+    (void)pio;
+    (void)programa;
+    return 0;
+}
+
+int pio_claim_unused_sm(PIO pio, bool obrigatorio) {
+    (void)pio;
+    (void)obrigatorio;
+    return 0;
+}
+
+void animacoes_led_program_init(PIO pio, uint sm, uint offset, uint pino) {
+    (void)pio;
+    (void)sm;
+    (void)offset;
+    (void)pino;
+}
+
+// Um quadro da matriz a cada PIXELS_MATRIZ palavras
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t dado) {
+    (void)pio;
+    (void)sm;
+    pixels[num_pixels++] = dado;
+    if (num_pixels < PIXELS_MATRIZ) {
+        return;
+    }
+    num_pixels = 0;
+    char texto[PIXELS_MATRIZ * 9 + 1];
+    int n = 0;
+    for (int i = 0; i < PIXELS_MATRIZ; i++) {
+        n += snprintf(texto + n, sizeof(texto) - n, "%s%08lx", i ? "," : "", (unsigned long)pixels[i]);
+    }
+    registrar_saida("matriz %s", texto);
+    contagem_matriz++;
+}
+
+struct i2c_inst {
+    int numero;
+};
+
+static struct i2c_inst i2c_simulado[2] = {{0}, {1}};
+i2c_inst_t *const i2c0 = &i2c_simulado[0];
+i2c_inst_t *const i2c1 = &i2c_simulado[1];
+
+static uint32_t frequencia_i2c;
+
+// Substitui inc/barramento_i2c.c: cada transação é concluída na hora do
+// enfileiramento, sem tempo de barramento
+bool barramento_i2c_iniciar(i2c_inst_t *i2c, uint sda, uint scl, uint32_t frequencia_hz) {
+    (void)i2c;
+    (void)sda;
+    (void)scl;
+    frequencia_i2c = frequencia_hz;
+    return true;
+}
+
+// Percorre os bytes de controle do SSD1306: pares de comando (Co = 1) são
+// pulados e o fluxo de dados (0x40 e o quadro) é registrado pelo CRC do quadro
+static void registrar_oled(uint8_t endereco, const uint8_t *dados, size_t tamanho) {
+    size_t i = 0;
+    while (i + 1 < tamanho && (dados[i] & 0x80)) {
+        i += 2;
+    }
+    if (i + 1 < tamanho && dados[i] == 0x40) {
+        size_t n = tamanho - i - 1;
+        registrar_saida("oled %02x %zu %08lx", endereco, n, (unsigned long)crc32(dados + i + 1, n));
+        contagem_oled++;
+    }
+}
+
+bool barramento_i2c_enfileirar(transacao_i2c_t *t) {
+    if (t->tamanho + t->tamanho_leitura == 0) {
+        return false;
+    }
+    t->enfileirada_us = t->inicio_us = t->fim_us = time_us_32();
+    registrar_oled(t->endereco, t->escrita, t->tamanho);
+    if (t->tamanho_leitura) {
+        memset(t->leitura, 0, t->tamanho_leitura);
+    }
+    t->estado = I2C_CONCLUIDA;
+    if (t->concluida) {
+        t->concluida(t);
+    }
+    return true;
+}
+
+bool barramento_i2c_ocupada(const transacao_i2c_t *t) {
+    return t->estado == I2C_NA_FILA || t->estado == I2C_EM_CURSO;
+}
+
+bool barramento_i2c_esperar(transacao_i2c_t *t) {
+    return t->estado == I2C_CONCLUIDA;
+}
+
+void barramento_i2c_vigiar(void) {
+}
+
+uint32_t barramento_i2c_frequencia(void) {
+    return frequencia_i2c;
+}
+
+int barramento_i2c_relatorio(char *buf, size_t tamanho) {
+    return snprintf(buf, tamanho, "frequencia=%luHz\n", (unsigned long)frequencia_i2c);
+}
+
+/* ========== WIFI E LWIP ========== */
+
+cyw43_t cyw43_state;
+struct netif *netif_default;     // Sem interface: o firmware não mostra IP
+
+int cyw43_arch_init(void) {
+    return 0;
+}
+
+void cyw43_arch_deinit(void) {
+}
+
+void cyw43_arch_enable_sta_mode(void) {
+}
+
+int cyw43_arch_wifi_connect_timeout_ms(const char *ssid, const char *senha, uint32_t autenticacao,
+                                       uint32_t tempo_ms) {
+    (void)ssid;
+    (void)senha;
+    (void)autenticacao;
+    (void)tempo_ms;
+    return 0;
+}
+
+void cyw43_arch_gpio_put(uint pino, bool valor) {
+    (void)pino;
+    registrar_saida("led_wifi %d", valor);
+}
+
+int cyw43_wifi_pm(cyw43_t *self, uint32_t modo) {
+    (void)self;
+    (void)modo;
+    return 0;
+}
+
+struct pbuf *pbuf_alloc(pbuf_layer camada, u16_t tamanho, pbuf_type tipo) {
+    (void)camada;
+    (void)tipo;
+    struct pbuf *p = calloc(1, sizeof(struct pbuf) + tamanho);
+    p->payload = p + 1;
+    p->len = p->tot_len = tamanho;
+    p->ref = 1;
+    return p;
+}
+
+u8_t pbuf_free(struct pbuf *p) {
+    u8_t n = 0;
+    while (p) {
+        struct pbuf *proximo = p->next;
+        free(p);
+        p = proximo;
+        n++;
+    }
+    return n;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *destino, u16_t tamanho, u16_t deslocamento) {
+    u16_t copiados = 0;
+    for (; p && copiados < tamanho; p = p->next) {
+        if (deslocamento >= p->len) {
+            deslocamento -= p->len;
+            continue;
+        }
+        u16_t n = p->len - deslocamento;
+        if (n > tamanho - copiados) {
+            n = tamanho - copiados;
+        }
+        memcpy((uint8_t *)destino + copiados, (const uint8_t *)p->payload + deslocamento, n);
+        copiados += n;
+        deslocamento = 0;
+    }
+    return copiados;
+}
+
+// Conexão TCP simulada: o servidor recebe &pcb; o resto é do simulador. Todo
+// envio é confirmado na volta seguinte do laço (ou logo após cada evento).
+typedef struct conexao_simulada {
+    struct tcp_pcb pcb;
+    uint32_t numero;             // Número da conexão na gravação (0 = escuta)
+    void *arg;
+    tcp_recv_fn recv;
+    tcp_sent_fn sent;
+    tcp_accept_fn accept;
+    bool fechada;
+    uint8_t *saida;              // Bytes escritos desde o último registro
+    size_t tam_saida, cap_saida;
+    uint32_t em_voo;             // Bytes escritos ainda não confirmados
+    struct conexao_simulada *proxima;
+} conexao_simulada_t;
+
+static conexao_simulada_t *conexoes;
+static conexao_simulada_t *escuta;
+static uint32_t eventos_ignorados;
+
+static conexao_simulada_t *simulada(struct tcp_pcb *pcb) {
+    return (conexao_simulada_t *)pcb;
+}
+
+static conexao_simulada_t *nova_conexao(uint32_t numero) {
+    conexao_simulada_t *c = calloc(1, sizeof(conexao_simulada_t));
+    c->numero = numero;
+    c->pcb.snd_buf = TCP_SND_BUF;
+    c->proxima = conexoes;
+    conexoes = c;
+    return c;
+}
+
+static conexao_simulada_t *buscar_conexao(uint32_t numero) {
+    for (conexao_simulada_t *c = conexoes; c; c = c->proxima) {
+        if (c->numero == numero && !c->fechada) {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+// Registra a resposta acumulada: tamanho, CRC e a primeira linha
+static void registrar_resposta(conexao_simulada_t *c) {
+    if (c->tam_saida == 0) {
+        return;
+    }
+    char primeira[80];
+    size_t n = 0;
+    while (n < c->tam_saida && n < sizeof(primeira) - 1 && c->saida[n] != '\r' && c->saida[n] != '\n') {
+        char ch = (char)c->saida[n];
+        primeira[n++] = ch >= 0x20 && ch < 0x7F ? ch : '.';
+    }
+    primeira[n] = '\0';
+    registrar_saida("http %lu %zu %08lx %s", (unsigned long)c->numero, c->tam_saida,
+                    (unsigned long)crc32(c->saida, c->tam_saida), primeira);
+    contagem_http++;
+    c->tam_saida = 0;
+}
+
+struct tcp_pcb *tcp_new(void) {
+    return &nova_conexao(0)->pcb;
+}
+
+err_t tcp_bind(struct tcp_pcb *pcb, const ip_addr_t *endereco, u16_t porta) {
+    (void)pcb;
+    (void)endereco;
+    (void)porta;
+    return ERR_OK;
+}
+
+struct tcp_pcb *tcp_listen_with_backlog(struct tcp_pcb *pcb, u8_t fila) {
+    (void)fila;
+    escuta = simulada(pcb);
+    return pcb;
+}
+
+void tcp_accept(struct tcp_pcb *pcb, tcp_accept_fn accept) {
+    simulada(pcb)->accept = accept;
+}
+
+void tcp_arg(struct tcp_pcb *pcb, void *arg) {
+    simulada(pcb)->arg = arg;
+}
+
+void tcp_recv(struct tcp_pcb *pcb, tcp_recv_fn recv) {
+    simulada(pcb)->recv = recv;
+}
+
+void tcp_sent(struct tcp_pcb *pcb, tcp_sent_fn sent) {
+    simulada(pcb)->sent = sent;
+}
+
+void tcp_err(struct tcp_pcb *pcb, tcp_err_fn err) {
+    (void)pcb;
+    (void)err;
+}
+
+void tcp_poll(struct tcp_pcb *pcb, tcp_poll_fn poll, u8_t intervalo) {
+    (void)pcb;
+    (void)poll;
+    (void)intervalo;
+}
+
+void tcp_recved(struct tcp_pcb *pcb, u16_t tamanho) {
+    (void)pcb;
+    (void)tamanho;
+}
+
+err_t tcp_write(struct tcp_pcb *pcb, const void *dados, u16_t tamanho, u8_t flags) {
+    (void)flags;
+    conexao_simulada_t *c = simulada(pcb);
+    if (tamanho > pcb->snd_buf || pcb->snd_queuelen >= TCP_SND_QUEUELEN) {
+        return ERR_MEM;
+    }
+    if (c->tam_saida + tamanho > c->cap_saida) {
+        c->cap_saida = 2 * (c->tam_saida + tamanho);
+        c->saida = realloc(c->saida, c->cap_saida);
+    }
+    memcpy(c->saida + c->tam_saida, dados, tamanho);
+    c->tam_saida += tamanho;
+    pcb->snd_buf -= tamanho;
+    pcb->snd_queuelen++;
+    c->em_voo += tamanho;
+    return ERR_OK;
+}
+
+err_t tcp_output(struct tcp_pcb *pcb) {
+    (void)pcb;
+    return ERR_OK;
+}
+
+err_t tcp_close(struct tcp_pcb *pcb) {
+    conexao_simulada_t *c = simulada(pcb);
+    registrar_resposta(c);
+    registrar_saida("http_fechada %lu", (unsigned long)c->numero);
+    c->fechada = true;
+    return ERR_OK;
+}
+
+void tcp_abort(struct tcp_pcb *pcb) {
+    tcp_close(pcb);
+}
+
+// UDP: os datagramas gravados (controle e replicação) vão ao callback da PCB
+// associada à porta
+static struct udp_pcb pcbs_udp[MAX_PCBS_UDP];
+static int num_pcbs_udp;
+
+struct udp_pcb *udp_new(void) {
+    if (num_pcbs_udp == MAX_PCBS_UDP) {
+        return NULL;
+    }
+    return &pcbs_udp[num_pcbs_udp++];
+}
+
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *endereco, u16_t porta) {
+    (void)endereco;
+    pcb->local_port = porta;
+    return ERR_OK;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *arg) {
+    pcb->recv = recv;
+    pcb->recv_arg = arg;
+}
+
+err_t igmp_joingroup(const ip4_addr_t *interface, const ip4_addr_t *grupo) {
+    (void)interface;
+    (void)grupo;
+    return ERR_OK;
+}
+
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *destino, u16_t porta) {
+    (void)pcb;
+    (void)p;
+    (void)destino;
+    (void)porta;
+    return ERR_OK;
+}
+
+// Confirma tudo o que está em voo (o servidor continua as respostas no
+// tcp_sent) e registra o que foi escrito
+static void confirmar_envios(void) {
+    bool houve = true;
+    for (int volta = 0; houve && volta < 1000; volta++) {
+        houve = false;
+        for (conexao_simulada_t *c = conexoes; c; c = c->proxima) {
+            if (c->em_voo == 0 || c->fechada) {
+                continue;
+            }
+            u16_t confirmados = (u16_t)c->em_voo;
+            c->em_voo = 0;
+            c->pcb.snd_buf += confirmados;
+            c->pcb.snd_queuelen = 0;
+            if (c->sent) {
+                c->sent(c->arg, &c->pcb, confirmados);
+            }
+            houve = true;
+        }
+    }
+    for (conexao_simulada_t *c = conexoes; c; c = c->proxima) {
+        registrar_resposta(c);
+    }
+}
+
+// Registra os pinos de saída quando algum muda entre duas voltas do laço
+static void registrar_pinos(void) {
+    uint32_t mascara = 0;
+    for (int i = 0; i < NUM_PINOS; i++) {
+        if (pinos[i].saida && pinos[i].nivel) {
+            mascara |= 1u << i;
+        }
+    }
+    if (mascara != mascara_exibida) {
+        mascara_exibida = mascara;
+        registrar_saida("gpio %08lx", (unsigned long)mascara);
+        contagem_gpio++;
+    }
+}
+
+/* ========== EVENTOS ========== */
+
+static void entregar_tcp(const registro_t *r) {
+    conexao_simulada_t *c;
+    switch (r->tipo) {
+    case GRAV_TCP_ABRIR:
+        if (!escuta || !escuta->accept) {
+            eventos_ignorados++;
+            return;
+        }
+        c = nova_conexao(r->a);
+        comecar_etapa(etapa_http);
+        err_t resultado = escuta->accept(escuta->arg, &c->pcb, ERR_OK);
+        terminar_etapa(etapa_http);
+        if (resultado != ERR_OK) {
+            // O lwIP aborta a PCB recusada
+            registrar_saida("http_recusada %lu", (unsigned long)c->numero);
+            c->fechada = true;
+        }
+        break;
+    case GRAV_TCP_DADOS:
+        c = buscar_conexao(r->a);
+        if (!c || !c->recv) {
+            eventos_ignorados++;
+            return;
+        }
+        struct pbuf *p = pbuf_alloc(PBUF_RAW, r->tamanho, PBUF_RAM);
+        memcpy(p->payload, r->dados, r->tamanho);
+        comecar_etapa(etapa_http);
+        c->recv(c->arg, &c->pcb, p, ERR_OK);
+        terminar_etapa(etapa_http);
+        break;
+    case GRAV_TCP_FECHAR:
+        c = buscar_conexao(r->a);
+        if (!c || !c->recv) {
+            eventos_ignorados++;
+            return;
+        }
+        c->recv(c->arg, &c->pcb, NULL, ERR_OK);
+        break;
+    }
+}
+
+static void entregar_udp(const registro_t *r) {
+    for (int i = 0; i < num_pcbs_udp; i++) {
+        struct udp_pcb *pcb = &pcbs_udp[i];
+        if (pcb->local_port == r->a && pcb->recv) {
+            struct pbuf *p = pbuf_alloc(PBUF_RAW, r->tamanho, PBUF_RAM);
+            memcpy(p->payload, r->dados, r->tamanho);
+            comecar_etapa(etapa_udp);
+            pcb->recv(pcb->recv_arg, pcb, p, IP_ADDR_ANY, (u16_t)r->a);
+            terminar_etapa(etapa_udp);
+            return;
+        }
+    }
+    eventos_ignorados++;
+}
+
+static void entregar_evento(const registro_t *r) {
+    if (r->tipo == GRAV_UDP_DADOS) {
+        entregar_udp(r);
+    } else if (r->tipo == GRAV_BORDA) {
+        uint gpio = r->a;
+        pinos[gpio].botao = true;
+        pinos[gpio].nivel = r->c != 0;
+        if (callback_gpio && (pinos[gpio].irq & r->b)) {
+            comecar_etapa(etapa_botoes);
+            callback_gpio(gpio, r->b);
+            terminar_etapa(etapa_botoes);
+        }
+    } else {
+        entregar_tcp(r);
+    }
+    confirmar_envios();
+}
+
+// O laço dorme aqui: entrega o próximo evento gravado se ele vier antes do
+// prazo, senão avança até o prazo. Termina a reprodução depois da folga.
+bool best_effort_wfe_or_timeout(absolute_time_t prazo) {
+    confirmar_envios();
+    registrar_pinos();
+    uint64_t limite = gravacao.fim + opcoes.folga_us;
+    if (evento_atual < num_eventos && eventos[evento_atual].t <= prazo) {
+        const registro_t *r = &eventos[evento_atual++];
+        avancar_ate(r->t);
+        entregar_evento(r);
+        return false;
+    }
+    if (prazo >= limite) {
+        avancar_ate(limite);
+        longjmp(fim_reproducao, 1);
+    }
+    avancar_ate(prazo);
+    return true;
+}
+
+/* ========== COMPARAÇÃO E RELATÓRIO ========== */
+
+// Tipo (segundo campo) e conteúdo (a partir do terceiro) de uma linha
+static const char *separar(const char *linha, char *tipo, size_t tamanho) {
+    const char *p = strchr(linha, ' ');
+    p = p ? p + 1 : linha;
+    size_t n = strcspn(p, " ");
+    if (n >= tamanho) {
+        n = tamanho - 1;
+    }
+    memcpy(tipo, p, n);
+    tipo[n] = '\0';
+    p += n;
+    return *p == ' ' ? p + 1 : p;
+}
+
+static struct {
+    uint32_t iguais, diferentes, faltando, sobrando;
+} comparacao;
+
+// Compara as saídas com as da referência, tipo a tipo e na ordem
+static bool comparar(const char *caminho) {
+    FILE *f = fopen(caminho, "r");
+    if (!f) {
+        perror(caminho);
+        return false;
+    }
+    registro_saidas_t ref = {0};
+    char linha[1024];
+    while (fgets(linha, sizeof(linha), f)) {
+        linha[strcspn(linha, "\r\n")] = '\0';
+        if (linha[0] == '\0') {
+            continue;
+        }
+        if (ref.n == ref.capacidade) {
+            ref.capacidade = ref.capacidade ? 2 * ref.capacidade : 1024;
+            ref.linhas = realloc(ref.linhas, ref.capacidade * sizeof(char *));
+        }
+        ref.linhas[ref.n++] = strdup(linha);
+    }
+    fclose(f);
+
+    // Cada linha casa com a próxima da referência de mesmo tipo; cada tipo
+    // tem o seu cursor, que só avança
+    struct {
+        char tipo[32];
+        size_t cursor;
+    } cursores[MAX_TIPOS_SAIDA];
+    int num_tipos = 0;
+    bool *usada = calloc(ref.n + 1, sizeof(bool));
+    uint32_t mostradas = 0;
+    for (size_t i = 0; i < saidas.n; i++) {
+        char tipo[32], tipo_ref[32];
+        const char *conteudo = separar(saidas.linhas[i], tipo, sizeof(tipo));
+        int k = 0;
+        while (k < num_tipos && strcmp(cursores[k].tipo, tipo) != 0) {
+            k++;
+        }
+        if (k == num_tipos && num_tipos < MAX_TIPOS_SAIDA) {
+            strcpy(cursores[num_tipos].tipo, tipo);
+            cursores[num_tipos++].cursor = 0;
+        }
+        size_t j = k < num_tipos ? cursores[k].cursor : ref.n;
+        const char *conteudo_ref = NULL;
+        for (; j < ref.n; j++) {
+            conteudo_ref = separar(ref.linhas[j], tipo_ref, sizeof(tipo_ref));
+            if (strcmp(tipo, tipo_ref) == 0) {
+                break;
+            }
+        }
+        if (j == ref.n) {
+            if (k < num_tipos) {
+                cursores[k].cursor = ref.n;
+            }
+            comparacao.sobrando++;
+            if (mostradas++ < MAX_DIFERENCAS_MOSTRADAS) {
+                fprintf(stderr, "+ %s\n", saidas.linhas[i]);
+            }
+            continue;
+        }
+        cursores[k].cursor = j + 1;
+        usada[j] = true;
+        if (strcmp(conteudo, conteudo_ref) == 0) {
+            comparacao.iguais++;
+        } else {
+            comparacao.diferentes++;
+            if (mostradas++ < MAX_DIFERENCAS_MOSTRADAS) {
+                fprintf(stderr, "- %s\n+ %s\n", ref.linhas[j], saidas.linhas[i]);
+            }
+        }
+    }
+    for (size_t j = 0; j < ref.n; j++) {
+        if (!usada[j]) {
+            comparacao.faltando++;
+            if (mostradas++ < MAX_DIFERENCAS_MOSTRADAS) {
+                fprintf(stderr, "- %s\n", ref.linhas[j]);
+            }
+        }
+        free(ref.linhas[j]);
+    }
+    free(ref.linhas);
+    free(usada);
+    return true;
+}
+
+static int comparar_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void imprimir_etapas(FILE *f) {
+    fprintf(f, "  \"etapas_ns\": {\n");
+    int impressas = 0;
+    for (int i = 0; i < num_etapas; i++) {
+        etapa_t *e = &etapas[i];
+        if (e->n == 0) {
+            continue;
+        }
+        qsort(e->duracoes_ns, e->n, sizeof(uint64_t), comparar_u64);
+        uint64_t soma = 0;
+        for (size_t k = 0; k < e->n; k++) {
+            soma += e->duracoes_ns[k];
+        }
+        fprintf(f, "%s    \"%s\": {\"execucoes\": %zu, \"media\": %llu, \"p50\": %llu, \"p99\": %llu, \"max\": %llu}",
+                impressas++ ? ",\n" : "", e->nome, e->n, (unsigned long long)(soma / e->n),
+                (unsigned long long)e->duracoes_ns[e->n / 2], (unsigned long long)e->duracoes_ns[e->n * 99 / 100],
+                (unsigned long long)e->duracoes_ns[e->n - 1]);
+    }
+    fprintf(f, "\n  },\n");
+}
+
+static const char *nome_canal(const canal_t *c, char *buf, size_t tamanho) {
+    const char *tipo = c->tipo == GRAV_ECO ? "eco" : c->tipo == GRAV_ADC ? "adc" : "nivel";
+    snprintf(buf, tamanho, "%s%u", tipo, c->id);
+    return buf;
+}
+
+static void imprimir_relatorio(FILE *f, const char *caminho) {
+    uint32_t bordas = 0, tcp = 0, udp = 0;
+    for (size_t i = 0; i < num_eventos; i++) {
+        if (eventos[i].tipo == GRAV_BORDA) {
+            bordas++;
+        } else if (eventos[i].tipo == GRAV_UDP_DADOS) {
+            udp++;
+        } else {
+            tcp++;
+        }
+    }
+    fprintf(f, "{\n");
+    fprintf(f, "  \"gravacao\": {\"arquivo\": \"%s\", \"duracao_ms\": %llu, \"registros\": %lu, "
+               "\"perdidos\": %lu, \"terminada\": %s},\n",
+            caminho, (unsigned long long)((gravacao.fim - gravacao.inicio) / 1000),
+            (unsigned long)gravacao.registros, (unsigned long)gravacao.perdidos,
+            gravacao.terminada ? "true" : "false");
+    fprintf(f, "  \"eventos\": {\"bordas\": %lu, \"tcp\": %lu, \"udp\": %lu, \"entregues\": %zu, "
+               "\"ignorados\": %lu},\n",
+            (unsigned long)bordas, (unsigned long)tcp, (unsigned long)udp, evento_atual,
+            (unsigned long)eventos_ignorados);
+    fprintf(f, "  \"entradas\": {\n");
+    for (size_t i = 0; i < num_canais; i++) {
+        char nome[16];
+        const canal_t *c = &canais[i];
+        fprintf(f, "    \"%s\": {\"amostras\": %zu, \"leituras\": %lu, \"repetidas\": %lu, \"puladas\": %lu, "
+                   "\"nao_lidas\": %zu}%s\n",
+                nome_canal(c, nome, sizeof(nome)), c->n, (unsigned long)c->leituras,
+                (unsigned long)c->repetidas, (unsigned long)c->puladas, c->n - c->proxima,
+                i + 1 < num_canais ? "," : "");
+    }
+    fprintf(f, "  },\n");
+    imprimir_etapas(f);
+    fprintf(f, "  \"saidas\": {\"matriz\": %lu, \"oled\": %lu, \"http\": %lu, \"gpio\": %lu, \"linhas\": %zu}",
+            (unsigned long)contagem_matriz, (unsigned long)contagem_oled, (unsigned long)contagem_http,
+            (unsigned long)contagem_gpio, saidas.n);
+    if (opcoes.referencia) {
+        fprintf(f, ",\n  \"comparacao\": {\"referencia\": \"%s\", \"iguais\": %lu, \"diferentes\": %lu, "
+                   "\"faltando\": %lu, \"sobrando\": %lu}",
+                opcoes.referencia, (unsigned long)comparacao.iguais, (unsigned long)comparacao.diferentes,
+                (unsigned long)comparacao.faltando, (unsigned long)comparacao.sobrando);
+    }
+    fprintf(f, "\n}\n");
+}
+
+static void uso(const char *programa) {
+    fprintf(stderr,
+            "uso: %s gravacao.grv [opções]\n"
+            "  --saida ARQ          grava o registro de saídas\n"
+            "  --referencia ARQ     compara com o registro de saídas de outra execução\n"
+            "  --tolerancia-ms N    adianta o consumo das amostras em até N ms (50)\n"
+            "  --folga-ms N         continua N ms depois do último registro (1000)\n",
+            programa);
+}
+
+int main(int argc, char **argv) {
+    static const struct option longas[] = {
+        {"saida", required_argument, NULL, 's'},
+        {"referencia", required_argument, NULL, 'r'},
+        {"tolerancia-ms", required_argument, NULL, 't'},
+        {"folga-ms", required_argument, NULL, 'f'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    int opcao;
+    while ((opcao = getopt_long(argc, argv, "s:r:t:f:h", longas, NULL)) != -1) {
+        switch (opcao) {
+        case 's': opcoes.saida = optarg; break;
+        case 'r': opcoes.referencia = optarg; break;
+        case 't': opcoes.tolerancia_us = strtoull(optarg, NULL, 10) * 1000; break;
+        case 'f': opcoes.folga_us = strtoull(optarg, NULL, 10) * 1000; break;
+        default: uso(argv[0]); return 2;
+        }
+    }
+    if (optind != argc - 1) {
+        uso(argv[0]);
+        return 2;
+    }
+    const char *caminho = argv[optind];
+    if (!carregar_gravacao(caminho)) {
+        return 2;
+    }
+
+    // O firmware imprime na saída padrão; o resumo sai pelo descritor original
+    fflush(stdout);
+    FILE *resumo = fdopen(dup(STDOUT_FILENO), "w");
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    memset(flash_simulada, 0xFF, sizeof(flash_simulada));
+    etapa_http = registrar_etapa("http");
+    etapa_botoes = registrar_etapa("botoes");
+    etapa_udp = registrar_etapa("udp");
+    agora = gravacao.inicio;
+
+    if (setjmp(fim_reproducao) == 0) {
+        int codigo = firmware_main();
+        fflush(stdout);
+        fprintf(stderr, "firmware encerrou antes do fim da gravação (código %d)\n", codigo);
+        return 2;
+    }
+    fflush(stdout);
+
+    if (opcoes.saida) {
+        FILE *f = fopen(opcoes.saida, "w");
+        if (!f) {
+            perror(opcoes.saida);
+            return 2;
+        }
+        for (size_t i = 0; i < saidas.n; i++) {
+            fprintf(f, "%s\n", saidas.linhas[i]);
+        }
+        fclose(f);
+    }
+    if (opcoes.referencia && !comparar(opcoes.referencia)) {
+        return 2;
+    }
+    imprimir_relatorio(resumo, caminho);
+    fclose(resumo);
+    return comparacao.diferentes || comparacao.faltando || comparacao.sobrando ? 1 : 0;
+}
@@ -8,15 +8,18 @@
 #define LWIP_TCP 1
 #define LWIP_UDP 1
 #define MEM_ALIGNMENT 4
-#define MEM_SIZE 4096
+#define MEM_SIZE 8192
 #define MEMP_NUM_PBUF 16
 #define PBUF_POOL_SIZE 16               // Ajuste conforme necessário
-#define MEMP_NUM_UDP_PCB 4
+#define MEMP_NUM_UDP_PCB 6              // DHCP, DNS, controle UDP e replicação
 #define MEMP_NUM_TCP_PCB 4
 #define MEMP_NUM_TCP_SEG 16
+#define TCP_MSS 1460
+#define TCP_SND_BUF (4 * TCP_MSS)       // Arquivos da flash saem em poucos segmentos
 #define LWIP_IPV4 1
 #define LWIP_ICMP 1
 #define LWIP_RAW 1
+#define LWIP_IGMP 1                     // Grupo multicast da replicação entre placas
 #define LWIP_DHCP 1
 #define LWIP_AUTOIP 1
 #define LWIP_DNS 1
@@ -24,7 +27,8 @@
 #define LWIP_HTTPD_SSI              1  // Habilita SSI
 #define LWIP_HTTPD_SUPPORT_POST     1  // Habilita suporte a POST, se necessário
 #define LWIP_HTTPD_DYNAMIC_HEADERS 1
-#define HTTPD_USE_CUSTOM_FSDATA 0
+#define HTTPD_USE_CUSTOM_FSDATA 1   // Imagem gerada de web/ por tools/makefsdata.py
+#define HTTPD_FSDATA_FILE "fsdata_custom.c"
 #define LWIP_HTTPD_CGI 0           // Desative CGI para economizar memória
 #define LWIP_NETIF_HOSTNAME 1
 
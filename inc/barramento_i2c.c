@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <string.h>
+#include "barramento_i2c.h"
+#include "histograma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#define PROFUNDIDADE_FIFO 16
+#define LIMIAR_TX 8             // Reabastece com metade da FIFO ainda na fila
+#define PULSOS_LIBERAR 9        // Um byte e o ACK: o escravo solta o SDA até o fim deles
+#define MEIO_PERIODO_US 5       // SCL a 100 kHz na liberação
+
+static i2c_inst_t *porta;
+static i2c_hw_t *hw;
+static uint pino_sda, pino_scl;
+static uint32_t frequencia, frequencia_pedida;
+static bool fast_mode_plus;      // Ainda acima de 400 kHz (cai na primeira falha)
+
+// Fila de transações: o laço enfileira e a interrupção retira, ambos com as
+// interrupções desligadas
+static transacao_i2c_t *fila[BARRAMENTO_I2C_FILA];
+static uint32_t inicio, fim;
+
+// Transação no barramento e o seu progresso
+static transacao_i2c_t *atual;
+static uint16_t enviados;       // Comandos na FIFO (bytes escritos e pedidos de leitura)
+static uint16_t lidos;
+static uint32_t aborto;         // IC_TX_ABRT_SOURCE, esperando o STOP
+static uint32_t limite_us;
+
+static struct {
+    uint32_t transacoes, bytes, sem_ack, falhas, esgotadas, fila_cheia, quedas;
+} contadores;
+static histograma_t espera;     // Enfileirada -> início
+static histograma_t duracao;    // Início -> STOP
+
+static struct {
+    uint8_t endereco;
+    uint32_t transacoes, bytes, maximo_us;
+} dispositivos[BARRAMENTO_I2C_MAX_ENDERECOS];
+static int num_dispositivos;
+
+static void comecar(transacao_i2c_t *t) {
+    atual = t;
+    enviados = 0;
+    lidos = 0;
+    aborto = 0;
+    t->estado = I2C_EM_CURSO;
+    t->inicio_us = time_us_32();
+    // 9 bits por byte, mais o endereço
+    uint32_t bits = 9u * (t->tamanho + t->tamanho_leitura + 1);
+    limite_us = (uint32_t)((uint64_t)bits * 1000000u / frequencia) + BARRAMENTO_I2C_FOLGA_US;
+
+    hw->enable = 0;
+    hw->tar = t->endereco;
+    hw->enable = 1;
+    (void)hw->clr_intr;
+    // Com a FIFO vazia, a interrupção de TX vem na hora e começa a transação
+    hw->intr_mask = I2C_IC_INTR_MASK_M_TX_EMPTY_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS |
+                    I2C_IC_INTR_MASK_M_STOP_DET_BITS | (t->tamanho_leitura ? I2C_IC_INTR_MASK_M_RX_FULL_BITS : 0);
+}
+
+static void proxima(void) {
+    if (inicio != fim) {
+        comecar(fila[inicio++ & (BARRAMENTO_I2C_FILA - 1)]);
+    }
+}
+
+static void registrar(const transacao_i2c_t *t) {
+    uint32_t us = t->fim_us - t->inicio_us;
+    contadores.transacoes++;
+    contadores.bytes += t->tamanho + t->tamanho_leitura;
+    histograma_registrar(&espera, t->inicio_us - t->enfileirada_us);
+    histograma_registrar(&duracao, us);
+    int i = 0;
+    while (i < num_dispositivos && dispositivos[i].endereco != t->endereco) {
+        i++;
+    }
+    if (i == num_dispositivos) {
+        if (i == BARRAMENTO_I2C_MAX_ENDERECOS) {
+            return;
+        }
+        dispositivos[num_dispositivos++].endereco = t->endereco;
+    }
+    dispositivos[i].transacoes++;
+    dispositivos[i].bytes += t->tamanho + t->tamanho_leitura;
+    if (us > dispositivos[i].maximo_us) {
+        dispositivos[i].maximo_us = us;
+    }
+}
+
+// Encerra a transação atual e começa a próxima (interrupções desligadas)
+static void terminar(estado_i2c_t resultado) {
+    transacao_i2c_t *t = atual;
+    atual = NULL;
+    hw->intr_mask = 0;
+    t->fim_us = time_us_32();
+    if (resultado != I2C_CONCLUIDA && fast_mode_plus) {
+        // Fast-mode Plus não funcionou: 400 kHz daqui em diante, e repete
+        fast_mode_plus = false;
+        frequencia = i2c_set_baudrate(porta, BARRAMENTO_I2C_FAST_MODE_HZ);
+        contadores.quedas++;
+        comecar(t);
+        return;
+    }
+    registrar(t);
+    if (resultado == I2C_SEM_ACK) {
+        contadores.sem_ack++;
+    } else if (resultado == I2C_FALHA) {
+        contadores.falhas++;
+    }
+    t->estado = resultado;
+    if (t->concluida) {
+        t->concluida(t);
+    }
+    proxima();
+}
+
+// Coloca na FIFO o que couber da transação atual. Pedidos de leitura só até
+// o que a FIFO de recepção comporta.
+static void abastecer(transacao_i2c_t *t) {
+    uint32_t total = t->tamanho + t->tamanho_leitura;
+    while (enviados < total && hw->txflr < PROFUNDIDADE_FIFO) {
+        uint32_t comando;
+        if (enviados < t->tamanho) {
+            comando = t->escrita[enviados];
+        } else {
+            if (enviados - t->tamanho - lidos >= PROFUNDIDADE_FIFO) {
+                // Volta a abastecer quando a recepção esvaziar
+                hw->intr_mask &= ~I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+                return;
+            }
+            comando = I2C_IC_DATA_CMD_CMD_BITS;
+            if (enviados == t->tamanho && t->tamanho) {
+                comando |= I2C_IC_DATA_CMD_RESTART_BITS;
+            }
+        }
+        if (enviados + 1 == total) {
+            comando |= I2C_IC_DATA_CMD_STOP_BITS;
+        }
+        hw->data_cmd = comando;
+        enviados++;
+    }
+    if (enviados == total) {
+        hw->intr_mask &= ~I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+    }
+}
+
+static void esvaziar_recepcao(transacao_i2c_t *t) {
+    while (hw->rxflr && lidos < t->tamanho_leitura) {
+        t->leitura[lidos++] = (uint8_t)hw->data_cmd;
+    }
+}
+
+static void barramento_irq(void) {
+    transacao_i2c_t *t = atual;
+    uint32_t estado = hw->intr_stat;
+    if (!t) {
+        hw->intr_mask = 0;
+        return;
+    }
+    if (estado & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        // O controlador descarta a FIFO e gera o STOP; a transação termina nele
+        aborto = hw->tx_abrt_source;
+        (void)hw->clr_tx_abrt;
+        hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS;
+    }
+    if (estado & I2C_IC_INTR_STAT_R_RX_FULL_BITS) {
+        esvaziar_recepcao(t);
+        if (!aborto && enviados < t->tamanho + t->tamanho_leitura) {
+            hw->intr_mask |= I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+        }
+    }
+    if (!aborto && (estado & I2C_IC_INTR_STAT_R_TX_EMPTY_BITS)) {
+        abastecer(t);
+    }
+    if (estado & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        (void)hw->clr_stop_det;
+        esvaziar_recepcao(t);
+        if (!aborto) {
+            terminar(I2C_CONCLUIDA);
+        } else if (aborto & (I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS |
+                             I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_BITS)) {
+            terminar(I2C_SEM_ACK);
+        } else {
+            terminar(I2C_FALHA);
+        }
+    }
+}
+
+// Configura o bloco I2C e os pinos. Acima de BARRAMENTO_I2C_FAST_MODE_HZ o
+// barramento cai para ele na primeira falha.
+bool barramento_i2c_iniciar(i2c_inst_t *i2c, uint sda, uint scl, uint32_t frequencia_hz) {
+    porta = i2c;
+    hw = i2c_get_hw(i2c);
+    pino_sda = sda;
+    pino_scl = scl;
+    frequencia_pedida = frequencia_hz;
+    inicio = fim = 0;
+    atual = NULL;
+    memset(&contadores, 0, sizeof(contadores));
+    memset(dispositivos, 0, sizeof(dispositivos));
+    num_dispositivos = 0;
+    histograma_limpar(&espera);
+    histograma_limpar(&duracao);
+
+    frequencia = i2c_init(i2c, frequencia_hz);
+    fast_mode_plus = frequencia_hz > BARRAMENTO_I2C_FAST_MODE_HZ;
+    hw->tx_tl = LIMIAR_TX;
+    hw->rx_tl = 0;
+    hw->intr_mask = 0;
+    gpio_set_function(sda, GPIO_FUNC_I2C);
+    gpio_set_function(scl, GPIO_FUNC_I2C);
+    gpio_pull_up(sda);
+    gpio_pull_up(scl);
+
+    uint irq = I2C0_IRQ + i2c_hw_index(i2c);
+    irq_set_exclusive_handler(irq, barramento_irq);
+    irq_set_enabled(irq, true);
+    return frequencia != 0;
+}
+
+// Coloca a transação na fila; false se a fila estiver cheia
+bool barramento_i2c_enfileirar(transacao_i2c_t *t) {
+    if (t->tamanho + t->tamanho_leitura == 0) {
+        return false;
+    }
+    uint32_t estado_irq = save_and_disable_interrupts();
+    if (fim - inicio >= BARRAMENTO_I2C_FILA) {
+        contadores.fila_cheia++;
+        restore_interrupts(estado_irq);
+        return false;
+    }
+    t->estado = I2C_NA_FILA;
+    t->enfileirada_us = time_us_32();
+    fila[fim++ & (BARRAMENTO_I2C_FILA - 1)] = t;
+    if (!atual) {
+        proxima();
+    }
+    restore_interrupts(estado_irq);
+    return true;
+}
+
+bool barramento_i2c_ocupada(const transacao_i2c_t *t) {
+    return t->estado == I2C_NA_FILA || t->estado == I2C_EM_CURSO;
+}
+
+// Espera a conclusão da transação (configuração no boot, buffer a reutilizar).
+// Devolve true se ela terminou sem erro.
+bool barramento_i2c_esperar(transacao_i2c_t *t) {
+    while (barramento_i2c_ocupada(t)) {
+        barramento_i2c_vigiar();
+        tight_loop_contents();
+    }
+    return t->estado == I2C_CONCLUIDA;
+}
+
+// Dreno aberto pelo SIO: em baixo o pino é saída em 0, em alto fica solto
+// no pull-up
+static void linha(uint pino, bool alto) {
+    gpio_set_dir(pino, alto ? GPIO_IN : GPIO_OUT);
+    busy_wait_us_32(MEIO_PERIODO_US);
+}
+
+// Um escravo interrompido no meio de um byte segura o SDA em 0 e nenhum reset
+// do bloco o solta. Com os pinos no SIO, pulsa o SCL até o SDA subir e fecha
+// com um STOP (SDA sobe com SCL alto). Leva no máximo ~110 us.
+static void liberar_linhas(void) {
+    gpio_init(pino_sda);        // SIO, entrada, nível de saída 0
+    gpio_init(pino_scl);
+    for (int i = 0; i < PULSOS_LIBERAR && !gpio_get(pino_sda); i++) {
+        linha(pino_scl, false);
+        linha(pino_scl, true);
+    }
+    linha(pino_scl, false);
+    linha(pino_sda, false);
+    linha(pino_scl, true);
+    linha(pino_sda, true);
+}
+
+// Libera as linhas e reinicia o bloco se a transação atual passou do tempo
+// (escravo segurando SDA ou SCL, STOP que não veio). Chamado por uma tarefa e
+// pelas esperas.
+void barramento_i2c_vigiar(void) {
+    uint32_t estado_irq = save_and_disable_interrupts();
+    if (atual && time_us_32() - atual->inicio_us > limite_us) {
+        liberar_linhas();
+        frequencia = i2c_init(porta, frequencia);
+        hw->tx_tl = LIMIAR_TX;
+        hw->rx_tl = 0;
+        hw->intr_mask = 0;
+        gpio_set_function(pino_sda, GPIO_FUNC_I2C);
+        gpio_set_function(pino_scl, GPIO_FUNC_I2C);
+        contadores.esgotadas++;
+        terminar(I2C_TEMPO_ESGOTADO);
+    }
+    restore_interrupts(estado_irq);
+}
+
+uint32_t barramento_i2c_frequencia(void) {
+    return frequencia;
+}
+
+int barramento_i2c_relatorio(char *buf, size_t tamanho) {
+    int n = snprintf(buf, tamanho,
+                     "frequencia=%luHz pedida=%luHz quedas=%lu\n"
+                     "transacoes=%lu bytes=%lu sem_ack=%lu falhas=%lu esgotadas=%lu fila_cheia=%lu\n",
+                     (unsigned long)frequencia, (unsigned long)frequencia_pedida, (unsigned long)contadores.quedas,
+                     (unsigned long)contadores.transacoes, (unsigned long)contadores.bytes,
+                     (unsigned long)contadores.sem_ack, (unsigned long)contadores.falhas,
+                     (unsigned long)contadores.esgotadas, (unsigned long)contadores.fila_cheia);
+    for (int i = 0; i < num_dispositivos && n >= 0 && (size_t)n < tamanho; i++) {
+        n += snprintf(buf + n, tamanho - n, "0x%02x transacoes=%lu bytes=%lu maximo=%luus\n",
+                      dispositivos[i].endereco, (unsigned long)dispositivos[i].transacoes,
+                      (unsigned long)dispositivos[i].bytes, (unsigned long)dispositivos[i].maximo_us);
+    }
+    if (n < 0 || (size_t)n >= tamanho) {
+        return n;
+    }
+    n += histograma_formatar(&espera, "espera", buf + n, tamanho - n);
+    if (n < 0 || (size_t)n >= tamanho) {
+        return n;
+    }
+    n += histograma_formatar(&duracao, "i2c", buf + n, tamanho - n);
+    return n;
+}
@@ -0,0 +1,62 @@
+#ifndef BARRAMENTO_I2C_H
+#define BARRAMENTO_I2C_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+// Barramento I2C compartilhado (display e futuros sensores). As transações
+// entram numa fila e são executadas em segundo plano pela interrupção do
+// bloco I2C, que reabastece a FIFO de 16 comandos; o laço só enfileira e,
+// quando precisa do resultado, consulta o estado da transação.
+//
+// A transação e os buffers que ela aponta pertencem ao barramento do
+// enfileiramento até a conclusão: não altere nem reenfileire antes disso.
+// Uma transação escreve `tamanho` bytes e, se tamanho_leitura > 0, lê em
+// seguida com START repetido (leitura de registrador de um sensor).
+//
+// Acima de 400 kHz (Fast-mode Plus, até 1 MHz) a primeira transação sem ACK,
+// abortada ou presa derruba o barramento para 400 kHz e é repetida uma vez.
+// Erros de bit por subida lenta não são detectados: 1 MHz pede pull-ups
+// externos de ~2,2 kΩ.
+#define BARRAMENTO_I2C_FILA 8                  // Transações enfileiradas (potência de 2)
+#define BARRAMENTO_I2C_FAST_MODE_HZ 400000
+#define BARRAMENTO_I2C_FAST_MODE_PLUS_HZ 1000000
+#define BARRAMENTO_I2C_FOLGA_US 2000           // Além do tempo teórico, antes de reiniciar o bloco
+#define BARRAMENTO_I2C_MAX_ENDERECOS 4         // Dispositivos com estatística própria
+
+typedef enum {
+    I2C_LIVRE,              // Nunca enfileirada
+    I2C_NA_FILA,
+    I2C_EM_CURSO,
+    I2C_CONCLUIDA,
+    I2C_SEM_ACK,            // Endereço ou dado sem ACK
+    I2C_FALHA,              // Arbitragem perdida ou outro aborto
+    I2C_TEMPO_ESGOTADO,     // Barramento preso; linhas liberadas e bloco reiniciado
+} estado_i2c_t;
+
+typedef struct transacao_i2c {
+    uint8_t endereco;
+    const uint8_t *escrita;
+    uint16_t tamanho;
+    uint8_t *leitura;
+    uint16_t tamanho_leitura;
+    // Chamada na conclusão, com sucesso ou não, do contexto de interrupção
+    // (ou do laço, quando o vigia reinicia o bloco); pode ser NULL
+    void (*concluida)(struct transacao_i2c *t);
+    void *contexto;
+    volatile estado_i2c_t estado;
+    uint32_t enfileirada_us, inicio_us, fim_us;    // Tempos da última execução
+} transacao_i2c_t;
+
+bool barramento_i2c_iniciar(i2c_inst_t *i2c, uint sda, uint scl, uint32_t frequencia_hz);
+bool barramento_i2c_enfileirar(transacao_i2c_t *t);
+bool barramento_i2c_ocupada(const transacao_i2c_t *t);
+bool barramento_i2c_esperar(transacao_i2c_t *t);
+void barramento_i2c_vigiar(void);
+uint32_t barramento_i2c_frequencia(void);
+int barramento_i2c_relatorio(char *buf, size_t tamanho);
+
+#endif
@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <string.h>
+#include "cenas.h"
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+// Último setor da flash, longe do programa e da imagem fsdata
+#define OFFSET_FLASH (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define MAGICA 0x414E4543u         // "CENA"
+#define VERSAO_REGISTRO 1
+
+typedef struct {
+    uint32_t magica;
+    uint32_t versao;
+    cena_t cenas[CENAS_MAX];
+    uint32_t soma;                 // FNV-1a dos campos anteriores
+} registro_cenas_t;
+
+_Static_assert(sizeof(registro_cenas_t) <= FLASH_PAGE_SIZE, "registro de cenas maior que uma página");
+
+// Tabela gravada de fábrica, usada enquanto a flash não tem um registro válido
+static const cena_t cenas_padrao[] = {
+    {"noite",   0x7F, 0x50},       // Só o quintal aceso, TV desligada, alarme ligado
+    {"fora",    0x7F, 0x40},       // Tudo desligado, alarme ligado
+    {"chegada", 0x51, 0x11},       // Sala e quintal acesos, alarme desligado
+    {"cinema",  0x21, 0x20},       // Sala apagada, TV ligada
+};
+
+static cena_t cenas[CENAS_MAX];
+static const char *const *nomes;   // Nome de cada bit da palavra de estados
+static bool lida_da_flash;
+static uint32_t gravacoes;
+
+// Edição recebida pela rede, aplicada pelo laço principal
+static cena_t edicao;
+static bool edicao_remover;
+static volatile bool edicao_pendente;
+
+static uint32_t fnv1a(const void *dados, size_t tamanho) {
+    const uint8_t *p = dados;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < tamanho; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+static bool nome_valido(const char *nome, size_t tamanho) {
+    if (tamanho == 0 || tamanho >= CENAS_TAMANHO_NOME) {
+        return false;
+    }
+    for (size_t i = 0; i < tamanho; i++) {
+        char c = nome[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' || c == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Valor do parâmetro nome na consulta "a=1&b=2" (NULL se ausente)
+static const char *parametro(const char *consulta, size_t tamanho, const char *nome, size_t *tam_valor) {
+    size_t tam_nome = strlen(nome);
+    size_t i = 0;
+    while (i < tamanho) {
+        size_t fim = i;
+        while (fim < tamanho && consulta[fim] != '&') {
+            fim++;
+        }
+        if (fim - i >= tam_nome && memcmp(consulta + i, nome, tam_nome) == 0 &&
+            (fim - i == tam_nome || consulta[i + tam_nome] == '=')) {
+            size_t inicio = i + tam_nome + (fim - i > tam_nome);
+            *tam_valor = fim - inicio;
+            return consulta + inicio;
+        }
+        i = fim + 1;
+    }
+    return NULL;
+}
+
+// Converte "sala,tv" em bits da palavra de estados (-1 se algum nome não existe)
+static int ler_dispositivos(const char *lista, size_t tamanho) {
+    int mascara = 0;
+    size_t i = 0;
+    while (i < tamanho) {
+        size_t fim = i;
+        while (fim < tamanho && lista[fim] != ',') {
+            fim++;
+        }
+        int bit = -1;
+        for (int b = 0; b < CENAS_BITS; b++) {
+            if (strlen(nomes[b]) == fim - i && memcmp(nomes[b], lista + i, fim - i) == 0) {
+                bit = b;
+                break;
+            }
+        }
+        if (bit < 0) {
+            return -1;
+        }
+        mascara |= 1 << bit;
+        i = fim + 1;
+    }
+    return mascara;
+}
+
+static int formatar_dispositivos(char *buf, size_t tamanho, uint8_t bits) {
+    int n = 0;
+    for (int b = 0; b < CENAS_BITS && (size_t)n < tamanho; b++) {
+        if (bits & (1u << b)) {
+            n += snprintf(buf + n, tamanho - n, "%s%s", n ? "," : "", nomes[b]);
+        }
+    }
+    return n;
+}
+
+static const registro_cenas_t *registro_flash(void) {
+    return (const registro_cenas_t *)(XIP_BASE + OFFSET_FLASH);
+}
+
+// Carrega a tabela da flash ou, sem registro válido, a tabela de fábrica
+void cenas_iniciar(const char *const nomes_estados[CENAS_BITS]) {
+    nomes = nomes_estados;
+    edicao_pendente = false;
+    gravacoes = 0;
+
+    const registro_cenas_t *r = registro_flash();
+    lida_da_flash = r->magica == MAGICA && r->versao == VERSAO_REGISTRO &&
+                    r->soma == fnv1a(r, offsetof(registro_cenas_t, soma));
+    if (lida_da_flash) {
+        memcpy(cenas, r->cenas, sizeof(cenas));
+    } else {
+        memset(cenas, 0, sizeof(cenas));
+        memcpy(cenas, cenas_padrao, sizeof(cenas_padrao));
+    }
+}
+
+// Índice da cena com o nome dado, ou -1
+int cenas_buscar(const char *nome, size_t tamanho) {
+    if (!nome_valido(nome, tamanho)) {
+        return -1;
+    }
+    for (int i = 0; i < CENAS_MAX; i++) {
+        if (strlen(cenas[i].nome) == tamanho && memcmp(cenas[i].nome, nome, tamanho) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Próxima cena definida depois de indice (em ciclo), ou -1 se não há nenhuma
+int cenas_proxima(int indice) {
+    for (int passo = 1; passo <= CENAS_MAX; passo++) {
+        int i = (indice + passo + CENAS_MAX) % CENAS_MAX;
+        if (cenas[i].nome[0] != '\0') {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Palavra de estados resultante da cena; uma única transição, sem passos
+// intermediários visíveis
+uint32_t cenas_aplicar(int indice, uint32_t estado) {
+    if (indice < 0 || indice >= CENAS_MAX || cenas[indice].nome[0] == '\0') {
+        return estado;
+    }
+    const cena_t *c = &cenas[indice];
+    return (estado & ~(uint32_t)c->mascara) | (c->valores & c->mascara);
+}
+
+// Interpreta "nome=noite&ligar=quintal,alarme&desligar=sala" (define ou
+// substitui a cena) ou "nome=noite&remover". Contexto lwIP.
+cena_edicao_t cenas_editar(const char *consulta, size_t tamanho) {
+    if (edicao_pendente) {
+        return CENA_EDICAO_OCUPADA;
+    }
+    size_t tam_nome, tam_ligar = 0, tam_desligar = 0, tam_remover;
+    const char *nome = parametro(consulta, tamanho, "nome", &tam_nome);
+    if (!nome || !nome_valido(nome, tam_nome)) {
+        return CENA_EDICAO_INVALIDA;
+    }
+    int existente = cenas_buscar(nome, tam_nome);
+
+    memset(&edicao, 0, sizeof(edicao));
+    memcpy(edicao.nome, nome, tam_nome);
+    edicao_remover = parametro(consulta, tamanho, "remover", &tam_remover) != NULL;
+    if (edicao_remover) {
+        if (existente < 0) {
+            return CENA_EDICAO_INVALIDA;
+        }
+    } else {
+        const char *ligar = parametro(consulta, tamanho, "ligar", &tam_ligar);
+        const char *desligar = parametro(consulta, tamanho, "desligar", &tam_desligar);
+        int bits_ligar = ligar ? ler_dispositivos(ligar, tam_ligar) : 0;
+        int bits_desligar = desligar ? ler_dispositivos(desligar, tam_desligar) : 0;
+        if (bits_ligar < 0 || bits_desligar < 0 || (bits_ligar & bits_desligar) ||
+            (bits_ligar | bits_desligar) == 0) {
+            return CENA_EDICAO_INVALIDA;
+        }
+        if (existente < 0) {
+            // Cena nova precisa de uma posição livre
+            bool ha_livre = false;
+            for (int i = 0; i < CENAS_MAX; i++) {
+                ha_livre |= cenas[i].nome[0] == '\0';
+            }
+            if (!ha_livre) {
+                return CENA_EDICAO_INVALIDA;
+            }
+        }
+        edicao.mascara = bits_ligar | bits_desligar;
+        edicao.valores = bits_ligar;
+    }
+    edicao_pendente = true;
+    return CENA_EDICAO_ACEITA;
+}
+
+// Aplica a edição pendente à tabela (laço principal, entre
+// cyw43_arch_lwip_begin/end). Retorna true se a tabela mudou.
+bool cenas_aplicar_edicao(void) {
+    if (!edicao_pendente) {
+        return false;
+    }
+    edicao_pendente = false;
+    int indice = cenas_buscar(edicao.nome, strlen(edicao.nome));
+    if (edicao_remover) {
+        if (indice >= 0) {
+            memset(&cenas[indice], 0, sizeof(cena_t));
+        }
+        return indice >= 0;
+    }
+    for (int i = 0; indice < 0 && i < CENAS_MAX; i++) {
+        if (cenas[i].nome[0] == '\0') {
+            indice = i;
+        }
+    }
+    if (indice < 0) {
+        return false;
+    }
+    cenas[indice] = edicao;
+    return true;
+}
+
+// Grava a tabela na flash (laço principal, fora do bloqueio do lwIP). Com as
+// interrupções desligadas durante o apagamento do setor (~50 ms), o CYW43
+// fica sem atendimento nesse intervalo; por isso só se grava ao editar.
+void cenas_gravar(void) {
+    static registro_cenas_t registro;
+    registro.magica = MAGICA;
+    registro.versao = VERSAO_REGISTRO;
+    memcpy(registro.cenas, cenas, sizeof(cenas));
+    registro.soma = fnv1a(&registro, offsetof(registro_cenas_t, soma));
+    if (memcmp(registro_flash(), &registro, sizeof(registro)) == 0) {
+        return;
+    }
+
+    static uint8_t pagina[FLASH_PAGE_SIZE];
+    memset(pagina, 0xFF, sizeof(pagina));
+    memcpy(pagina, &registro, sizeof(registro));
+    uint32_t interrupcoes = save_and_disable_interrupts();
+    flash_range_erase(OFFSET_FLASH, FLASH_SECTOR_SIZE);
+    flash_range_program(OFFSET_FLASH, pagina, FLASH_PAGE_SIZE);
+    restore_interrupts(interrupcoes);
+    lida_da_flash = true;
+    gravacoes++;
+}
+
+// Lista as cenas em texto: "nome ligar=... desligar=..."
+int cenas_relatorio(char *buf, size_t tamanho) {
+    int n = snprintf(buf, tamanho, "origem=%s gravacoes=%lu\n", lida_da_flash ? "flash" : "padrao",
+                     (unsigned long)gravacoes);
+    for (int i = 0; i < CENAS_MAX && n >= 0 && (size_t)n < tamanho; i++) {
+        const cena_t *c = &cenas[i];
+        if (c->nome[0] == '\0') {
+            continue;
+        }
+        n += snprintf(buf + n, tamanho - n, "%s ligar=", c->nome);
+        if ((size_t)n >= tamanho) {
+            break;
+        }
+        n += formatar_dispositivos(buf + n, tamanho - n, c->valores & c->mascara);
+        if ((size_t)n >= tamanho) {
+            break;
+        }
+        n += snprintf(buf + n, tamanho - n, " desligar=");
+        if ((size_t)n >= tamanho) {
+            break;
+        }
+        n += formatar_dispositivos(buf + n, tamanho - n, ~c->valores & c->mascara);
+        if ((size_t)n >= tamanho) {
+            break;
+        }
+        n += snprintf(buf + n, tamanho - n, "\n");
+    }
+    return n;
+}
+
+// Um botão por cena para a página (tag SSI, dentro de <form action="./cena">).
+// Contexto lwIP.
+int cenas_botoes(char *destino, int tamanho) {
+    int n = 0;
+    for (int i = 0; i < CENAS_MAX; i++) {
+        if (cenas[i].nome[0] == '\0') {
+            continue;
+        }
+        int m = snprintf(destino + n, tamanho - n, "<button name=\"nome\" value=\"%s\">%s</button>",
+                         cenas[i].nome, cenas[i].nome);
+        if (m < 0 || m >= tamanho - n) {
+            break;
+        }
+        n += m;
+    }
+    return n;
+}
@@ -0,0 +1,42 @@
+#ifndef CENAS_H
+#define CENAS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Cenas: estado alvo de um conjunto de dispositivos, aplicado de uma vez
+// sobre a palavra de estados (estado_palavra). Cada cena fixa os bits de
+// mascara com os valores de valores; os demais ficam como estão.
+//
+// A tabela fica na RAM e é gravada no último setor da flash a cada edição.
+// Edições chegam pelo contexto lwIP (cenas_editar) e são aplicadas e
+// gravadas pelo laço principal (cenas_aplicar_edicao e cenas_gravar).
+#define CENAS_MAX 8
+#define CENAS_TAMANHO_NOME 12      // Inclui o '\0'; só [a-z0-9_-]
+#define CENAS_BITS 7               // Bits da palavra que uma cena pode fixar (o de alarme acionado não)
+
+typedef struct {
+    char nome[CENAS_TAMANHO_NOME]; // Vazio = posição livre
+    uint8_t mascara;               // Bits controlados pela cena
+    uint8_t valores;               // Valor de cada bit controlado
+} cena_t;
+
+// Resultado de uma edição recebida pela rede
+typedef enum {
+    CENA_EDICAO_ACEITA,
+    CENA_EDICAO_INVALIDA,      // Nome, dispositivo ou parâmetro inválido, ou tabela cheia
+    CENA_EDICAO_OCUPADA,       // Edição anterior ainda não aplicada
+} cena_edicao_t;
+
+void cenas_iniciar(const char *const nomes_estados[CENAS_BITS]);
+int cenas_buscar(const char *nome, size_t tamanho);
+int cenas_proxima(int indice);
+uint32_t cenas_aplicar(int indice, uint32_t estado);
+cena_edicao_t cenas_editar(const char *consulta, size_t tamanho);
+bool cenas_aplicar_edicao(void);
+void cenas_gravar(void);
+int cenas_relatorio(char *buf, size_t tamanho);
+int cenas_botoes(char *destino, int tamanho);
+
+#endif
@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <string.h>
+#include "controle_udp.h"
+#include "energia.h"
+#include "histograma.h"
+#include "gravacao.h"
+#include "pico/stdlib.h"
+#include "pico/rand.h"
+#include "pico/cyw43_arch.h"
+#include "hardware/sync.h"
+#include "lwip/udp.h"
+#include "lwip/pbuf.h"
+
+#define TAMANHO_MAC 8
+#define TAMANHO_CABECALHO 13
+#define TAMANHO_RESPOSTA 28
+#define BIT_ACIONADO (1u << 7)
+
+static struct udp_pcb *pcb;
+static uint8_t chave[SIPHASH_TAMANHO_CHAVE];
+static uint32_t (*ler_estado)(void);
+static uint32_t sessao;
+
+// Janela anti-repetição: maior sequência aceita e as 63 anteriores já vistas
+static uint32_t maior_seq;
+static uint64_t janela;
+
+// Lotes do contexto lwIP para o laço principal (mesmo esquema da fila de comandos)
+static lote_udp_t fila[CONTROLE_UDP_FILA];
+static volatile uint32_t inicio, fim;
+
+static struct {
+    uint32_t aceitos, consultas, repetidos, sessao_invalida, mac_invalido, malformados, fila_cheia;
+} contadores;
+static histograma_t latencia;          // Recebimento -> confirmação enviada
+
+static uint32_t ler32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void escrever32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+// Compara o MAC recebido sem sair no primeiro byte diferente
+static bool mac_confere(const uint8_t *dados, size_t tamanho) {
+    uint64_t mac = siphash24(chave, dados, tamanho - TAMANHO_MAC);
+    uint8_t diferenca = 0;
+    for (int i = 0; i < TAMANHO_MAC; i++) {
+        diferenca |= dados[tamanho - TAMANHO_MAC + i] ^ (uint8_t)(mac >> (8 * i));
+    }
+    return diferenca == 0;
+}
+
+// Sequência inédita dentro da janela? (não marca como vista)
+static bool seq_inedita(uint32_t seq) {
+    if (seq > maior_seq) {
+        return true;
+    }
+    uint32_t distancia = maior_seq - seq;
+    return distancia < 64 && !(janela & (1ull << distancia));
+}
+
+static void marcar_seq(uint32_t seq) {
+    if (seq > maior_seq) {
+        uint32_t avanco = seq - maior_seq;
+        janela = avanco >= 64 ? 0 : janela << avanco;
+        janela |= 1;
+        maior_seq = seq;
+    } else {
+        janela |= 1ull << (maior_seq - seq);
+    }
+}
+
+static void responder(const ip_addr_t *destino, u16_t porta, uint8_t tipo, uint32_t seq,
+                      uint8_t status, uint8_t operacoes, uint32_t estado) {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, TAMANHO_RESPOSTA, PBUF_RAM);
+    if (!p) {
+        return;
+    }
+    uint8_t *r = (uint8_t *)p->payload;
+    r[0] = 'L';
+    r[1] = 'C';
+    r[2] = CONTROLE_UDP_VERSAO;
+    r[3] = tipo | 0x80;
+    escrever32(r + 4, sessao);
+    escrever32(r + 8, seq);
+    r[12] = status;
+    r[13] = operacoes;
+    r[14] = 0;
+    r[15] = 0;
+    escrever32(r + 16, estado);
+    uint64_t mac = siphash24(chave, r, TAMANHO_RESPOSTA - TAMANHO_MAC);
+    for (int i = 0; i < TAMANHO_MAC; i++) {
+        r[TAMANHO_RESPOSTA - TAMANHO_MAC + i] = (uint8_t)(mac >> (8 * i));
+    }
+    udp_sendto(pcb, p, destino, porta);
+    pbuf_free(p);
+}
+
+// Callback de recebimento (contexto lwIP). Datagramas inválidos ou sem MAC
+// correto são descartados em silêncio; comandos válidos vão para a fila.
+static void controle_udp_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    uint32_t agora = time_us_32();
+    gravacao_udp_dados(CONTROLE_UDP_PORTA, p);
+    uint8_t dados[TAMANHO_CABECALHO + 2 * CONTROLE_UDP_MAX_OPERACOES + TAMANHO_MAC];
+    u16_t tamanho = p->tot_len;
+    if (tamanho > sizeof(dados) || tamanho < TAMANHO_CABECALHO + TAMANHO_MAC) {
+        contadores.malformados++;
+        pbuf_free(p);
+        return;
+    }
+    pbuf_copy_partial(p, dados, tamanho, 0);
+    pbuf_free(p);
+
+    uint8_t quantidade = dados[12];
+    if (dados[0] != 'L' || dados[1] != 'C' || dados[2] != CONTROLE_UDP_VERSAO ||
+        quantidade > CONTROLE_UDP_MAX_OPERACOES || tamanho != TAMANHO_CABECALHO + 2 * quantidade + TAMANHO_MAC) {
+        contadores.malformados++;
+        return;
+    }
+    if (!mac_confere(dados, tamanho)) {
+        contadores.mac_invalido++;
+        return;
+    }
+
+    uint8_t tipo = dados[3];
+    uint32_t seq = ler32(dados + 8);
+    if (tipo == CONTROLE_UDP_CONSULTA) {
+        contadores.consultas++;
+        responder(addr, port, tipo, maior_seq, CONTROLE_UDP_OK, 0, ler_estado());
+        return;
+    }
+    if (tipo != CONTROLE_UDP_COMANDOS) {
+        contadores.malformados++;
+        return;
+    }
+    if (ler32(dados + 4) != sessao) {
+        contadores.sessao_invalida++;
+        responder(addr, port, tipo, seq, CONTROLE_UDP_SESSAO_INVALIDA, 0, ler_estado());
+        return;
+    }
+    if (!seq_inedita(seq)) {
+        contadores.repetidos++;
+        responder(addr, port, tipo, seq, CONTROLE_UDP_REPETIDO, 0, ler_estado());
+        return;
+    }
+    uint32_t posicao = fim;
+    if (posicao - inicio >= CONTROLE_UDP_FILA) {
+        // A sequência não é marcada: o cliente pode reenviar o mesmo lote
+        contadores.fila_cheia++;
+        responder(addr, port, tipo, seq, CONTROLE_UDP_FILA_CHEIA, 0, ler_estado());
+        return;
+    }
+    marcar_seq(seq);
+
+    lote_udp_t *lote = &fila[posicao & (CONTROLE_UDP_FILA - 1)];
+    ip_addr_copy(lote->origem, *addr);
+    lote->porta = port;
+    lote->seq = seq;
+    lote->quantidade = quantidade;
+    memcpy(lote->operacoes, dados + TAMANHO_CABECALHO, 2 * quantidade);
+    lote->instante_us = agora;
+    __dmb();
+    fim = posicao + 1;
+    contadores.aceitos++;
+
+    // Acorda o laço principal para aplicar o lote
+    energia_sinalizar_evento();
+}
+
+// Cria a PCB e associa à porta (entre cyw43_arch_lwip_begin/end)
+static bool abrir_porta(void) {
+    pcb = udp_new();
+    if (!pcb) {
+        printf("Falha ao criar PCB UDP\n");
+        return false;
+    }
+    if (udp_bind(pcb, IP_ADDR_ANY, CONTROLE_UDP_PORTA) != ERR_OK) {
+        printf("Falha ao associar controle UDP à porta %u\n", CONTROLE_UDP_PORTA);
+        return false;
+    }
+    udp_recv(pcb, controle_udp_recv, NULL);
+    return true;
+}
+
+// Abre a porta de controle. estado() devolve a palavra de estados atual.
+// O servidor HTTP já está no ar: a pilha lwIP é usada sob o bloqueio.
+bool controle_udp_iniciar(const uint8_t chave_controle[SIPHASH_TAMANHO_CHAVE], uint32_t (*estado)(void)) {
+    memcpy(chave, chave_controle, SIPHASH_TAMANHO_CHAVE);
+    ler_estado = estado;
+    sessao = get_rand_32();
+    maior_seq = 0;
+    janela = 0;
+    inicio = fim = 0;
+    memset(&contadores, 0, sizeof(contadores));
+    histograma_limpar(&latencia);
+
+    cyw43_arch_lwip_begin();
+    bool aberta = abrir_porta();
+    cyw43_arch_lwip_end();
+    return aberta;
+}
+
+// Retira o lote mais antigo (laço principal, entre cyw43_arch_lwip_begin/end)
+bool controle_udp_retirar(lote_udp_t *lote) {
+    uint32_t posicao = inicio;
+    if (posicao == fim) {
+        return false;
+    }
+    __dmb();
+    *lote = fila[posicao & (CONTROLE_UDP_FILA - 1)];
+    __dmb();
+    inicio = posicao + 1;
+    return true;
+}
+
+// Aplica as operações do lote, em ordem, sobre a palavra de estados
+uint32_t controle_udp_aplicar(const lote_udp_t *lote, uint32_t estado) {
+    for (uint8_t i = 0; i < lote->quantidade; i++) {
+        uint32_t mascara = lote->operacoes[i][1] & ~BIT_ACIONADO;
+        switch (lote->operacoes[i][0]) {
+        case CONTROLE_UDP_LIGAR:
+            estado |= mascara;
+            break;
+        case CONTROLE_UDP_DESLIGAR:
+            estado &= ~mascara;
+            break;
+        case CONTROLE_UDP_ALTERNAR:
+            estado ^= mascara;
+            break;
+        }
+    }
+    return estado;
+}
+
+// Confirma o lote com o estado resultante (entre cyw43_arch_lwip_begin/end)
+void controle_udp_confirmar(const lote_udp_t *lote, uint32_t estado) {
+    responder(&lote->origem, lote->porta, CONTROLE_UDP_COMANDOS, lote->seq, CONTROLE_UDP_OK, lote->quantidade, estado);
+    histograma_registrar(&latencia, time_us_32() - lote->instante_us);
+}
+
+// Registra a sessão atual numa gravação que acabou de começar: a reprodução
+// precisa dela para aceitar os lotes gravados
+void controle_udp_gravar_sessao(void) {
+    gravacao_udp_sessao(sessao);
+}
+
+int controle_udp_relatorio(char *buf, size_t tamanho) {
+    int n = snprintf(buf, tamanho,
+                     "porta=%u sessao=%08lx maior_seq=%lu\n"
+                     "aceitos=%lu consultas=%lu repetidos=%lu sessao_invalida=%lu mac_invalido=%lu "
+                     "malformados=%lu fila_cheia=%lu\n",
+                     CONTROLE_UDP_PORTA, (unsigned long)sessao, (unsigned long)maior_seq,
+                     (unsigned long)contadores.aceitos, (unsigned long)contadores.consultas,
+                     (unsigned long)contadores.repetidos, (unsigned long)contadores.sessao_invalida,
+                     (unsigned long)contadores.mac_invalido, (unsigned long)contadores.malformados,
+                     (unsigned long)contadores.fila_cheia);
+    if (n < 0 || (size_t)n >= tamanho) {
+        return n;
+    }
+    n += histograma_formatar(&latencia, "udp", buf + n, tamanho - n);
+    return n;
+}
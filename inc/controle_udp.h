@@ -0,0 +1,68 @@
+#ifndef CONTROLE_UDP_H
+#define CONTROLE_UDP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lwip/ip_addr.h"
+#include "siphash.h"
+
+// Protocolo binário de controle sobre UDP (little-endian). Todo datagrama
+// termina com o SipHash-2-4 (8 bytes) de tudo o que vem antes.
+//
+// Requisição:
+//   0  u8[2] "LC"       4  u32 sessao     12 u8 quantidade
+//   2  u8    versao (1) 8  u32 seq        13 quantidade x {u8 operacao, u8 mascara}
+//   3  u8    tipo (CONTROLE_UDP_CONSULTA ou CONTROLE_UDP_COMANDOS)
+//
+// Resposta (28 bytes):
+//   0  u8[2] "LC"       4  u32 sessao     12 u8 status      16 u32 estado
+//   2  u8    versao     8  u32 seq        13 u8 operacoes   20 u8[8] MAC
+//   3  u8    tipo | 0x80                  14 u16 reservado
+//
+// A sessão é sorteada a cada boot e informada pela consulta, junto com a
+// maior sequência aceita (no campo seq); comandos só valem na sessão atual e
+// com sequência inédita (janela de 64), o que barra datagramas repetidos.
+// A máscara usa os bits de estado_palavra(); o bit 7 (alarme acionado) é
+// somente leitura.
+#define CONTROLE_UDP_PORTA 4210
+#define CONTROLE_UDP_VERSAO 1
+#define CONTROLE_UDP_MAX_OPERACOES 16
+#define CONTROLE_UDP_FILA 8            // Potência de 2
+
+enum {
+    CONTROLE_UDP_CONSULTA = 0,
+    CONTROLE_UDP_COMANDOS = 1,
+};
+
+enum {
+    CONTROLE_UDP_LIGAR = 1,
+    CONTROLE_UDP_DESLIGAR = 2,
+    CONTROLE_UDP_ALTERNAR = 3,
+};
+
+enum {
+    CONTROLE_UDP_OK = 0,
+    CONTROLE_UDP_SESSAO_INVALIDA = 1,
+    CONTROLE_UDP_REPETIDO = 2,         // Sequência já vista (reenvio ou repetição)
+    CONTROLE_UDP_FILA_CHEIA = 3,
+};
+
+// Lote de operações recebido num datagrama, aplicado de uma vez pelo laço principal
+typedef struct {
+    ip_addr_t origem;
+    uint16_t porta;
+    uint32_t seq;
+    uint8_t quantidade;
+    uint8_t operacoes[CONTROLE_UDP_MAX_OPERACOES][2];
+    uint32_t instante_us;              // Recebimento (time_us_32)
+} lote_udp_t;
+
+bool controle_udp_iniciar(const uint8_t chave[SIPHASH_TAMANHO_CHAVE], uint32_t (*estado)(void));
+bool controle_udp_retirar(lote_udp_t *lote);
+uint32_t controle_udp_aplicar(const lote_udp_t *lote, uint32_t estado);
+void controle_udp_confirmar(const lote_udp_t *lote, uint32_t estado);
+int controle_udp_relatorio(char *buf, size_t tamanho);
+void controle_udp_gravar_sessao(void);
+
+#endif
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include "energia.h"
+#include "histograma.h"
+#include "hardware/sync.h"
+#include "pico/cyw43_arch.h"
+
+#define JANELA_HORA_US (3600ull * 1000000ull)
+
+// Evento pendente sinalizado por uma IRQ (botão, rede) e o instante em que ocorreu
+static volatile bool evento_pendente = false;
+static volatile uint32_t instante_evento = 0;
+
+// Tempos acumulados desde o boot
+static uint64_t tempo_ativo_us = 0;
+static uint64_t tempo_ocioso_us = 0;
+static uint64_t marca_us = 0;
+
+// Janela da hora corrente e resultado da última hora completa
+static uint64_t janela_inicio_us = 0;
+static uint64_t janela_ativo_inicial = 0;
+static uint64_t janela_ocioso_inicial = 0;
+static uint32_t ultima_hora_ciclo_permil = 0;
+static uint32_t ultima_hora_consumo_uah = 0;
+static bool ultima_hora_valida = false;
+
+static histograma_t latencia_despertar;
+static uint32_t violacoes_latencia = 0;
+
+// Corrente média estimada (uA) para um intervalo com os tempos dados
+static uint32_t corrente_media_ua(uint64_t ativo, uint64_t ocioso) {
+    uint64_t total = ativo + ocioso;
+    if (total == 0) {
+        return 0;
+    }
+    return (uint32_t)((ativo * ENERGIA_CORRENTE_ATIVA_UA + ocioso * ENERGIA_CORRENTE_OCIOSA_UA) / total);
+}
+
+static uint32_t ciclo_permil(uint64_t ativo, uint64_t ocioso) {
+    uint64_t total = ativo + ocioso;
+    return total ? (uint32_t)(ativo * 1000 / total) : 0;
+}
+
+// Fecha a janela de uma hora quando ela se completa
+static void atualizar_janela(uint64_t agora) {
+    if (agora - janela_inicio_us < JANELA_HORA_US) {
+        return;
+    }
+    uint64_t ativo = tempo_ativo_us - janela_ativo_inicial;
+    uint64_t ocioso = tempo_ocioso_us - janela_ocioso_inicial;
+    ultima_hora_ciclo_permil = ciclo_permil(ativo, ocioso);
+    // Corrente média durante uma hora equivale ao consumo em uAh
+    ultima_hora_consumo_uah = corrente_media_ua(ativo, ocioso);
+    ultima_hora_valida = true;
+
+    janela_inicio_us = agora;
+    janela_ativo_inicial = tempo_ativo_us;
+    janela_ocioso_inicial = tempo_ocioso_us;
+}
+
+// Marca o início da contabilização de tempo ativo/ocioso
+void energia_init(void) {
+    histograma_limpar(&latencia_despertar);
+    marca_us = time_us_64();
+    janela_inicio_us = marca_us;
+}
+
+// Seleciona o modo de economia de energia do chip WiFi (CYW43_*_PM)
+void energia_configurar_wifi(uint32_t modo_pm) {
+    cyw43_wifi_pm(&cyw43_state, modo_pm);
+}
+
+// Chamado pelas IRQs que alteram estado: acorda o laço principal do WFE
+void energia_sinalizar_evento(void) {
+    if (!evento_pendente) {
+        instante_evento = time_us_32();
+        evento_pendente = true;
+    }
+    __sev();
+}
+
+// Dorme o núcleo até o prazo ou até um evento sinalizado. Retorna true se
+// acordou por evento. O clk_sys fica inteiro: o SPI do CYW43 (PIO), a matriz
+// WS2812, o PWM da sirene e o I2C derivam dele e seguem ativos durante o sono.
+bool energia_dormir_ate(absolute_time_t prazo) {
+    uint64_t inicio = time_us_64();
+    tempo_ativo_us += inicio - marca_us;
+
+    // best_effort_wfe_or_timeout pode retornar antes do prazo sem evento
+    // nosso (outras IRQs, como a do CYW43); nesse caso volta a dormir
+    bool expirou = false;
+    while (!evento_pendente && !expirou) {
+        expirou = best_effort_wfe_or_timeout(prazo);
+    }
+
+    uint64_t fim = time_us_64();
+    tempo_ocioso_us += fim - inicio;
+    marca_us = fim;
+
+    uint32_t estado_irq = save_and_disable_interrupts();
+    bool por_evento = evento_pendente;
+    uint32_t instante = instante_evento;
+    evento_pendente = false;
+    restore_interrupts(estado_irq);
+
+    // Latência: do evento (ou do prazo) até o núcleo voltar a executar
+    uint32_t latencia;
+    if (por_evento) {
+        latencia = (uint32_t)fim - instante;
+    } else {
+        uint64_t alvo = to_us_since_boot(prazo);
+        latencia = fim > alvo ? (uint32_t)(fim - alvo) : 0;
+    }
+    histograma_registrar(&latencia_despertar, latencia);
+    if (latencia > ENERGIA_LIMITE_LATENCIA_US) {
+        violacoes_latencia++;
+    }
+
+    atualizar_janela(fim);
+    return por_evento;
+}
+
+// Escreve o relatório de ciclo de trabalho e corrente estimada no buffer
+int energia_relatorio(char *buf, size_t tamanho) {
+    uint64_t agora = time_us_64();
+    uint64_t ativo = tempo_ativo_us + (agora - marca_us);
+    uint32_t ciclo = ciclo_permil(ativo, tempo_ocioso_us);
+
+    int n = snprintf(buf, tamanho,
+                     "ciclo_ativo=%lu.%lu%% corrente_media=%luuA (estimada)\n",
+                     (unsigned long)(ciclo / 10), (unsigned long)(ciclo % 10),
+                     (unsigned long)corrente_media_ua(ativo, tempo_ocioso_us));
+    if (n < 0 || (size_t)n >= tamanho) {
+        return n;
+    }
+    if (ultima_hora_valida) {
+        n += snprintf(buf + n, tamanho - n,
+                      "ultima_hora: ciclo_ativo=%lu.%lu%% consumo=%luuAh\n",
+                      (unsigned long)(ultima_hora_ciclo_permil / 10),
+                      (unsigned long)(ultima_hora_ciclo_permil % 10),
+                      (unsigned long)ultima_hora_consumo_uah);
+    } else {
+        n += snprintf(buf + n, tamanho - n, "ultima_hora: em andamento\n");
+    }
+    if ((size_t)n >= tamanho) {
+        return n;
+    }
+    n += histograma_formatar(&latencia_despertar, "latencia_despertar", buf + n, tamanho - n);
+    if ((size_t)n >= tamanho) {
+        return n;
+    }
+    n += snprintf(buf + n, tamanho - n, "violacoes_latencia(>%dus)=%lu\n",
+                  ENERGIA_LIMITE_LATENCIA_US, (unsigned long)violacoes_latencia);
+    return n;
+}
@@ -0,0 +1,23 @@
+#ifndef ENERGIA_H
+#define ENERGIA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pico/stdlib.h"
+
+// Correntes estimadas da placa (RP2040 + CYW43) para o contador de ciclo de
+// trabalho. Calibrar com um multímetro na placa real.
+#define ENERGIA_CORRENTE_ATIVA_UA 45000
+#define ENERGIA_CORRENTE_OCIOSA_UA 12000
+
+// Latência de despertar acima deste limite é contada como violação
+#define ENERGIA_LIMITE_LATENCIA_US 2000
+
+void energia_init(void);
+void energia_configurar_wifi(uint32_t modo_pm);
+void energia_sinalizar_evento(void);
+bool energia_dormir_ate(absolute_time_t prazo);
+int energia_relatorio(char *buf, size_t tamanho);
+
+#endif
@@ -0,0 +1,128 @@
+#include <string.h>
+#include "espelho_display.h"
+
+// Quadros em ordem de página (p * 128 + x), o mais recente em quadros[atual]
+static uint8_t quadros[ESPELHO_HISTORICO][ESPELHO_TAMANHO];
+static uint32_t versoes[ESPELHO_HISTORICO];
+static uint32_t atual;
+
+// Começa com o display apagado na versão 1 (versão 0 = cliente sem quadro)
+void espelho_init(void) {
+    memset(quadros, 0, sizeof(quadros));
+    memset(versoes, 0, sizeof(versoes));
+    atual = 0;
+    versoes[0] = 1;
+}
+
+// Guarda o buffer do SSD1306 (endereçamento vertical: x * 8 + página, sem o
+// byte de controle). Retorna false se o quadro não mudou.
+bool espelho_publicar(const uint8_t *ram) {
+    uint8_t quadro[ESPELHO_TAMANHO];
+    for (uint32_t x = 0; x < ESPELHO_LARGURA; x++) {
+        for (uint32_t p = 0; p < ESPELHO_PAGINAS; p++) {
+            quadro[p * ESPELHO_LARGURA + x] = ram[x * ESPELHO_PAGINAS + p];
+        }
+    }
+    if (memcmp(quadro, quadros[atual], ESPELHO_TAMANHO) == 0) {
+        return false;
+    }
+    uint32_t versao = versoes[atual] + 1;
+    atual = (atual + 1) % ESPELHO_HISTORICO;
+    memcpy(quadros[atual], quadro, ESPELHO_TAMANHO);
+    versoes[atual] = versao;
+    return true;
+}
+
+// Tamanho da sequência de bytes iguais a partir de i (até 64)
+static uint32_t sequencia(const uint8_t *d, uint32_t i) {
+    uint32_t n = 1;
+    while (i + n < ESPELHO_LARGURA && d[i + n] == d[i] && n < 64) {
+        n++;
+    }
+    return n;
+}
+
+// Vale interromper um trecho literal: zeros repetidos ou 3+ bytes iguais
+static bool inicia_sequencia(const uint8_t *d, uint32_t i) {
+    uint32_t n = sequencia(d, i);
+    return (d[i] == 0 && n >= 2) || n >= 3;
+}
+
+// Codifica uma página (128 bytes) em RLE; no pior caso 128 + 64 bytes
+static uint32_t codificar_pagina(const uint8_t *d, uint8_t *saida) {
+    uint32_t n = 0;
+    uint32_t i = 0;
+    while (i < ESPELHO_LARGURA) {
+        uint32_t k = sequencia(d, i);
+        if (d[i] == 0 && k >= 2) {
+            saida[n++] = 0x80 | (k - 1);
+            i += k;
+        } else if (k >= 3) {
+            saida[n++] = 0xC0 | (k - 1);
+            saida[n++] = d[i];
+            i += k;
+        } else {
+            uint32_t inicio = i;
+            k = 0;
+            do {
+                i++;
+                k++;
+            } while (i < ESPELHO_LARGURA && k < 128 && !inicia_sequencia(d, i));
+            saida[n++] = k - 1;
+            memcpy(saida + n, d + inicio, k);
+            n += k;
+        }
+    }
+    return n;
+}
+
+// Gera a mensagem que leva o cliente de *versao ao quadro atual e atualiza
+// *versao. Sem a versão do cliente no histórico, envia um quadro-chave.
+// Retorna 0 se o cliente já está atualizado, -1 se o buffer for pequeno.
+int espelho_codificar(uint32_t *versao, char *buf, size_t tamanho) {
+    if (*versao == versoes[atual]) {
+        return 0;
+    }
+    if (tamanho < ESPELHO_MAX_MENSAGEM) {
+        return -1;
+    }
+
+    const uint8_t *base = NULL;
+    for (uint32_t i = 0; i < ESPELHO_HISTORICO; i++) {
+        if (*versao != 0 && versoes[i] == *versao) {
+            base = quadros[i];
+        }
+    }
+
+    uint8_t *saida = (uint8_t *)buf;
+    uint32_t n = ESPELHO_CABECALHO;
+    uint8_t mascara = 0;
+    for (uint32_t p = 0; p < ESPELHO_PAGINAS; p++) {
+        const uint8_t *pagina = quadros[atual] + p * ESPELHO_LARGURA;
+        uint8_t diferenca[ESPELHO_LARGURA];
+        if (base) {
+            const uint8_t *anterior = base + p * ESPELHO_LARGURA;
+            if (memcmp(pagina, anterior, ESPELHO_LARGURA) == 0) {
+                continue;
+            }
+            for (uint32_t x = 0; x < ESPELHO_LARGURA; x++) {
+                diferenca[x] = pagina[x] ^ anterior[x];
+            }
+            pagina = diferenca;
+        }
+        mascara |= 1u << p;
+        n += codificar_pagina(pagina, saida + n);
+    }
+
+    uint32_t v = versoes[atual];
+    saida[0] = base ? 1 : 0;
+    saida[1] = v & 0xFF;
+    saida[2] = (v >> 8) & 0xFF;
+    saida[3] = (v >> 16) & 0xFF;
+    saida[4] = (v >> 24) & 0xFF;
+    saida[5] = mascara;
+    saida[6] = n & 0xFF;
+    saida[7] = (n >> 8) & 0xFF;
+    *versao = v;
+    return n;
+}
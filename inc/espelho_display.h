@@ -0,0 +1,32 @@
+#ifndef ESPELHO_DISPLAY_H
+#define ESPELHO_DISPLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Cópia remota do OLED. O laço principal publica cada quadro enviado ao
+// SSD1306; o servidor HTTP codifica a diferença entre a versão que o cliente
+// já tem e a atual.
+//
+// Mensagem (little-endian):
+//   u8  tipo      0 = quadro-chave (base zerada), 1 = delta
+//   u32 versao    versão do quadro resultante
+//   u8  mascara   bit p = página p presente
+//   u16 tamanho   bytes da mensagem, cabeçalho incluso
+//   para cada página presente, 128 bytes (XOR com a base) em RLE:
+//     0x00-0x7F  n+1 bytes literais a seguir
+//     0x80-0xBF  (n&0x3F)+1 zeros
+//     0xC0-0xFF  (n&0x3F)+1 repetições do byte a seguir
+#define ESPELHO_LARGURA 128
+#define ESPELHO_PAGINAS 8
+#define ESPELHO_TAMANHO (ESPELHO_LARGURA * ESPELHO_PAGINAS)
+#define ESPELHO_HISTORICO 4        // Quadros guardados para gerar deltas
+#define ESPELHO_CABECALHO 8
+#define ESPELHO_MAX_MENSAGEM (ESPELHO_CABECALHO + ESPELHO_PAGINAS * (ESPELHO_LARGURA + ESPELHO_LARGURA / 2))
+
+void espelho_init(void);
+bool espelho_publicar(const uint8_t *ram);
+int espelho_codificar(uint32_t *versao, char *buf, size_t tamanho);
+
+#endif
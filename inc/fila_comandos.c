@@ -0,0 +1,34 @@
+#include "fila_comandos.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+// Enfileira um comando; retorna false se a fila estiver cheia
+bool fila_inserir(fila_comandos_t *fila, uint8_t tipo, uint8_t argumento) {
+    uint32_t fim = fila->fim;
+    if (fim - fila->inicio >= FILA_COMANDOS_TAMANHO) {
+        fila->descartados++;
+        return false;
+    }
+    comando_t *c = &fila->itens[fim & (FILA_COMANDOS_TAMANHO - 1)];
+    c->tipo = tipo;
+    c->argumento = argumento;
+    c->instante_us = time_us_32();
+
+    // O item precisa estar escrito antes de o consumidor ver o novo fim
+    __dmb();
+    fila->fim = fim + 1;
+    return true;
+}
+
+// Retira o comando mais antigo; retorna false se a fila estiver vazia
+bool fila_retirar(fila_comandos_t *fila, comando_t *comando) {
+    uint32_t inicio = fila->inicio;
+    if (inicio == fila->fim) {
+        return false;
+    }
+    __dmb();
+    *comando = fila->itens[inicio & (FILA_COMANDOS_TAMANHO - 1)];
+    __dmb();
+    fila->inicio = inicio + 1;
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef FILA_COMANDOS_H
+#define FILA_COMANDOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Fila circular de um produtor (contexto lwIP) e um consumidor (laço principal).
+// O consumidor retira entre cyw43_arch_lwip_begin/end, o produtor já executa
+// dentro do contexto lwIP, então nenhum outro bloqueio é necessário.
+#define FILA_COMANDOS_TAMANHO 16   // Potência de 2
+
+typedef struct {
+    uint8_t tipo;          // Comando, definido pela aplicação
+    uint8_t argumento;     // Parâmetro opcional do comando
+    uint32_t instante_us;  // Momento em que foi enfileirado (time_us_32)
+} comando_t;
+
+typedef struct {
+    comando_t itens[FILA_COMANDOS_TAMANHO];
+    volatile uint32_t inicio;  // Próximo item a retirar (consumidor)
+    volatile uint32_t fim;     // Próxima posição livre (produtor)
+    uint32_t descartados;      // Comandos recusados por fila cheia
+} fila_comandos_t;
+
+bool fila_inserir(fila_comandos_t *fila, uint8_t tipo, uint8_t argumento);
+bool fila_retirar(fila_comandos_t *fila, comando_t *comando);
+
+#endif
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <string.h>
+#include "gravacao.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#define MASCARA_ANEL (GRAVACAO_TAMANHO_ANEL - 1)
+#define MAX_VARINT 5
+
+// Anel de bytes. escrita e leitura são contadores que só crescem (a posição
+// no anel é o valor mascarado) e só mudam com as interrupções desligadas.
+static uint8_t anel[GRAVACAO_TAMANHO_ANEL];
+static uint32_t escrita;
+static uint32_t leitura;
+static uint32_t base;              // Valor de escrita no início da gravação atual
+static volatile bool ativa;
+static uint32_t ultimo_us;         // Instante do último registro escrito
+static uint32_t perdidos;          // Bytes descartados ainda não informados no fluxo
+
+static struct {
+    uint32_t registros, bytes, perdidos, linhas;
+} contadores;
+
+static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static size_t varint(uint8_t *destino, uint32_t valor) {
+    size_t n = 0;
+    while (valor >= 0x80) {
+        destino[n++] = (uint8_t)(valor | 0x80);
+        valor >>= 7;
+    }
+    destino[n++] = (uint8_t)valor;
+    return n;
+}
+
+static uint32_t livre(void) {
+    return GRAVACAO_TAMANHO_ANEL - (escrita - leitura);
+}
+
+static void por(const void *dados, size_t tamanho) {
+    const uint8_t *d = (const uint8_t *)dados;
+    for (size_t i = 0; i < tamanho; i++) {
+        anel[(escrita + i) & MASCARA_ANEL] = d[i];
+    }
+    escrita += tamanho;
+}
+
+// Escreve um registro: tipo, dt, campos e os primeiros tam_dados bytes da
+// cadeia de pbufs. Com o anel cheio o registro é descartado e contado; o
+// próximo que couber vem precedido de um GRAV_PERDA. Interrupções desligadas.
+static void registrar(uint8_t tipo, const uint8_t *campos, size_t tam_campos,
+                      const struct pbuf *p, uint16_t tam_dados) {
+    uint32_t agora = time_us_32();
+    uint8_t cabecalho[1 + 2 * MAX_VARINT];
+
+    if (perdidos) {
+        cabecalho[0] = GRAV_PERDA;
+        size_t n = 1 + varint(cabecalho + 1, agora - ultimo_us);
+        n += varint(cabecalho + n, perdidos);
+        if (n > livre()) {
+            perdidos += 1 + MAX_VARINT + tam_campos + tam_dados;
+            contadores.perdidos += 1 + MAX_VARINT + tam_campos + tam_dados;
+            return;
+        }
+        por(cabecalho, n);
+        ultimo_us = agora;
+        perdidos = 0;
+    }
+
+    cabecalho[0] = tipo;
+    size_t n = 1 + varint(cabecalho + 1, agora - ultimo_us);
+    size_t total = n + tam_campos + tam_dados;
+    if (total > livre()) {
+        perdidos += total;
+        contadores.perdidos += total;
+        return;
+    }
+    por(cabecalho, n);
+    por(campos, tam_campos);
+    for (const struct pbuf *q = p; q && tam_dados > 0; q = q->next) {
+        uint16_t trecho = q->len < tam_dados ? q->len : tam_dados;
+        por(q->payload, trecho);
+        tam_dados -= trecho;
+    }
+    ultimo_us = agora;
+    contadores.registros++;
+    contadores.bytes += total;
+}
+
+static void gravar(uint8_t tipo, const uint8_t *campos, size_t tam_campos,
+                   const struct pbuf *p, uint16_t tam_dados) {
+    if (!ativa) {
+        return;
+    }
+    uint32_t estado_irq = save_and_disable_interrupts();
+    if (ativa) {
+        registrar(tipo, campos, tam_campos, p, tam_dados);
+    }
+    restore_interrupts(estado_irq);
+}
+
+// Começa uma gravação nova; o que restava da anterior e não foi enviado é
+// descartado. estado é a palavra de estados dos dispositivos neste instante.
+void gravacao_iniciar(uint32_t estado) {
+    uint8_t campos[1 + MAX_VARINT + 4];
+    uint32_t estado_irq = save_and_disable_interrupts();
+    leitura = escrita;
+    base = escrita;
+    perdidos = 0;
+    memset(&contadores, 0, sizeof(contadores));
+    ultimo_us = time_us_32();
+    size_t n = 0;
+    campos[n++] = GRAVACAO_VERSAO;
+    n += varint(campos + n, estado);
+    for (int i = 0; i < 4; i++) {
+        campos[n++] = (uint8_t)(ultimo_us >> (8 * i));
+    }
+    registrar(GRAV_CABECALHO, campos, n, NULL, 0);
+    ativa = true;
+    restore_interrupts(estado_irq);
+}
+
+// Encerra a gravação; o restante do anel continua sendo enviado
+void gravacao_parar(void) {
+    uint32_t estado_irq = save_and_disable_interrupts();
+    if (ativa) {
+        registrar(GRAV_FIM, NULL, 0, NULL, 0);
+        ativa = false;
+    }
+    restore_interrupts(estado_irq);
+}
+
+bool gravacao_ativa(void) {
+    return ativa;
+}
+
+void gravacao_eco(uint8_t pino, uint32_t pulso_us) {
+    uint8_t campos[1 + MAX_VARINT];
+    campos[0] = pino;
+    gravar(GRAV_ECO, campos, 1 + varint(campos + 1, pulso_us), NULL, 0);
+}
+
+void gravacao_adc(uint8_t canal, uint16_t valor) {
+    uint8_t campos[1 + MAX_VARINT];
+    campos[0] = canal;
+    gravar(GRAV_ADC, campos, 1 + varint(campos + 1, valor), NULL, 0);
+}
+
+void gravacao_nivel(uint8_t pino, bool nivel) {
+    uint8_t campos[] = {pino, nivel};
+    gravar(GRAV_NIVEL, campos, sizeof(campos), NULL, 0);
+}
+
+void gravacao_borda(uint8_t pino, uint32_t eventos, bool nivel) {
+    uint8_t campos[] = {pino, (uint8_t)eventos, nivel};
+    gravar(GRAV_BORDA, campos, sizeof(campos), NULL, 0);
+}
+
+void gravacao_tcp_abrir(uint16_t conexao) {
+    uint8_t campos[MAX_VARINT];
+    gravar(GRAV_TCP_ABRIR, campos, varint(campos, conexao), NULL, 0);
+}
+
+// Dados recebidos numa conexão, até GRAVACAO_MAX_DADOS_TCP bytes (contexto lwIP)
+void gravacao_tcp_dados(uint16_t conexao, const struct pbuf *p) {
+    uint16_t tamanho = p->tot_len < GRAVACAO_MAX_DADOS_TCP ? p->tot_len : GRAVACAO_MAX_DADOS_TCP;
+    uint8_t campos[2 * MAX_VARINT];
+    size_t n = varint(campos, conexao);
+    n += varint(campos + n, tamanho);
+    gravar(GRAV_TCP_DADOS, campos, n, p, tamanho);
+}
+
+void gravacao_tcp_fechar(uint16_t conexao) {
+    uint8_t campos[MAX_VARINT];
+    gravar(GRAV_TCP_FECHAR, campos, varint(campos, conexao), NULL, 0);
+}
+
+// Datagrama recebido numa porta, até GRAVACAO_MAX_DADOS_UDP bytes (contexto lwIP)
+void gravacao_udp_dados(uint16_t porta, const struct pbuf *p) {
+    uint16_t tamanho = p->tot_len < GRAVACAO_MAX_DADOS_UDP ? p->tot_len : GRAVACAO_MAX_DADOS_UDP;
+    uint8_t campos[2 * MAX_VARINT];
+    size_t n = varint(campos, porta);
+    n += varint(campos + n, tamanho);
+    gravar(GRAV_UDP_DADOS, campos, n, p, tamanho);
+}
+
+void gravacao_udp_sessao(uint32_t sessao) {
+    uint8_t campos[4];
+    for (int i = 0; i < 4; i++) {
+        campos[i] = (uint8_t)(sessao >> (8 * i));
+    }
+    gravar(GRAV_UDP_SESSAO, campos, sizeof(campos), NULL, 0);
+}
+
+// Envia pelo stdio até GRAVACAO_LINHAS_POR_CHAMADA linhas do anel, parando
+// antes se passar de GRAVACAO_TEMPO_MAXIMO_US (laço principal). Cada trecho é
+// copiado com as interrupções desligadas e o espaço volta ao anel antes do
+// printf, que pode esperar pelo USB.
+void gravacao_descarregar(void) {
+    uint32_t inicio = time_us_32();
+    for (int linha = 0; linha < GRAVACAO_LINHAS_POR_CHAMADA &&
+                        time_us_32() - inicio < GRAVACAO_TEMPO_MAXIMO_US; linha++) {
+        uint8_t bloco[GRAVACAO_BYTES_LINHA];
+        uint32_t estado_irq = save_and_disable_interrupts();
+        uint32_t posicao = leitura - base;
+        uint32_t n = escrita - leitura;
+        if (n > sizeof(bloco)) {
+            n = sizeof(bloco);
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            bloco[i] = anel[(leitura + i) & MASCARA_ANEL];
+        }
+        leitura += n;
+        restore_interrupts(estado_irq);
+        if (n == 0) {
+            return;
+        }
+
+        char texto[(GRAVACAO_BYTES_LINHA + 2) / 3 * 4 + 1];
+        size_t t = 0;
+        for (uint32_t i = 0; i < n; i += 3) {
+            uint32_t v = (uint32_t)bloco[i] << 16;
+            if (i + 1 < n) {
+                v |= (uint32_t)bloco[i + 1] << 8;
+            }
+            if (i + 2 < n) {
+                v |= bloco[i + 2];
+            }
+            texto[t++] = BASE64[(v >> 18) & 0x3F];
+            texto[t++] = BASE64[(v >> 12) & 0x3F];
+            texto[t++] = i + 1 < n ? BASE64[(v >> 6) & 0x3F] : '=';
+            texto[t++] = i + 2 < n ? BASE64[v & 0x3F] : '=';
+        }
+        texto[t] = '\0';
+        printf("@GRV %lu %s\n", (unsigned long)posicao, texto);
+        contadores.linhas++;
+    }
+}
+
+int gravacao_relatorio(char *buf, size_t tamanho) {
+    uint32_t estado_irq = save_and_disable_interrupts();
+    uint32_t pendentes = escrita - leitura;
+    restore_interrupts(estado_irq);
+    return snprintf(buf, tamanho, "ativa=%d registros=%lu bytes=%lu perdidos=%lu pendentes=%lu linhas=%lu\n",
+                    ativa, (unsigned long)contadores.registros, (unsigned long)contadores.bytes,
+                    (unsigned long)contadores.perdidos, (unsigned long)pendentes,
+                    (unsigned long)contadores.linhas);
+}
@@ -0,0 +1,79 @@
+#ifndef GRAVACAO_H
+#define GRAVACAO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lwip/pbuf.h"
+
+// Gravação das entradas externas do firmware para reprodução no host
+// (bench/reproduzir.c): pulsos de eco dos ultrassônicos, leituras do ADC
+// (joystick e temperatura), nível do LDR, bordas dos botões, os dados TCP
+// recebidos pelo servidor HTTP e os datagramas do controle UDP e da
+// replicação entre placas.
+//
+// Os registros vão para um anel na RAM, escrito com as interrupções
+// desligadas (os botões e o lwIP gravam do contexto de IRQ), e o laço
+// principal o esvazia pelo stdio USB em linhas de texto:
+//   @GRV <posicao> <base64>
+// onde posicao é o deslocamento, no fluxo da gravação, do primeiro byte da
+// linha (tools/gravacao.py junta as linhas num arquivo binário).
+//
+// Fluxo: sequência de registros  u8 tipo  varint dt_us  carga
+// dt_us é o tempo desde o registro anterior (time_us_32); varint é LEB128
+// sem sinal. Cargas:
+//   GRAV_CABECALHO   u8 versao  varint estado  u32 inicio_us (little-endian)
+//   GRAV_ECO         u8 pino  varint pulso_us
+//   GRAV_ADC         u8 canal  varint valor
+//   GRAV_NIVEL       u8 pino  u8 nivel
+//   GRAV_BORDA       u8 pino  u8 eventos  u8 nivel
+//   GRAV_TCP_ABRIR   varint conexao
+//   GRAV_TCP_DADOS   varint conexao  varint tamanho  u8 dados[tamanho]
+//   GRAV_TCP_FECHAR  varint conexao
+//   GRAV_UDP_DADOS   varint porta  varint tamanho  u8 dados[tamanho]
+//   GRAV_UDP_SESSAO  u32 sessao (little-endian): sessão do controle UDP,
+//                    logo depois do cabeçalho (o número é sorteado no boot)
+//   GRAV_PERDA       varint bytes     (registros descartados com o anel cheio)
+//   GRAV_FIM         (nada)
+#define GRAVACAO_VERSAO 1
+#define GRAVACAO_TAMANHO_ANEL 8192         // Potência de 2
+#define GRAVACAO_BYTES_LINHA 48            // Bytes por linha (64 caracteres em base64)
+#define GRAVACAO_LINHAS_POR_CHAMADA 16     // Limites de cada gravacao_descarregar
+#define GRAVACAO_TEMPO_MAXIMO_US 20000
+#define GRAVACAO_MAX_DADOS_TCP 1023        // Mesmo limite da requisição no servidor
+#define GRAVACAO_MAX_DADOS_UDP 512
+
+// 1: grava desde o boot (a reprodução parte do mesmo estado inicial do firmware)
+#define GRAVACAO_NA_PARTIDA 0
+
+enum {
+    GRAV_CABECALHO = 0x01,
+    GRAV_ECO = 0x10,
+    GRAV_ADC = 0x11,
+    GRAV_NIVEL = 0x12,
+    GRAV_BORDA = 0x13,
+    GRAV_TCP_ABRIR = 0x20,
+    GRAV_TCP_DADOS = 0x21,
+    GRAV_TCP_FECHAR = 0x22,
+    GRAV_UDP_DADOS = 0x23,
+    GRAV_UDP_SESSAO = 0x24,
+    GRAV_PERDA = 0x30,
+    GRAV_FIM = 0x3F,
+};
+
+void gravacao_iniciar(uint32_t estado);
+void gravacao_parar(void);
+bool gravacao_ativa(void);
+void gravacao_eco(uint8_t pino, uint32_t pulso_us);
+void gravacao_adc(uint8_t canal, uint16_t valor);
+void gravacao_nivel(uint8_t pino, bool nivel);
+void gravacao_borda(uint8_t pino, uint32_t eventos, bool nivel);
+void gravacao_tcp_abrir(uint16_t conexao);
+void gravacao_tcp_dados(uint16_t conexao, const struct pbuf *p);
+void gravacao_tcp_fechar(uint16_t conexao);
+void gravacao_udp_dados(uint16_t porta, const struct pbuf *p);
+void gravacao_udp_sessao(uint32_t sessao);
+void gravacao_descarregar(void);
+int gravacao_relatorio(char *buf, size_t tamanho);
+
+#endif
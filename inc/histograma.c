@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <string.h>
+#include "histograma.h"
+
+// Converte um valor em índice de faixa: os 2 bits abaixo do bit mais
+// significativo escolhem a subfaixa dentro da potência de 2
+static uint32_t faixa_do_valor(uint32_t v) {
+    if (v < HISTOGRAMA_SUBFAIXAS) {
+        return v;
+    }
+    uint32_t msb = 31 - __builtin_clz(v);
+    uint32_t sub = (v >> (msb - 2)) & (HISTOGRAMA_SUBFAIXAS - 1);
+    uint32_t idx = (msb - 1) * HISTOGRAMA_SUBFAIXAS + sub;
+    return idx < HISTOGRAMA_FAIXAS ? idx : HISTOGRAMA_FAIXAS - 1;
+}
+
+// Limite superior (inclusivo) dos valores contidos numa faixa
+static uint32_t limite_da_faixa(uint32_t idx) {
+    if (idx < HISTOGRAMA_SUBFAIXAS) {
+        return idx;
+    }
+    uint32_t msb = idx / HISTOGRAMA_SUBFAIXAS + 1;
+    uint32_t sub = idx % HISTOGRAMA_SUBFAIXAS;
+    return ((HISTOGRAMA_SUBFAIXAS + sub + 1) << (msb - 2)) - 1;
+}
+
+void histograma_limpar(histograma_t *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+void histograma_registrar(histograma_t *h, uint32_t valor_us) {
+    h->contagem[faixa_do_valor(valor_us)]++;
+    h->total++;
+    if (valor_us > h->maximo) {
+        h->maximo = valor_us;
+    }
+}
+
+// Retorna o limite superior da faixa que contém o percentil pedido (em milésimos)
+uint32_t histograma_percentil(const histograma_t *h, uint32_t permil) {
+    if (h->total == 0) {
+        return 0;
+    }
+    uint64_t alvo = ((uint64_t)h->total * permil + 999) / 1000;
+    uint64_t acumulado = 0;
+    for (uint32_t i = 0; i < HISTOGRAMA_FAIXAS; i++) {
+        acumulado += h->contagem[i];
+        if (acumulado >= alvo) {
+            uint32_t limite = limite_da_faixa(i);
+            return limite < h->maximo ? limite : h->maximo;
+        }
+    }
+    return h->maximo;
+}
+
+// Escreve uma linha de resumo "nome n= p50= p90= p99= max=" no buffer
+int histograma_formatar(const histograma_t *h, const char *nome, char *buf, size_t tamanho) {
+    return snprintf(buf, tamanho, "%s n=%lu p50=%luus p90=%luus p99=%luus max=%luus\n",
+                    nome,
+                    (unsigned long)h->total,
+                    (unsigned long)histograma_percentil(h, 500),
+                    (unsigned long)histograma_percentil(h, 900),
+                    (unsigned long)histograma_percentil(h, 990),
+                    (unsigned long)h->maximo);
+}
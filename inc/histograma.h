@@ -0,0 +1,23 @@
+#ifndef HISTOGRAMA_H
+#define HISTOGRAMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Histograma de latências em microssegundos, com 4 faixas por potência de 2
+// (erro relativo máximo de 25%). Valores acima de ~4 s caem na última faixa.
+#define HISTOGRAMA_SUBFAIXAS 4
+#define HISTOGRAMA_FAIXAS (21 * HISTOGRAMA_SUBFAIXAS)
+
+typedef struct {
+    uint32_t contagem[HISTOGRAMA_FAIXAS];
+    uint32_t total;
+    uint32_t maximo;
+} histograma_t;
+
+void histograma_limpar(histograma_t *h);
+void histograma_registrar(histograma_t *h, uint32_t valor_us);
+uint32_t histograma_percentil(const histograma_t *h, uint32_t permil);
+int histograma_formatar(const histograma_t *h, const char *nome, char *buf, size_t tamanho);
+
+#endif
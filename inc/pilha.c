@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include "pilha.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+// Símbolos do script de ligação do SDK. A pilha do núcleo 0 fica no topo do
+// banco SCRATCH_Y e a do núcleo 1 no do SCRATCH_X. A reserva nominal
+// (PICO_STACK_SIZE) vai de __StackBottom a __StackTop, mas a pilha pode descer
+// pelo resto do banco sem falha visível; por isso todo ele é pintado.
+extern uint32_t __StackTop[], __StackBottom[], __scratch_y_end__[];
+extern uint32_t __StackOneTop[], __StackOneBottom[], __scratch_x_end__[];
+
+typedef struct {
+    const char *nome;
+    uint32_t *base;        // Palavra mais baixa pintada
+    uint32_t *topo;
+    uint32_t reservado;    // Bytes da reserva nominal
+    uint32_t *marca;       // Marca mais baixa vista antes de uma repintura
+} regiao_pilha_t;
+
+// Ponto instrumentado em execução
+typedef struct {
+    pilha_ponto_t *ponto;
+    uint32_t *sp;
+    uint32_t *minimo;      // Marca mais baixa vista antes de um ponto aninhado repintar
+} quadro_pilha_t;
+
+static regiao_pilha_t regioes[2];
+static quadro_pilha_t quadros[PILHA_ANINHAMENTO];
+static uint32_t aninhamento;
+static uint32_t nao_medidos;           // Entradas além de PILHA_ANINHAMENTO ou fora do núcleo 0
+static uint32_t excedentes;            // Das quais ainda ativas
+static pilha_ponto_t *pontos[PILHA_MAX_PONTOS];
+static uint32_t num_pontos;
+static uint32_t avisos;                // Bit por região e por ponto já acima do limiar
+
+// Pintura e varredura são forçadas inline: uma chamada de função empilharia
+// o próprio quadro justamente na área sendo pintada
+static __force_inline uint32_t *sp_atual(void) {
+    uint32_t *sp;
+    __asm volatile("mov %0, sp" : "=r"(sp));
+    return sp;
+}
+
+static __force_inline void pintar(uint32_t *de, uint32_t *ate) {
+    for (uint32_t *p = de; p < ate; p++) {
+        *p = PILHA_SENTINELA;
+    }
+}
+
+// Palavra mais baixa já usada em [base, limite), ou limite se nenhuma
+static __force_inline uint32_t *marca_baixa(uint32_t *base, uint32_t *limite) {
+    uint32_t *p = base;
+    while (p < limite && *p == PILHA_SENTINELA) {
+        p++;
+    }
+    return p;
+}
+
+static uint32_t bytes_entre(const uint32_t *baixo, const uint32_t *alto) {
+    return (uint32_t)((uintptr_t)alto - (uintptr_t)baixo);
+}
+
+// Pinta as pilhas; chamada no início de main, antes de qualquer interrupção
+// da aplicação e antes de o núcleo 1 ser iniciado
+void pilha_pintar(void) {
+    regioes[0] = (regiao_pilha_t){"nucleo0", __scratch_y_end__, __StackTop, bytes_entre(__StackBottom, __StackTop),
+                                  __StackTop};
+    regioes[1] = (regiao_pilha_t){"nucleo1", __scratch_x_end__, __StackOneTop,
+                                  bytes_entre(__StackOneBottom, __StackOneTop), __StackOneTop};
+
+    uint32_t interrupcoes = save_and_disable_interrupts();
+    pintar(regioes[0].base, sp_atual());
+    restore_interrupts(interrupcoes);
+    // O núcleo 1 não roda neste firmware: a pilha inteira está livre
+    pintar(regioes[1].base, regioes[1].topo);
+}
+
+// Início de um trecho medido. Só o núcleo 0 é instrumentado.
+void pilha_entrar(pilha_ponto_t *ponto) {
+    uint32_t interrupcoes = save_and_disable_interrupts();
+    regiao_pilha_t *r = &regioes[0];
+    uint32_t *sp = sp_atual();
+
+    if (!ponto->registrado && num_pontos < PILHA_MAX_PONTOS) {
+        ponto->registrado = true;
+        pontos[num_pontos++] = ponto;
+    }
+    if (get_core_num() != 0 || aninhamento >= PILHA_ANINHAMENTO || sp <= r->base || sp > r->topo) {
+        nao_medidos++;
+        excedentes++;
+        restore_interrupts(interrupcoes);
+        return;
+    }
+
+    // Guarda a marca atual antes de repintar: ela pertence à região e ao
+    // ponto interrompido, se houver
+    uint32_t *baixo = marca_baixa(r->base, sp);
+    if (baixo < r->marca) {
+        r->marca = baixo;
+    }
+    if (aninhamento > 0 && baixo < quadros[aninhamento - 1].minimo) {
+        quadros[aninhamento - 1].minimo = baixo;
+    }
+    pintar(baixo, sp);
+
+    quadros[aninhamento++] = (quadro_pilha_t){ponto, sp, sp};
+    restore_interrupts(interrupcoes);
+}
+
+// Fim do trecho iniciado por pilha_entrar (sempre em ordem inversa)
+void pilha_sair(pilha_ponto_t *ponto) {
+    uint32_t interrupcoes = save_and_disable_interrupts();
+    if (excedentes > 0) {
+        excedentes--;
+    } else if (aninhamento > 0 && quadros[aninhamento - 1].ponto == ponto) {
+        quadro_pilha_t *q = &quadros[--aninhamento];
+        uint32_t *baixo = marca_baixa(regioes[0].base, q->sp);
+        if (q->minimo < baixo) {
+            baixo = q->minimo;
+        }
+        ponto->ultimo = bytes_entre(baixo, q->sp);
+        if (ponto->ultimo > ponto->maximo) {
+            ponto->maximo = ponto->ultimo;
+        }
+        ponto->chamadas++;
+    }
+    restore_interrupts(interrupcoes);
+}
+
+// Bytes já usados da região desde o boot
+static uint32_t usado(regiao_pilha_t *r) {
+    if (!r->base) {
+        return 0;
+    }
+    uint32_t *baixo = marca_baixa(r->base, r->marca);
+    return bytes_entre(baixo < r->marca ? baixo : r->marca, r->topo);
+}
+
+static bool acima_do_limiar(uint32_t bytes, uint32_t reservado) {
+    return (uint64_t)bytes * 100 > (uint64_t)reservado * PILHA_LIMIAR_AVISO_PCT;
+}
+
+// Estado de aviso de cada região e ponto, um bit por item
+static uint32_t calcular_avisos(void) {
+    uint32_t bits = 0;
+    for (int i = 0; i < 2; i++) {
+        if (acima_do_limiar(usado(&regioes[i]), regioes[i].reservado)) {
+            bits |= 1u << i;
+        }
+    }
+    for (uint32_t i = 0; i < num_pontos; i++) {
+        if (acima_do_limiar(pontos[i]->maximo, regioes[0].reservado)) {
+            bits |= 1u << (2 + i);
+        }
+    }
+    return bits;
+}
+
+// Retorna true quando alguma região ou ponto passou do limiar desde a última
+// verificação (para o laço principal imprimir o relatório)
+bool pilha_verificar(void) {
+    uint32_t bits = calcular_avisos();
+    bool novos = (bits & ~avisos) != 0;
+    avisos |= bits;
+    return novos;
+}
+
+// Relatório em texto: uso de cada região e profundidade de cada ponto
+int pilha_relatorio(char *buf, size_t tamanho) {
+    uint32_t bits = calcular_avisos();
+    int n = snprintf(buf, tamanho, "limiar_aviso=%d%% sentinela=%08lx\n", PILHA_LIMIAR_AVISO_PCT,
+                     (unsigned long)PILHA_SENTINELA);
+    for (int i = 0; i < 2 && n >= 0 && (size_t)n < tamanho; i++) {
+        regiao_pilha_t *r = &regioes[i];
+        uint32_t u = usado(r);
+        n += snprintf(buf + n, tamanho - n, "%s usado=%lu reservado=%lu livre=%lu%s\n", r->nome, (unsigned long)u,
+                      (unsigned long)r->reservado, (unsigned long)(r->base ? bytes_entre(r->base, r->topo) - u : 0),
+                      (bits & (1u << i)) ? " AVISO" : "");
+    }
+    for (uint32_t i = 0; i < num_pontos && n >= 0 && (size_t)n < tamanho; i++) {
+        const pilha_ponto_t *p = pontos[i];
+        n += snprintf(buf + n, tamanho - n, "%s maximo=%lu ultimo=%lu chamadas=%lu%s\n", p->nome,
+                      (unsigned long)p->maximo, (unsigned long)p->ultimo, (unsigned long)p->chamadas,
+                      (bits & (1u << (2 + i))) ? " AVISO" : "");
+    }
+    if (n >= 0 && (size_t)n < tamanho) {
+        n += snprintf(buf + n, tamanho - n, "nao_medidos=%lu\n", (unsigned long)nao_medidos);
+    }
+    return n;
+}
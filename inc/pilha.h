@@ -0,0 +1,46 @@
+#ifndef PILHA_H
+#define PILHA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Uso da pilha por pintura: no boot, a área livre das pilhas dos dois núcleos
+// é preenchida com PILHA_SENTINELA; a palavra pintada mais baixa já
+// sobrescrita marca a profundidade máxima alcançada.
+//
+// No RP2040 as interrupções do núcleo 0 usam a mesma pilha (MSP) do laço
+// principal; não há pilha de IRQ separada. Por isso os callbacks lwIP (IRQ do
+// CYW43) e o handler dos botões aparecem como pontos de medição próprios.
+//
+// Cada ponto de entrada instrumentado (pilha_entrar/pilha_sair em volta do
+// trecho) registra a profundidade abaixo do SP de entrada, incluindo
+// interrupções que chegaram no meio. O SP é o de dentro de pilha_entrar,
+// poucos bytes abaixo do chamador. A entrada repinta a área abaixo do SP
+// com as interrupções desligadas (dezenas de microssegundos no pior caso).
+#define PILHA_SENTINELA 0xDEADBEEFu
+#define PILHA_MAX_PONTOS 8
+#define PILHA_ANINHAMENTO 4         // Pontos ativos ao mesmo tempo (laço + IRQs)
+
+// Uso acima desta fração da pilha reservada (PICO_STACK_SIZE) gera aviso
+#ifndef PILHA_LIMIAR_AVISO_PCT
+#define PILHA_LIMIAR_AVISO_PCT 75
+#endif
+
+typedef struct {
+    const char *nome;
+    uint32_t maximo;                // Maior profundidade medida, em bytes
+    uint32_t ultimo;                // Profundidade da última execução
+    uint32_t chamadas;
+    bool registrado;
+} pilha_ponto_t;
+
+#define PILHA_PONTO(variavel, nome_ponto) pilha_ponto_t variavel = {.nome = nome_ponto}
+
+void pilha_pintar(void);
+void pilha_entrar(pilha_ponto_t *ponto);
+void pilha_sair(pilha_ponto_t *ponto);
+bool pilha_verificar(void);
+int pilha_relatorio(char *buf, size_t tamanho);
+
+#endif
@@ -0,0 +1,159 @@
+#include "ponto_fixo.h"
+
+// Sensor interno (datasheet do RP2040): T = 27 - (V - 0,706) / 0,001721.
+// Em centésimos de grau e por passo do ADC, T = A - B * bruto, com
+//   B = 3,3 * 100 / (4096 * 0,001721)  = 330000000 / 1721 / 4096
+//   A = 2700 + 0,706 * 100 / 0,001721  = (2700 * 1721 + 70600000) / 1721
+// guardados em Q12 (12 bits de fração): 4095 * B_Q12 cabe em 32 bits.
+#define TEMP_INCLINACAO_Q12 ((330000000 + 1721 / 2) / 1721)
+#define TEMP_BASE_Q12 ((int32_t)(((2700LL * 1721 + 70600000) * 4096 + 1721 / 2) / 1721))
+
+int32_t ponto_fixo_temperatura(uint16_t bruto) {
+    int32_t q12 = TEMP_BASE_Q12 - (int32_t)bruto * TEMP_INCLINACAO_Q12;
+    // Arredonda para o centésimo mais próximo nos dois sinais
+    return q12 >= 0 ? (q12 + 2048) / 4096 : -((-q12 + 2048) / 4096);
+}
+
+// Eco do HC-SR04: 58 us por centímetro (ida e volta). A divisão inteira por
+// 58 no caminho da regra (mm / 10) dá o mesmo que o antigo (int)(us / 58.0).
+uint32_t ponto_fixo_distancia_mm(uint32_t pulso_us) {
+    return pulso_us * 10 / 58;
+}
+
+// Escreve valor / 10^casas com casas decimais ("-3.05"), sem printf. Mesmo
+// contrato do snprintf: retorna o tamanho completo e sempre termina em '\0'.
+int ponto_fixo_formatar(char *buf, size_t tamanho, int32_t valor, unsigned casas) {
+    char texto[16];
+    int n = sizeof(texto);
+    uint32_t resto = valor < 0 ? 0u - (uint32_t)valor : (uint32_t)valor;
+    unsigned digitos = 0;
+    if (casas > 9) {
+        casas = 9;
+    }
+    do {
+        if (digitos == casas && casas > 0) {
+            texto[--n] = '.';
+        }
+        texto[--n] = (char)('0' + resto % 10);
+        resto /= 10;
+        digitos++;
+    } while (resto > 0 || digitos <= casas);
+    if (valor < 0) {
+        texto[--n] = '-';
+    }
+
+    int total = (int)sizeof(texto) - n;
+    if (tamanho > 0) {
+        size_t copiar = (size_t)total < tamanho ? (size_t)total : tamanho - 1;
+        for (size_t i = 0; i < copiar; i++) {
+            buf[i] = texto[n + i];
+        }
+        buf[copiar] = '\0';
+    }
+    return total;
+}
+
+#if PONTO_FIXO_MEDIR
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include "hardware/structs/systick.h"
+
+#define MEDIR_AMOSTRAS 64
+
+// Saídas voláteis: o compilador não pode descartar nem juntar as conversões
+static volatile float saida_float;
+static volatile int32_t saida_inteira;
+static char saida_texto[16];
+
+typedef void (*caminho_t)(uint32_t entrada);
+
+// Caminhos antigos, como estavam no firmware antes do ponto fixo
+static void __attribute__((noinline)) temperatura_float(uint32_t bruto) {
+    const float conversion_factor = 3.3f / (1 << 12);
+    saida_float = 27.0f - (((uint16_t)bruto * conversion_factor) - 0.706f) / 0.001721f;
+}
+
+static void __attribute__((noinline)) distancia_double(uint32_t pulso_us) {
+    int64_t pulse_duration = pulso_us;
+    saida_float = pulse_duration / 58.0;
+}
+
+// O float promovido a double no snprintf, como o antigo temperatura_atual
+static void __attribute__((noinline)) formatar_float(uint32_t valor) {
+    snprintf(saida_texto, sizeof(saida_texto), "%.2f", (double)(float)valor);
+}
+
+// Caminhos atuais
+static void __attribute__((noinline)) temperatura_inteira(uint32_t bruto) {
+    saida_inteira = ponto_fixo_temperatura((uint16_t)bruto);
+}
+
+static void __attribute__((noinline)) distancia_inteira(uint32_t pulso_us) {
+    saida_inteira = (int32_t)ponto_fixo_distancia_mm(pulso_us);
+}
+
+// Mesmo texto que formatar_float ("4095.00")
+static void __attribute__((noinline)) formatar_inteiro(uint32_t valor) {
+    ponto_fixo_formatar(saida_texto, sizeof(saida_texto), (int32_t)valor * 100, 2);
+}
+
+// Chamada vazia: custo da própria medição, descontado dos outros caminhos
+static void __attribute__((noinline)) vazio(uint32_t entrada) {
+    saida_inteira = (int32_t)entrada;
+}
+
+// Média de ciclos por chamada em MEDIR_AMOSTRAS entradas espalhadas pela
+// faixa, com as interrupções desligadas. O SysTick conta para baixo em 24 bits
+// no clock do processador.
+static uint32_t medir(caminho_t caminho, uint32_t maximo) {
+    uint32_t soma = 0;
+    for (uint32_t i = 0; i < MEDIR_AMOSTRAS; i++) {
+        uint32_t entrada = i * maximo / (MEDIR_AMOSTRAS - 1);
+        uint32_t estado = save_and_disable_interrupts();
+        uint32_t inicio = systick_hw->cvr;
+        caminho(entrada);
+        uint32_t fim = systick_hw->cvr;
+        restore_interrupts(estado);
+        soma += (inicio - fim) & 0xFFFFFF;
+    }
+    return soma / MEDIR_AMOSTRAS;
+}
+
+static uint32_t medir_liquido(caminho_t caminho, uint32_t maximo, uint32_t base) {
+    uint32_t ciclos = medir(caminho, maximo);
+    return ciclos > base ? ciclos - base : 0;
+}
+
+// Ciclos por conversão, antes (float/double) e depois (inteiros), e o tempo
+// total da rodada pelo time_us_32
+int ponto_fixo_relatorio(char *buf, size_t tamanho) {
+    systick_hw->csr = 0;
+    systick_hw->rvr = 0xFFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;  // ENABLE | CLKSOURCE (clock do processador)
+
+    uint32_t inicio = time_us_32();
+    uint32_t base = medir(vazio, 4095);
+    uint32_t temp_antes = medir_liquido(temperatura_float, 4095, base);
+    uint32_t temp_depois = medir_liquido(temperatura_inteira, 4095, base);
+    uint32_t dist_antes = medir_liquido(distancia_double, 30000, base);
+    uint32_t dist_depois = medir_liquido(distancia_inteira, 30000, base);
+    uint32_t texto_antes = medir_liquido(formatar_float, 5000, base);
+    uint32_t texto_depois = medir_liquido(formatar_inteiro, 5000, base);
+    uint32_t duracao = time_us_32() - inicio;
+
+    return snprintf(buf, tamanho,
+                    "clk_sys=%luHz amostras=%d base=%lu ciclos\n"
+                    "temperatura antes=%lu depois=%lu ciclos\n"
+                    "distancia antes=%lu depois=%lu ciclos\n"
+                    "formatar antes=%lu depois=%lu ciclos\n"
+                    "duracao=%luus\n",
+                    (unsigned long)clock_get_hz(clk_sys), MEDIR_AMOSTRAS, (unsigned long)base,
+                    (unsigned long)temp_antes, (unsigned long)temp_depois,
+                    (unsigned long)dist_antes, (unsigned long)dist_depois,
+                    (unsigned long)texto_antes, (unsigned long)texto_depois,
+                    (unsigned long)duracao);
+}
+#endif
@@ -0,0 +1,27 @@
+#ifndef PONTO_FIXO_H
+#define PONTO_FIXO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Conversões dos sensores em aritmética inteira. O RP2040 (Cortex-M0+) não
+// tem FPU: cada operação em float/double vira uma chamada de emulação, e o
+// printf com %f arrasta o suporte a ponto flutuante para a flash.
+//
+// Unidades: centésimos de grau Celsius e milímetros.
+int32_t ponto_fixo_temperatura(uint16_t bruto);
+uint32_t ponto_fixo_distancia_mm(uint32_t pulso_us);
+int ponto_fixo_formatar(char *buf, size_t tamanho, int32_t valor, unsigned casas);
+
+// 1: GET /ponto_fixo mede, em ciclos do SysTick, as conversões antigas em
+// float/double contra as funções acima (cmake -DPONTO_FIXO_MEDIR=ON, que
+// também religa o %f do printf só para essa comparação)
+#ifndef PONTO_FIXO_MEDIR
+#define PONTO_FIXO_MEDIR 0
+#endif
+
+#if PONTO_FIXO_MEDIR
+int ponto_fixo_relatorio(char *buf, size_t tamanho);
+#endif
+
+#endif
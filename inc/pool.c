@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include "pool.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+// Encadeia todos os blocos na lista de livres
+void pool_init(pool_t *pool) {
+    pool->livres = NULL;
+    for (int i = pool->num_blocos - 1; i >= 0; i--) {
+        void **bloco = (void **)(pool->memoria + (size_t)i * pool->tamanho_bloco);
+        *bloco = pool->livres;
+        pool->livres = bloco;
+    }
+    pool->em_uso = 0;
+    pool->maximo_em_uso = 0;
+    pool->falhas = 0;
+}
+
+// Retorna um bloco livre, ou NULL se o pool estiver esgotado
+void *pool_alocar(pool_t *pool) {
+    uint32_t estado = save_and_disable_interrupts();
+    void **bloco = (void **)pool->livres;
+    if (bloco) {
+        pool->livres = *bloco;
+        if (++pool->em_uso > pool->maximo_em_uso) {
+            pool->maximo_em_uso = pool->em_uso;
+        }
+    } else {
+        pool->falhas++;
+    }
+    restore_interrupts(estado);
+    return bloco;
+}
+
+// Devolve um bloco ao pool; NULL é ignorado
+void pool_liberar(pool_t *pool, void *bloco) {
+    if (!bloco) {
+        return;
+    }
+    uint32_t estado = save_and_disable_interrupts();
+    *(void **)bloco = pool->livres;
+    pool->livres = bloco;
+    pool->em_uso--;
+    restore_interrupts(estado);
+}
+
+// Indica se o endereço pertence à memória do pool
+bool pool_contem(const pool_t *pool, const void *bloco) {
+    const uint8_t *p = (const uint8_t *)bloco;
+    return p >= pool->memoria && p < pool->memoria + (size_t)pool->num_blocos * pool->tamanho_bloco;
+}
+
+// Uma linha por pool: tamanho do bloco, total, em uso, marca d'água e falhas
+int pool_relatorio(pool_t *const *pools, size_t quantidade, char *buf, size_t tamanho) {
+    int n = 0;
+    for (size_t i = 0; i < quantidade && (size_t)n < tamanho; i++) {
+        const pool_t *p = pools[i];
+        n += snprintf(buf + n, tamanho - n, "%s bloco=%uB total=%u em_uso=%u maximo=%u falhas=%lu\n",
+                      p->nome, p->tamanho_bloco, p->num_blocos, p->em_uso, p->maximo_em_uso,
+                      (unsigned long)p->falhas);
+    }
+    return n;
+}
@@ -0,0 +1,34 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Pool de blocos de tamanho fixo em memória estática. Alocação e liberação
+// são O(1) (lista de livres). O Cortex-M0+ não tem LDREX/STREX, então a troca
+// do topo da lista é feita com as interrupções mascaradas por poucas instruções.
+typedef struct {
+    const char *nome;
+    uint8_t *memoria;
+    uint16_t tamanho_bloco;
+    uint16_t num_blocos;
+    void *livres;            // Topo da lista de blocos livres
+    uint16_t em_uso;
+    uint16_t maximo_em_uso;  // Marca d'água
+    uint32_t falhas;         // Alocações recusadas por falta de blocos
+} pool_t;
+
+// Declara um pool com a memória dos blocos alinhada a 4 bytes
+#define POOL_DEFINIR(variavel, tamanho, quantidade)                                       \
+    static uint32_t variavel##_memoria[(quantidade) * (((tamanho) + 3) / 4)];              \
+    pool_t variavel = {#variavel, (uint8_t *)variavel##_memoria, (((tamanho) + 3) / 4) * 4, \
+                       (quantidade), NULL, 0, 0, 0}
+
+void pool_init(pool_t *pool);
+void *pool_alocar(pool_t *pool);
+void pool_liberar(pool_t *pool, void *bloco);
+bool pool_contem(const pool_t *pool, const void *bloco);
+int pool_relatorio(pool_t *const *pools, size_t quantidade, char *buf, size_t tamanho);
+
+#endif
@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <string.h>
+#include "regras.h"
+#include "histograma.h"
+#include "pico/stdlib.h"
+
+typedef struct {
+    uint8_t saida;
+    uint8_t modo;
+    uint8_t inicio;        // Posição do código em programa_t.codigo
+    uint8_t tamanho;
+    uint16_t entradas;     // Entradas lidas pelo código (dependências)
+    int8_t resultado;      // Última condição avaliada (-1 = nunca avaliada)
+    bool pendente;         // Leu entrada sob demanda: reavaliar no próximo passo
+} regra_t;
+
+typedef struct {
+    regra_t regras[REGRAS_MAX];
+    uint8_t quantidade;
+    uint8_t codigo[REGRAS_TAMANHO_TABELA];
+} programa_t;
+
+static const entrada_regra_t *entradas;
+static size_t num_entradas;
+static const saida_regra_t *saidas;
+static size_t num_saidas;
+
+static programa_t programa;            // Em uso pelo laço principal
+static programa_t recebido;            // Carregado pela rede, ainda não instalado
+static volatile bool carga_pendente;
+
+static int32_t valores[REGRAS_MAX_ENTRADAS];
+static uint32_t mudou;                 // Entradas amostradas que mudaram neste passo
+static uint32_t lidas_no_passo;        // Entradas sob demanda já lidas neste passo
+static uint32_t amostragem_passo_us;
+
+static struct {
+    uint32_t passos, avaliadas, ignoradas, instrucoes, leituras_sob_demanda, cargas, cargas_invalidas;
+} contadores;
+static histograma_t tempo_regras;      // CPU por passo, sem a leitura das entradas sob demanda
+static histograma_t tempo_amostragem;  // Leitura das entradas sob demanda num passo
+
+static const char *const nomes_modos[] = {"seguir", "acionar"};
+
+// Confere o código de uma regra: instruções e operandos válidos, saltos para
+// a frente caindo no início de uma instrução, pilha dentro do limite e com
+// o mesmo nível por qualquer caminho, e um único valor ao final
+static bool verificar(const uint8_t *codigo, size_t tamanho, uint16_t *dependencias) {
+    int8_t nivel_salto[REGRAS_TAMANHO_TABELA + 1];
+    bool inicio[REGRAS_TAMANHO_TABELA + 1];
+    memset(nivel_salto, -1, tamanho + 1);
+    memset(inicio, 0, tamanho + 1);
+    *dependencias = 0;
+
+    int nivel = 0;
+    size_t pc = 0;
+    while (pc < tamanho) {
+        if (nivel_salto[pc] >= 0 && nivel_salto[pc] != nivel) {
+            return false;
+        }
+        inicio[pc] = true;
+        switch (codigo[pc]) {
+        case OP_ENTRADA:
+            if (pc + 1 >= tamanho || codigo[pc + 1] >= num_entradas) {
+                return false;
+            }
+            *dependencias |= 1u << codigo[pc + 1];
+            nivel++;
+            pc += 2;
+            break;
+        case OP_CONST:
+            if (pc + 2 >= tamanho) {
+                return false;
+            }
+            nivel++;
+            pc += 3;
+            break;
+        case OP_MENOR:
+        case OP_MAIOR:
+        case OP_IGUAL:
+            if (nivel < 2) {
+                return false;
+            }
+            nivel--;
+            pc++;
+            break;
+        case OP_NAO:
+            if (nivel < 1) {
+                return false;
+            }
+            pc++;
+            break;
+        case OP_SE_FALSO:
+        case OP_SE_VERDADEIRO: {
+            if (pc + 1 >= tamanho || nivel < 1) {
+                return false;
+            }
+            size_t destino = pc + 2 + codigo[pc + 1];
+            if (destino > tamanho || (nivel_salto[destino] >= 0 && nivel_salto[destino] != nivel)) {
+                return false;
+            }
+            nivel_salto[destino] = nivel;
+            nivel--;
+            pc += 2;
+            break;
+        }
+        default:
+            return false;
+        }
+        if (nivel > REGRAS_PILHA) {
+            return false;
+        }
+    }
+    if (nivel_salto[tamanho] >= 0 && nivel_salto[tamanho] != nivel) {
+        return false;
+    }
+    for (size_t i = 0; i < tamanho; i++) {
+        if (nivel_salto[i] >= 0 && !inicio[i]) {
+            return false;
+        }
+    }
+    return nivel == 1;
+}
+
+// Monta o programa a partir da tabela, verificando cada regra
+static bool montar(programa_t *p, const uint8_t *tabela, size_t tamanho) {
+    if (tamanho < 3 || tabela[0] != 'R' || tabela[1] != REGRAS_VERSAO || tabela[2] > REGRAS_MAX) {
+        return false;
+    }
+    memset(p, 0, sizeof(*p));
+    size_t pos = 3;
+    size_t usado = 0;
+    for (uint8_t i = 0; i < tabela[2]; i++) {
+        if (pos + 3 > tamanho) {
+            return false;
+        }
+        uint8_t saida = tabela[pos];
+        uint8_t modo = tabela[pos + 1];
+        uint8_t tam = tabela[pos + 2];
+        pos += 3;
+        if (saida >= num_saidas || modo > REGRA_ACIONAR || tam == 0 || pos + tam > tamanho ||
+            usado + tam > sizeof(p->codigo)) {
+            return false;
+        }
+        regra_t *r = &p->regras[i];
+        memcpy(p->codigo + usado, tabela + pos, tam);
+        if (!verificar(p->codigo + usado, tam, &r->entradas)) {
+            return false;
+        }
+        r->saida = saida;
+        r->modo = modo;
+        r->inicio = usado;
+        r->tamanho = tam;
+        r->resultado = -1;
+        usado += tam;
+        pos += tam;
+    }
+    p->quantidade = tabela[2];
+    return pos == tamanho;
+}
+
+// Valor atual da entrada; as sob demanda são lidas no máximo uma vez por passo
+static int32_t valor_entrada(uint8_t i, bool *leu_sob_demanda) {
+    const entrada_regra_t *e = &entradas[i];
+    if (e->sob_demanda) {
+        *leu_sob_demanda = true;
+        if (!(lidas_no_passo & (1u << i))) {
+            uint32_t inicio = time_us_32();
+            valores[i] = e->ler();
+            amostragem_passo_us += time_us_32() - inicio;
+            lidas_no_passo |= 1u << i;
+            contadores.leituras_sob_demanda++;
+        }
+    }
+    return valores[i];
+}
+
+// Executa o código (já verificado) de uma regra
+static bool executar(const regra_t *r, bool *leu_sob_demanda) {
+    const uint8_t *c = programa.codigo + r->inicio;
+    int32_t pilha[REGRAS_PILHA];
+    int topo = 0;
+    size_t pc = 0;
+    while (pc < r->tamanho) {
+        contadores.instrucoes++;
+        switch (c[pc]) {
+        case OP_ENTRADA:
+            pilha[topo++] = valor_entrada(c[pc + 1], leu_sob_demanda);
+            pc += 2;
+            break;
+        case OP_CONST:
+            pilha[topo++] = (int16_t)(c[pc + 1] | (c[pc + 2] << 8));
+            pc += 3;
+            break;
+        case OP_MENOR:
+            topo--;
+            pilha[topo - 1] = pilha[topo - 1] < pilha[topo];
+            pc++;
+            break;
+        case OP_MAIOR:
+            topo--;
+            pilha[topo - 1] = pilha[topo - 1] > pilha[topo];
+            pc++;
+            break;
+        case OP_IGUAL:
+            topo--;
+            pilha[topo - 1] = pilha[topo - 1] == pilha[topo];
+            pc++;
+            break;
+        case OP_NAO:
+            pilha[topo - 1] = !pilha[topo - 1];
+            pc++;
+            break;
+        case OP_SE_FALSO:
+        case OP_SE_VERDADEIRO:
+            if ((pilha[topo - 1] != 0) == (c[pc] == OP_SE_VERDADEIRO)) {
+                pc += 2 + c[pc + 1];
+            } else {
+                topo--;
+                pc += 2;
+            }
+            break;
+        }
+    }
+    return pilha[0] != 0;
+}
+
+// Desliga as saídas mantidas pelas regras de acompanhamento do programa atual
+static void soltar_saidas(void) {
+    for (uint8_t i = 0; i < programa.quantidade; i++) {
+        const regra_t *r = &programa.regras[i];
+        if (r->modo == REGRA_SEGUIR && r->resultado == 1) {
+            saidas[r->saida].escrever(false);
+        }
+    }
+}
+
+// Registra entradas e saídas da aplicação e instala a tabela inicial
+bool regras_iniciar(const entrada_regra_t *lista_entradas, size_t quantidade_entradas,
+                    const saida_regra_t *lista_saidas, size_t quantidade_saidas,
+                    const uint8_t *tabela, size_t tamanho) {
+    entradas = lista_entradas;
+    num_entradas = quantidade_entradas < REGRAS_MAX_ENTRADAS ? quantidade_entradas : REGRAS_MAX_ENTRADAS;
+    saidas = lista_saidas;
+    num_saidas = quantidade_saidas;
+    carga_pendente = false;
+    memset(&contadores, 0, sizeof(contadores));
+    histograma_limpar(&tempo_regras);
+    histograma_limpar(&tempo_amostragem);
+    return montar(&programa, tabela, tamanho);
+}
+
+// Um passo do motor (laço principal): amostra as entradas e reavalia só as
+// regras afetadas
+void regras_avaliar(void) {
+    uint32_t inicio = time_us_32();
+    amostragem_passo_us = 0;
+    lidas_no_passo = 0;
+    contadores.passos++;
+
+    for (size_t i = 0; i < num_entradas; i++) {
+        if (entradas[i].sob_demanda) {
+            continue;
+        }
+        int32_t valor = entradas[i].ler();
+        int32_t diferenca = valor > valores[i] ? valor - valores[i] : valores[i] - valor;
+        if (diferenca > entradas[i].banda || contadores.passos == 1) {
+            valores[i] = valor;
+            mudou |= 1u << i;
+        }
+    }
+
+    for (uint8_t i = 0; i < programa.quantidade; i++) {
+        regra_t *r = &programa.regras[i];
+        const saida_regra_t *s = &saidas[r->saida];
+        if (r->resultado >= 0 && !r->pendente && !(r->entradas & mudou)) {
+            contadores.ignoradas++;
+            continue;
+        }
+        // Saída acionada fica assim até ser liberada fora do motor; a regra
+        // volta a ser avaliada quando isso acontecer
+        if (r->modo == REGRA_ACIONAR && s->ativa && s->ativa()) {
+            r->pendente = true;
+            contadores.ignoradas++;
+            continue;
+        }
+        bool leu_sob_demanda = false;
+        bool resultado = executar(r, &leu_sob_demanda);
+        r->pendente = leu_sob_demanda;
+        contadores.avaliadas++;
+        if (r->modo == REGRA_SEGUIR ? resultado != r->resultado : resultado) {
+            s->escrever(resultado);
+        }
+        r->resultado = resultado;
+    }
+    mudou = 0;
+
+    histograma_registrar(&tempo_regras, time_us_32() - inicio - amostragem_passo_us);
+    if (lidas_no_passo) {
+        histograma_registrar(&tempo_amostragem, amostragem_passo_us);
+    }
+}
+
+static int valor_hex(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Recebe uma tabela em hexadecimal e a verifica (contexto lwIP). O laço
+// principal a instala com regras_instalar_pendente.
+regras_carga_t regras_receber(const char *hex, size_t tamanho) {
+    if (carga_pendente) {
+        return REGRAS_CARGA_OCUPADA;
+    }
+    static uint8_t tabela[3 + REGRAS_MAX * 3 + REGRAS_TAMANHO_TABELA];
+    if (tamanho % 2 != 0 || tamanho / 2 > sizeof(tabela)) {
+        contadores.cargas_invalidas++;
+        return REGRAS_CARGA_INVALIDA;
+    }
+    for (size_t i = 0; i < tamanho / 2; i++) {
+        int alto = valor_hex(hex[2 * i]);
+        int baixo = valor_hex(hex[2 * i + 1]);
+        if (alto < 0 || baixo < 0) {
+            contadores.cargas_invalidas++;
+            return REGRAS_CARGA_INVALIDA;
+        }
+        tabela[i] = (alto << 4) | baixo;
+    }
+    if (!montar(&recebido, tabela, tamanho / 2)) {
+        contadores.cargas_invalidas++;
+        return REGRAS_CARGA_INVALIDA;
+    }
+    carga_pendente = true;
+    return REGRAS_CARGA_ACEITA;
+}
+
+// Troca o programa pelo recebido (laço principal, entre
+// cyw43_arch_lwip_begin/end). Todas as regras novas são avaliadas no
+// próximo passo.
+bool regras_instalar_pendente(void) {
+    if (!carga_pendente) {
+        return false;
+    }
+    soltar_saidas();
+    programa = recebido;
+    carga_pendente = false;
+    contadores.cargas++;
+    return true;
+}
+
+// Escreve o código da regra em texto, uma instrução por item
+static int desmontar(const regra_t *r, char *buf, size_t tamanho) {
+    const uint8_t *c = programa.codigo + r->inicio;
+    int n = 0;
+    size_t pc = 0;
+    while (pc < r->tamanho && (size_t)n < tamanho) {
+        const char *separador = pc ? "; " : "";
+        switch (c[pc]) {
+        case OP_ENTRADA:
+            n += snprintf(buf + n, tamanho - n, "%sin %s", separador, entradas[c[pc + 1]].nome);
+            pc += 2;
+            break;
+        case OP_CONST:
+            n += snprintf(buf + n, tamanho - n, "%sk %d", separador, (int16_t)(c[pc + 1] | (c[pc + 2] << 8)));
+            pc += 3;
+            break;
+        case OP_SE_FALSO:
+        case OP_SE_VERDADEIRO:
+            n += snprintf(buf + n, tamanho - n, "%s%s +%u", separador,
+                          c[pc] == OP_SE_FALSO ? "se_falso" : "se_verdadeiro", c[pc + 1]);
+            pc += 2;
+            break;
+        default:
+            n += snprintf(buf + n, tamanho - n, "%s%s", separador,
+                          c[pc] == OP_MENOR ? "menor" : c[pc] == OP_MAIOR ? "maior" : c[pc] == OP_IGUAL ? "igual" : "nao");
+            pc++;
+            break;
+        }
+    }
+    return n;
+}
+
+// Entradas (* = sob demanda), saídas, regras desmontadas e custo por passo
+int regras_relatorio(char *buf, size_t tamanho) {
+    int n = snprintf(buf, tamanho, "entradas=");
+    for (size_t i = 0; i < num_entradas && (size_t)n < tamanho; i++) {
+        n += snprintf(buf + n, tamanho - n, "%s%s%s", i ? "," : "", entradas[i].nome,
+                      entradas[i].sob_demanda ? "*" : "");
+    }
+    for (size_t i = 0; i < num_saidas && (size_t)n < tamanho; i++) {
+        n += snprintf(buf + n, tamanho - n, "%s%s", i ? "," : "\nsaidas=", saidas[i].nome);
+    }
+    for (size_t i = 0; i < num_entradas && (size_t)n < tamanho; i++) {
+        n += snprintf(buf + n, tamanho - n, "%s%ld", i ? "," : "\nvalores=", (long)valores[i]);
+    }
+    for (uint8_t i = 0; i < programa.quantidade && (size_t)n < tamanho; i++) {
+        const regra_t *r = &programa.regras[i];
+        n += snprintf(buf + n, tamanho - n, "\nr%u %s %s (%d): ", i, saidas[r->saida].nome,
+                      nomes_modos[r->modo], r->resultado);
+        if ((size_t)n < tamanho) {
+            n += desmontar(r, buf + n, tamanho - n);
+        }
+    }
+    if ((size_t)n >= tamanho) {
+        return n;
+    }
+    n += snprintf(buf + n, tamanho - n,
+                  "\npassos=%lu avaliadas=%lu ignoradas=%lu instrucoes=%lu leituras_sob_demanda=%lu "
+                  "cargas=%lu cargas_invalidas=%lu\n",
+                  (unsigned long)contadores.passos, (unsigned long)contadores.avaliadas,
+                  (unsigned long)contadores.ignoradas, (unsigned long)contadores.instrucoes,
+                  (unsigned long)contadores.leituras_sob_demanda, (unsigned long)contadores.cargas,
+                  (unsigned long)contadores.cargas_invalidas);
+    if ((size_t)n >= tamanho) {
+        return n;
+    }
+    n += histograma_formatar(&tempo_regras, "regras", buf + n, tamanho - n);
+    if ((size_t)n >= tamanho) {
+        return n;
+    }
+    n += histograma_formatar(&tempo_amostragem, "amostragem", buf + n, tamanho - n);
+    return n;
+}
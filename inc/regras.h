@@ -0,0 +1,78 @@
+#ifndef REGRAS_H
+#define REGRAS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Motor de regras de automação. Cada regra é uma condição sobre as entradas
+// (sensores), compilada num bytecode de pilha, ligada a uma saída.
+//
+// Tabela (como enviada por GET /carregar_regras?t=<hex>):
+//   u8 'R'  u8 versao (1)  u8 quantidade
+//   quantidade x { u8 saida  u8 modo  u8 tamanho  u8 codigo[tamanho] }
+//
+// Instruções (operandos little-endian):
+//   OP_ENTRADA i    empilha o valor da entrada i
+//   OP_CONST k16    empilha a constante (int16)
+//   OP_MENOR, OP_MAIOR, OP_IGUAL   desempilha b, a; empilha a < b, a > b, a == b
+//   OP_NAO          inverte o topo
+//   OP_SE_FALSO n   topo falso: salta n bytes e o mantém; senão o desempilha (&&)
+//   OP_SE_VERDADEIRO n   idem para topo verdadeiro (||)
+// Saltos só para a frente; ao fim do código a pilha tem exatamente o resultado.
+//
+// A avaliação é incremental: as entradas amostradas são lidas a cada passo e
+// só as regras que dependem de uma entrada que mudou são reavaliadas. Entradas
+// sob demanda (ultrassônicos) só são lidas quando a avaliação chega a elas;
+// uma regra que leu alguma é reavaliada no passo seguinte.
+#define REGRAS_VERSAO 1
+#define REGRAS_MAX 8
+#define REGRAS_MAX_ENTRADAS 16
+#define REGRAS_TAMANHO_TABELA 192
+#define REGRAS_PILHA 8
+
+enum {
+    OP_ENTRADA = 0x01,
+    OP_CONST = 0x02,
+    OP_MENOR = 0x10,
+    OP_MAIOR = 0x11,
+    OP_IGUAL = 0x12,
+    OP_NAO = 0x13,
+    OP_SE_FALSO = 0x20,
+    OP_SE_VERDADEIRO = 0x21,
+};
+
+typedef enum {
+    REGRA_SEGUIR,      // A saída acompanha a condição
+    REGRA_ACIONAR,     // A saída é ativada quando a condição vale e fica ativa
+} modo_regra_t;
+
+typedef struct {
+    const char *nome;
+    int32_t (*ler)(void);
+    bool sob_demanda;  // Lida só quando uma regra precisa dela
+    uint16_t banda;    // Variação mínima tratada como mudança (ruído do ADC)
+} entrada_regra_t;
+
+typedef struct {
+    const char *nome;
+    void (*escrever)(bool ativa);
+    bool (*ativa)(void);   // Estado atual; regra de acionamento não reavalia saída já ativa
+} saida_regra_t;
+
+// Resultado de uma tabela recebida pela rede
+typedef enum {
+    REGRAS_CARGA_ACEITA,
+    REGRAS_CARGA_INVALIDA,
+    REGRAS_CARGA_OCUPADA,  // Carga anterior ainda não instalada
+} regras_carga_t;
+
+bool regras_iniciar(const entrada_regra_t *entradas, size_t num_entradas,
+                    const saida_regra_t *saidas, size_t num_saidas,
+                    const uint8_t *tabela, size_t tamanho);
+void regras_avaliar(void);
+regras_carga_t regras_receber(const char *hex, size_t tamanho);
+bool regras_instalar_pendente(void);
+int regras_relatorio(char *buf, size_t tamanho);
+
+#endif
@@ -0,0 +1,246 @@
+#include <string.h>
+#include "replica.h"
+
+#define TAMANHO_CABECALHO 17
+#define TAMANHO_MAC 8
+#define TAMANHO_DELTA 14
+#define TAMANHO_RESUMO 12
+
+static uint32_t ler32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t ler64(const uint8_t *p) {
+    return ler32(p) | ((uint64_t)ler32(p + 4) << 32);
+}
+
+static void escrever32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static void escrever64(uint8_t *p, uint64_t v) {
+    escrever32(p, (uint32_t)v);
+    escrever32(p + 4, (uint32_t)(v >> 32));
+}
+
+// xorshift32: espalha resumos e reparos entre os nós
+static uint32_t sortear(replica_t *r, uint32_t limite) {
+    uint32_t x = r->sorteio;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    r->sorteio = x;
+    return limite ? x % limite : 0;
+}
+
+// Relógio físico na escala do HLC. Depois de 2^32 ms (~49 dias) sem reiniciar
+// os ms transbordam para a época, o que só adianta o relógio.
+static uint64_t fisico_hlc(const replica_t *r, uint64_t agora_ms) {
+    return ((uint64_t)r->epoca << 48) + (agora_ms << 16);
+}
+
+// HLC de um evento local (mudança ou envio). Empacotado como l << 16 | c, o
+// máximo entre o relógio físico e o anterior + 1 é exatamente a regra do HLC.
+static uint64_t hlc_evento(replica_t *r, uint64_t agora_ms) {
+    uint64_t fisico = fisico_hlc(r, agora_ms);
+    r->relogio = fisico > r->relogio ? fisico : r->relogio + 1;
+    return r->relogio;
+}
+
+static void hlc_receber(replica_t *r, uint64_t remoto, uint64_t agora_ms) {
+    uint64_t fisico = fisico_hlc(r, agora_ms);
+    uint64_t maior = remoto > r->relogio ? remoto : r->relogio;
+    r->relogio = fisico > maior ? fisico : maior + 1;
+}
+
+// Ordem total das escritas: HLC e, no empate, o id do nó
+int replica_comparar(versao_replica_t a, versao_replica_t b) {
+    if (a.hlc != b.hlc) {
+        return a.hlc > b.hlc ? 1 : -1;
+    }
+    if (a.no != b.no) {
+        return a.no > b.no ? 1 : -1;
+    }
+    return 0;
+}
+
+// Agenda um DELTA de resposta a um nó atrasado, se ainda não houver envio
+// pendente do dispositivo
+static void agendar_reparo(replica_t *r, int d, uint64_t agora_ms) {
+    if (r->envios[d] == 0) {
+        r->envios[d] = 1;
+        r->proximo_envio_ms[d] = agora_ms + sortear(r, REPLICA_ATRASO_REPARO_MS + 1);
+        r->contadores.reparos++;
+    }
+}
+
+// Época atual do HLC, a maior vista pelo nó (a gravar para o próximo boot)
+uint32_t replica_epoca(const replica_t *r) {
+    return (uint32_t)(r->relogio >> 48);
+}
+
+// estado é a palavra de estados atual do nó; os bits fora de
+// REPLICA_MASCARA não são replicados. epoca deve passar de todas as épocas
+// que o nó já viu (replica_epoca antes do reinício).
+void replica_iniciar(replica_t *r, const uint8_t chave[SIPHASH_TAMANHO_CHAVE], uint32_t id, uint32_t epoca,
+                     uint32_t estado, uint64_t agora_ms) {
+    memset(r, 0, sizeof(*r));
+    memcpy(r->chave, chave, SIPHASH_TAMANHO_CHAVE);
+    r->id = id;
+    r->epoca = epoca;
+    r->sorteio = id ? id : 1;
+    // HLC zero: o estado de boot perde para qualquer escrita da rede; entre
+    // estados de boot diferentes (sem escrita nenhuma ainda) vence o maior id
+    for (int d = 0; d < REPLICA_DISPOSITIVOS; d++) {
+        r->versoes[d].no = id;
+    }
+    r->valores = estado & REPLICA_MASCARA;
+    r->aplicada = r->valores;
+    r->relogio = fisico_hlc(r, agora_ms);
+    r->resumo_pedido = true;       // Anuncia-se logo para receber o estado do grupo
+    r->proximo_resumo_ms = agora_ms;
+}
+
+// Laço principal: registra as mudanças feitas no nó desde a última chamada
+// e devolve a palavra de estados com o que veio da rede
+uint32_t replica_sincronizar(replica_t *r, uint32_t estado, uint64_t agora_ms) {
+    uint32_t locais = (estado & REPLICA_MASCARA) ^ r->aplicada;
+    for (int d = 0; d < REPLICA_DISPOSITIVOS; d++) {
+        if (!(locais & (1u << d))) {
+            continue;
+        }
+        r->versoes[d].hlc = hlc_evento(r, agora_ms);
+        r->versoes[d].no = r->id;
+        r->valores = (r->valores & ~(1u << d)) | (estado & (1u << d));
+        r->envios[d] = 1 + REPLICA_REPETICOES;
+        r->proximo_envio_ms[d] = agora_ms;
+        r->contadores.locais++;
+    }
+    r->aplicada = r->valores;
+    return (estado & ~REPLICA_MASCARA) | r->valores;
+}
+
+static size_t fechar(replica_t *r, uint8_t *buf, uint8_t tipo, uint8_t quantidade, size_t tamanho, uint64_t agora_ms) {
+    buf[0] = 'L';
+    buf[1] = 'R';
+    buf[2] = REPLICA_VERSAO;
+    buf[3] = tipo;
+    escrever32(buf + 4, r->id);
+    escrever64(buf + 8, hlc_evento(r, agora_ms));
+    buf[16] = quantidade;
+    uint64_t mac = siphash24(r->chave, buf, tamanho);
+    escrever64(buf + tamanho, mac);
+    return tamanho + TAMANHO_MAC;
+}
+
+// Próximo datagrama a enviar agora (0 se nenhum): primeiro o DELTA das
+// mudanças e reparos vencidos, depois o RESUMO. Chamar até devolver 0.
+size_t replica_mensagem(replica_t *r, uint64_t agora_ms, uint8_t buf[REPLICA_TAMANHO_MAXIMO]) {
+    size_t n = TAMANHO_CABECALHO;
+    uint8_t quantidade = 0;
+    for (int d = 0; d < REPLICA_DISPOSITIVOS; d++) {
+        if (r->envios[d] == 0 || r->proximo_envio_ms[d] > agora_ms) {
+            continue;
+        }
+        r->envios[d]--;
+        r->proximo_envio_ms[d] = agora_ms + REPLICA_INTERVALO_MS;
+        buf[n] = (uint8_t)d;
+        buf[n + 1] = (r->valores >> d) & 1;
+        escrever64(buf + n + 2, r->versoes[d].hlc);
+        escrever32(buf + n + 10, r->versoes[d].no);
+        n += TAMANHO_DELTA;
+        quantidade++;
+    }
+    if (quantidade) {
+        r->contadores.deltas++;
+        r->contadores.entradas += quantidade;
+        return fechar(r, buf, REPLICA_DELTA, quantidade, n, agora_ms);
+    }
+
+    if (!r->resumo_pedido && agora_ms < r->proximo_resumo_ms) {
+        return 0;
+    }
+    r->resumo_pedido = false;
+    r->proximo_resumo_ms = agora_ms + REPLICA_PERIODO_RESUMO_MS + sortear(r, REPLICA_SORTEIO_RESUMO_MS);
+    for (int d = 0; d < REPLICA_DISPOSITIVOS; d++) {
+        escrever64(buf + n, r->versoes[d].hlc);
+        escrever32(buf + n + 8, r->versoes[d].no);
+        n += TAMANHO_RESUMO;
+    }
+    r->contadores.resumos++;
+    return fechar(r, buf, REPLICA_RESUMO, REPLICA_DISPOSITIVOS, n, agora_ms);
+}
+
+// Aplica um datagrama recebido. Devolve true se algum valor mudou (o laço
+// deve chamar replica_sincronizar para aplicá-lo).
+bool replica_receber(replica_t *r, const uint8_t *dados, size_t tamanho, uint64_t agora_ms) {
+    if (tamanho < TAMANHO_CABECALHO + TAMANHO_MAC || dados[0] != 'L' || dados[1] != 'R' ||
+        dados[2] != REPLICA_VERSAO) {
+        r->contadores.malformados++;
+        return false;
+    }
+    uint8_t tipo = dados[3];
+    uint8_t quantidade = dados[16];
+    size_t entrada = tipo == REPLICA_DELTA ? TAMANHO_DELTA : TAMANHO_RESUMO;
+    if ((tipo != REPLICA_DELTA && tipo != REPLICA_RESUMO) || quantidade > REPLICA_DISPOSITIVOS ||
+        tamanho != TAMANHO_CABECALHO + quantidade * entrada + TAMANHO_MAC) {
+        r->contadores.malformados++;
+        return false;
+    }
+    // MAC comparado sem sair no primeiro byte diferente
+    uint64_t mac = siphash24(r->chave, dados, tamanho - TAMANHO_MAC) ^ ler64(dados + tamanho - TAMANHO_MAC);
+    if (mac != 0) {
+        r->contadores.mac_invalido++;
+        return false;
+    }
+    if (ler32(dados + 4) == r->id) {
+        r->contadores.proprios++;      // Cópia local do multicast
+        return false;
+    }
+    uint64_t remetente = ler64(dados + 8);
+    if ((remetente >> 48) < (r->relogio >> 48)) {
+        // Época anterior: repetição de antes de um reinício, ou um nó que
+        // ainda não ouviu a época atual, que o RESUMO leva a ela
+        r->contadores.antigos++;
+        r->resumo_pedido = true;
+        return false;
+    }
+    r->contadores.recebidos++;
+    hlc_receber(r, remetente, agora_ms);
+
+    bool mudou = false;
+    const uint8_t *p = dados + TAMANHO_CABECALHO;
+    for (uint8_t i = 0; i < quantidade; i++, p += entrada) {
+        int d = tipo == REPLICA_DELTA ? p[0] : i;
+        const uint8_t *v = tipo == REPLICA_DELTA ? p + 2 : p;
+        versao_replica_t remota = {ler64(v), ler32(v + 8)};
+        if (d >= REPLICA_DISPOSITIVOS) {
+            continue;
+        }
+        int ordem = replica_comparar(remota, r->versoes[d]);
+        if (ordem < 0) {
+            // O remetente está atrás neste dispositivo
+            agendar_reparo(r, d, agora_ms);
+        } else if (tipo == REPLICA_RESUMO) {
+            if (ordem > 0) {
+                r->resumo_pedido = true;
+            }
+        } else if (ordem > 0) {
+            r->versoes[d] = remota;
+            uint32_t bit = 1u << d;
+            uint32_t valores = p[1] ? r->valores | bit : r->valores & ~bit;
+            mudou |= valores != r->valores;
+            r->valores = valores;
+            r->envios[d] = 0;
+            r->contadores.remotas++;
+        } else if (r->envios[d]) {
+            // Outro nó já enviou esta versão
+            r->envios[d] = 0;
+            r->contadores.suprimidos++;
+        }
+    }
+    return mudou;
+}
@@ -0,0 +1,91 @@
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "siphash.h"
+
+// Réplica dos estados dos dispositivos compartilhada entre placas (uma por
+// andar). Não depende da rede: inc/replicacao.c a liga ao UDP multicast e
+// bench/replicacao_sim.c roda várias instâncias no host.
+//
+// Cada dispositivo (bits 0 a 6 de estado_palavra(); o alarme acionado fica
+// local) é um registrador "último escritor vence". A versão de cada escrita
+// é o relógio lógico híbrido (HLC) do nó que a fez, desempatado pelo id:
+//   hlc = época << 48 | ms desde o boot do nó << 16 | contador
+// O HLC de cada nó avança para além de todo HLC recebido, então uma mudança
+// feita depois de ver outra sempre a vence, mesmo sem relógios sincronizados.
+// O estado de boot entra com HLC zero e perde para qualquer escrita.
+//
+// A época vem da flash: a cada boot, um a mais que a maior época já vista
+// pelo nó (a do seu HLC, que acompanha a dos outros). Um datagrama cujo HLC
+// do remetente é de uma época anterior à do nó é descartado sem olhar as
+// entradas: depois de um reinício da casa inteira, um DELTA capturado antes
+// não vence os estados de boot. Um nó que ainda não ouviu a época nova
+// recebe um RESUMO na hora, que o leva a ela.
+//
+// Datagrama (little-endian), terminado pelo SipHash-2-4 (8 bytes) de tudo o
+// que vem antes:
+//   0  u8[2] "LR"    4  u32 no (remetente)    16 u8 quantidade
+//   2  u8    versao  8  u64 hlc (do remetente, no envio)
+//   3  u8    tipo
+//   REPLICA_DELTA   quantidade x {u8 dispositivo, u8 valor, u64 hlc, u32 no}
+//   REPLICA_RESUMO  quantidade x {u64 hlc, u32 no}, dispositivos 0, 1, ...
+//
+// Uma mudança local sai num DELTA na hora e é repetida REPLICA_REPETICOES
+// vezes a cada REPLICA_INTERVALO_MS. A cada REPLICA_PERIODO_RESUMO_MS (com
+// sorteio) o nó anuncia as versões que tem num RESUMO; quem tem algo mais
+// novo responde com o DELTA só desses dispositivos, depois de um atraso
+// sorteado, e desiste se outro nó enviar a mesma versão antes. Quem descobre
+// pelo RESUMO que está atrás anuncia o seu na hora. Repetir um datagrama
+// antigo não desfaz nada: versões menores são ignoradas e épocas anteriores
+// são descartadas.
+#define REPLICA_VERSAO 1
+#define REPLICA_DISPOSITIVOS 7
+#define REPLICA_MASCARA ((1u << REPLICA_DISPOSITIVOS) - 1)
+#define REPLICA_REPETICOES 2
+#define REPLICA_INTERVALO_MS 100
+#define REPLICA_PERIODO_RESUMO_MS 1000
+#define REPLICA_SORTEIO_RESUMO_MS 250  // Espalha os resumos dos nós
+#define REPLICA_ATRASO_REPARO_MS 50    // Atraso máximo da resposta a um nó atrasado
+#define REPLICA_TAMANHO_MAXIMO (17 + 14 * REPLICA_DISPOSITIVOS + 8)
+
+enum {
+    REPLICA_DELTA = 1,
+    REPLICA_RESUMO = 2,
+};
+
+typedef struct {
+    uint64_t hlc;
+    uint32_t no;
+} versao_replica_t;
+
+typedef struct {
+    uint8_t chave[SIPHASH_TAMANHO_CHAVE];
+    uint32_t id;
+    uint32_t epoca;                                // Do boot; o HLC pode passar dela
+    uint64_t relogio;                              // HLC do nó
+    versao_replica_t versoes[REPLICA_DISPOSITIVOS];
+    uint32_t valores;                              // Bits replicados
+    uint32_t aplicada;                             // Bits do nó na última sincronização
+    uint8_t envios[REPLICA_DISPOSITIVOS];          // DELTAs que faltam de cada dispositivo
+    uint64_t proximo_envio_ms[REPLICA_DISPOSITIVOS];
+    bool resumo_pedido;
+    uint64_t proximo_resumo_ms;
+    uint32_t sorteio;
+    struct {
+        uint32_t locais, remotas, deltas, resumos, entradas, reparos, suprimidos;
+        uint32_t recebidos, proprios, antigos, mac_invalido, malformados;
+    } contadores;
+} replica_t;
+
+void replica_iniciar(replica_t *r, const uint8_t chave[SIPHASH_TAMANHO_CHAVE], uint32_t id, uint32_t epoca,
+                     uint32_t estado, uint64_t agora_ms);
+uint32_t replica_sincronizar(replica_t *r, uint32_t estado, uint64_t agora_ms);
+size_t replica_mensagem(replica_t *r, uint64_t agora_ms, uint8_t buf[REPLICA_TAMANHO_MAXIMO]);
+bool replica_receber(replica_t *r, const uint8_t *dados, size_t tamanho, uint64_t agora_ms);
+int replica_comparar(versao_replica_t a, versao_replica_t b);
+uint32_t replica_epoca(const replica_t *r);
+
+#endif
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <string.h>
+#include "replicacao.h"
+#include "replica.h"
+#include "energia.h"
+#include "gravacao.h"
+#include "pico/stdlib.h"
+#include "pico/rand.h"
+#include "pico/cyw43_arch.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "lwip/udp.h"
+#include "lwip/igmp.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+
+// Penúltimo setor da flash (o último é o das cenas): registro das épocas.
+// Cada gravação ocupa a próxima entrada ainda apagada; o setor só é apagado
+// quando enche.
+#define OFFSET_EPOCAS (PICO_FLASH_SIZE_BYTES - 2 * FLASH_SECTOR_SIZE)
+
+typedef struct {
+    uint32_t epoca;
+    uint32_t complemento;          // ~epoca: entrada gravada por inteiro
+} registro_epoca_t;
+
+#define REGISTROS_EPOCA (FLASH_SECTOR_SIZE / sizeof(registro_epoca_t))
+#define REGISTROS_POR_PAGINA (FLASH_PAGE_SIZE / sizeof(registro_epoca_t))
+
+static uint32_t epoca_gravada;
+static uint32_t proximo_registro;
+static uint32_t gravacoes_epoca;
+
+static struct udp_pcb *pcb;
+static ip_addr_t grupo;
+static replica_t replica;
+static uint32_t (*ler_estado)(void);
+static void (*definir_estado)(uint32_t palavra);
+static bool ativa;
+
+static struct {
+    uint32_t bytes_enviados, bytes_recebidos, falhas_envio, grandes;
+} trafego;
+
+static uint64_t agora_ms(void) {
+    return time_us_64() / 1000;
+}
+
+// Callback de recebimento (contexto lwIP). Mudanças vindas de outra placa
+// ficam na réplica até o laço chamar replicacao_sincronizar.
+static void replicacao_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    uint8_t dados[REPLICA_TAMANHO_MAXIMO];
+    u16_t tamanho = p->tot_len;
+    gravacao_udp_dados(REPLICACAO_PORTA, p);
+    if (tamanho > sizeof(dados)) {
+        trafego.grandes++;
+        pbuf_free(p);
+        return;
+    }
+    pbuf_copy_partial(p, dados, tamanho, 0);
+    pbuf_free(p);
+    trafego.bytes_recebidos += tamanho;
+    if (replica_receber(&replica, dados, tamanho, agora_ms())) {
+        // Acorda o laço principal para aplicar o estado novo
+        energia_sinalizar_evento();
+    }
+}
+
+// Última época gravada (0 se nenhuma) e a próxima entrada livre
+static void ler_epoca(void) {
+    const registro_epoca_t *r = (const registro_epoca_t *)(XIP_BASE + OFFSET_EPOCAS);
+    epoca_gravada = 0;
+    proximo_registro = 0;
+    while (proximo_registro < REGISTROS_EPOCA && r[proximo_registro].epoca != 0xFFFFFFFFu) {
+        if (r[proximo_registro].epoca == ~r[proximo_registro].complemento && r[proximo_registro].epoca > epoca_gravada) {
+            epoca_gravada = r[proximo_registro].epoca;
+        }
+        proximo_registro++;
+    }
+}
+
+// Grava a época na próxima entrada, programando só a página dela (os bytes
+// 0xFF não alteram a flash)
+static void gravar_epoca(uint32_t epoca) {
+    static uint8_t pagina[FLASH_PAGE_SIZE];
+    bool apagar = proximo_registro >= REGISTROS_EPOCA;
+    if (apagar) {
+        proximo_registro = 0;
+    }
+    memset(pagina, 0xFF, sizeof(pagina));
+    registro_epoca_t registro = {epoca, ~epoca};
+    memcpy(pagina + (proximo_registro % REGISTROS_POR_PAGINA) * sizeof(registro), &registro, sizeof(registro));
+    uint32_t deslocamento = OFFSET_EPOCAS + (proximo_registro / REGISTROS_POR_PAGINA) * FLASH_PAGE_SIZE;
+    uint32_t interrupcoes = save_and_disable_interrupts();
+    if (apagar) {
+        flash_range_erase(OFFSET_EPOCAS, FLASH_SECTOR_SIZE);
+    }
+    flash_range_program(deslocamento, pagina, FLASH_PAGE_SIZE);
+    restore_interrupts(interrupcoes);
+    proximo_registro++;
+    epoca_gravada = epoca;
+    gravacoes_epoca++;
+}
+
+// Envia ao grupo o que a réplica tiver vencido (entre cyw43_arch_lwip_begin/end)
+static void enviar_pendentes(void) {
+    uint8_t buf[REPLICA_TAMANHO_MAXIMO];
+    size_t n;
+    while ((n = replica_mensagem(&replica, agora_ms(), buf)) > 0) {
+        // Um datagrama perdido aqui é coberto pelas repetições e pelo resumo
+        struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)n, PBUF_RAM);
+        if (!p) {
+            trafego.falhas_envio++;
+            continue;
+        }
+        memcpy(p->payload, buf, n);
+        if (udp_sendto(pcb, p, &grupo, REPLICACAO_PORTA) == ERR_OK) {
+            trafego.bytes_enviados += n;
+        } else {
+            trafego.falhas_envio++;
+        }
+        pbuf_free(p);
+    }
+}
+
+// Entra no grupo multicast e abre a porta da replicação. estado() devolve a
+// palavra de estados atual e definir() aplica a que veio da rede.
+// Entra no grupo e abre a porta (entre cyw43_arch_lwip_begin/end)
+static bool abrir_porta(void) {
+    ipaddr_aton(REPLICACAO_GRUPO, &grupo);
+    if (igmp_joingroup(IP4_ADDR_ANY4, ip_2_ip4(&grupo)) != ERR_OK) {
+        printf("Falha ao entrar no grupo %s\n", REPLICACAO_GRUPO);
+        return false;
+    }
+    pcb = udp_new();
+    if (!pcb) {
+        printf("Falha ao criar PCB UDP\n");
+        return false;
+    }
+    if (udp_bind(pcb, IP_ADDR_ANY, REPLICACAO_PORTA) != ERR_OK) {
+        printf("Falha ao associar a replicação à porta %u\n", REPLICACAO_PORTA);
+        return false;
+    }
+    udp_recv(pcb, replicacao_recv, NULL);
+    return true;
+}
+
+// A pilha lwIP já está rodando (WiFi conectado, servidores abertos): as
+// chamadas a ela ficam entre cyw43_arch_lwip_begin/end
+bool replicacao_iniciar(const uint8_t chave[SIPHASH_TAMANHO_CHAVE], uint32_t (*estado)(void),
+                        void (*definir)(uint32_t palavra)) {
+    ler_estado = estado;
+    definir_estado = definir;
+    memset(&trafego, 0, sizeof(trafego));
+
+    // Id do nó: os 4 últimos bytes do MAC do WiFi (únicos entre as placas)
+    uint32_t id = get_rand_32();
+    cyw43_arch_lwip_begin();
+    if (netif_default) {
+        const uint8_t *mac = netif_default->hwaddr;
+        id = ((uint32_t)mac[2] << 24) | (mac[3] << 16) | (mac[4] << 8) | mac[5];
+    }
+    cyw43_arch_lwip_end();
+    // Época nova a cada boot: datagramas capturados antes ficam para trás
+    ler_epoca();
+    gravar_epoca(epoca_gravada + 1);
+    replica_iniciar(&replica, chave, id, epoca_gravada, estado(), agora_ms());
+
+    cyw43_arch_lwip_begin();
+    bool aberta = abrir_porta();
+    ativa = aberta;
+    cyw43_arch_lwip_end();
+    return aberta;
+}
+
+// Laço principal, antes de comparar a palavra exibida: publica as mudanças
+// locais e aplica as remotas
+void replicacao_sincronizar(void) {
+    if (!ativa) {
+        return;
+    }
+    cyw43_arch_lwip_begin();
+    uint32_t estado = ler_estado();
+    uint32_t palavra = replica_sincronizar(&replica, estado, agora_ms());
+    enviar_pendentes();
+    cyw43_arch_lwip_end();
+    if (palavra != estado) {
+        definir_estado(palavra);
+    }
+}
+
+// Tarefa periódica: repetições, reparos e o resumo. Grava a época quando o
+// HLC passa para uma mais nova (vinda de outra placa), para o próximo boot
+// começar além dela.
+void replicacao_rodada(void) {
+    if (!ativa) {
+        return;
+    }
+    cyw43_arch_lwip_begin();
+    enviar_pendentes();
+    uint32_t epoca = replica_epoca(&replica);
+    cyw43_arch_lwip_end();
+    if (epoca > epoca_gravada) {
+        gravar_epoca(epoca);
+    }
+}
+
+int replicacao_relatorio(char *buf, size_t tamanho) {
+    static const char *const nomes[REPLICA_DISPOSITIVOS] = {
+        "sala", "cozinha", "quarto", "banheiro", "quintal", "tv", "alarme",
+    };
+    int n = snprintf(buf, tamanho,
+                     "grupo=%s:%u no=%08lx hlc=%lu.%lu.%u valores=%02lx\n"
+                     "epoca_boot=%lu epoca_gravada=%lu gravacoes_epoca=%lu\n"
+                     "locais=%lu remotas=%lu deltas=%lu resumos=%lu entradas=%lu reparos=%lu suprimidos=%lu\n"
+                     "recebidos=%lu proprios=%lu antigos=%lu mac_invalido=%lu malformados=%lu grandes=%lu\n"
+                     "bytes_enviados=%lu bytes_recebidos=%lu falhas_envio=%lu\n",
+                     REPLICACAO_GRUPO, REPLICACAO_PORTA, (unsigned long)replica.id,
+                     (unsigned long)(replica.relogio >> 48), (unsigned long)((replica.relogio >> 16) & 0xFFFFFFFFu),
+                     (unsigned)(replica.relogio & 0xFFFF), (unsigned long)replica.valores,
+                     (unsigned long)replica.epoca, (unsigned long)epoca_gravada, (unsigned long)gravacoes_epoca, (unsigned long)replica.contadores.locais,
+                     (unsigned long)replica.contadores.remotas, (unsigned long)replica.contadores.deltas,
+                     (unsigned long)replica.contadores.resumos, (unsigned long)replica.contadores.entradas,
+                     (unsigned long)replica.contadores.reparos, (unsigned long)replica.contadores.suprimidos,
+                     (unsigned long)replica.contadores.recebidos, (unsigned long)replica.contadores.proprios,
+                     (unsigned long)replica.contadores.antigos,
+                     (unsigned long)replica.contadores.mac_invalido, (unsigned long)replica.contadores.malformados,
+                     (unsigned long)trafego.grandes, (unsigned long)trafego.bytes_enviados,
+                     (unsigned long)trafego.bytes_recebidos, (unsigned long)trafego.falhas_envio);
+    // Versão de cada dispositivo: época.ms.contador no relógio de quem
+    // escreveu, @no
+    for (int d = 0; d < REPLICA_DISPOSITIVOS && n >= 0 && (size_t)n < tamanho; d++) {
+        const versao_replica_t *v = &replica.versoes[d];
+        n += snprintf(buf + n, tamanho - n, "%s=%lu %lu.%lu.%u@%08lx\n", nomes[d],
+                      (unsigned long)((replica.valores >> d) & 1), (unsigned long)(v->hlc >> 48),
+                      (unsigned long)((v->hlc >> 16) & 0xFFFFFFFFu), (unsigned)(v->hlc & 0xFFFF),
+                      (unsigned long)v->no);
+    }
+    return n;
+}
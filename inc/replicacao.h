@@ -0,0 +1,22 @@
+#ifndef REPLICACAO_H
+#define REPLICACAO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "siphash.h"
+
+// Replicação dos estados entre as placas da casa por UDP multicast (a réplica
+// e o protocolo estão em inc/replica.h). Ligar uma luz ou armar o alarme em
+// qualquer placa chega às demais; a página de cada uma mostra a casa toda.
+// Os datagramas usam a mesma chave do controle UDP.
+#define REPLICACAO_PORTA 4211
+#define REPLICACAO_GRUPO "239.255.42.11"
+
+bool replicacao_iniciar(const uint8_t chave[SIPHASH_TAMANHO_CHAVE], uint32_t (*estado)(void),
+                        void (*definir)(uint32_t palavra));
+void replicacao_sincronizar(void);
+void replicacao_rodada(void);
+int replicacao_relatorio(char *buf, size_t tamanho);
+
+#endif
@@ -0,0 +1,665 @@
+#include <stdio.h>
+#include <string.h>
+#include "servidor_http.h"
+#include "pilha.h"
+#include "gravacao.h"
+#include "pico/stdlib.h"
+#include "lwip/pbuf.h"
+#include "lwip/apps/fs.h"
+
+// Estado de uma conexão HTTP
+typedef struct conexao_http {
+    const char *dados;   // Próximo trecho da resposta a entregar ao lwIP
+    uint32_t restante;   // Bytes que ainda não couberam no buffer de envio
+    bool copiar;         // Dados em RAM (copiados pelo lwIP) ou na flash
+    bool fechar;         // Fecha a conexão ao fim da resposta
+    char *buffer;        // Resposta gerada, liberada ao fim do envio
+    struct tcp_pcb *pcb;
+    const rota_binaria_t *fluxo;  // Rota contínua atendida pela conexão
+    uint32_t versao;              // Última versão entregue no fluxo
+    uint16_t numero;              // Identifica a conexão na gravação de entradas
+    char *requisicao;             // Bytes recebidos e ainda não atendidos (bloco do pool)
+    uint16_t recebidos;
+    bool excedeu;                 // Chegou mais do que cabe no bloco
+    bool atendendo;               // Dentro de atender(): evita a recursão pelo envio
+    bool aguardando;              // Comando enfileirado, esperando o laço aplicá-lo
+    uint32_t marca;               // Número do comando esperado
+    uint32_t chegada;             // Chegada do primeiro segmento da requisição atual
+    uint32_t ultimo_segmento;     // Chegada do segmento mais recente
+    uint8_t ociosos;              // Chamadas de tcp_poll sem progresso
+    struct conexao_http *proxima_espera;
+} conexao_http_t;
+
+// Memória do servidor HTTP: blocos fixos em vez do heap, uma classe por uso.
+// Conexões e respostas comportam todas as conexões; a requisição ocupa um
+// bloco só enquanto chega em partes ou espera a resposta anterior.
+POOL_DEFINIR(pool_conexoes, sizeof(conexao_http_t), HTTP_MAX_CONEXOES);
+POOL_DEFINIR(pool_requisicoes, TAMANHO_REQUISICAO, 4);
+POOL_DEFINIR(pool_cabecalhos, TAMANHO_CABECALHO, HTTP_MAX_CONEXOES);
+POOL_DEFINIR(pool_respostas, TAMANHO_RESPOSTA, HTTP_MAX_CONEXOES);
+
+pool_t *const pools_http[NUM_POOLS_HTTP] = {&pool_conexoes, &pool_requisicoes, &pool_cabecalhos, &pool_respostas};
+
+histograma_t latencia_http;
+uint32_t erros_envio_http = 0;
+
+static const servidor_http_config_t *config;
+static uint16_t conexoes_aceitas;
+static uint32_t parados;               // Conexões fechadas por falta de progresso
+
+// tcp_poll em unidades do timer lento do lwIP (500 ms)
+#define INTERVALO_POLL 4
+#define POLLS(segundos) ((segundos) * 2 / INTERVALO_POLL)
+
+// Profundidade de pilha do recebimento (contexto de IRQ do CYW43)
+static PILHA_PONTO(pilha_recv, "recv_http");
+
+// Conexões com resposta contínua, avisadas por servidor_http_notificar
+static conexao_http_t *fluxos[HTTP_MAX_FLUXOS];
+
+// Conexões esperando o laço aplicar o comando, respondidas por
+// servidor_http_confirmar
+static conexao_http_t *esperando;
+static uint32_t comandos_aceitos;
+
+static const char RESPOSTA_REDIRECIONAR[] = "HTTP/1.1 303 See Other\r\n"
+                                            "Location: /\r\n"
+                                            "Content-Length: 0\r\n"
+                                            "\r\n";
+static const char RESPOSTA_OCUPADO[] = "HTTP/1.1 503 Service Unavailable\r\n"
+                                       "Retry-After: 1\r\n"
+                                       "Content-Length: 0\r\n"
+                                       "\r\n";
+static const char RESPOSTA_NAO_ENCONTRADO[] = "HTTP/1.1 404 Not Found\r\n"
+                                              "Content-Length: 0\r\n"
+                                              "\r\n";
+static const char RESPOSTA_GRANDE[] = "HTTP/1.1 431 Request Header Fields Too Large\r\n"
+                                      "Content-Length: 0\r\n"
+                                      "Connection: close\r\n"
+                                      "\r\n";
+
+static err_t tcp_server_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
+static err_t tcp_server_sent(void *arg, struct tcp_pcb *tpcb, u16_t len);
+static err_t tcp_server_poll(void *arg, struct tcp_pcb *tpcb);
+static void tcp_server_err(void *arg, err_t err);
+
+// Busca uma sequência dentro de um bloco de tamanho limitado (sem terminador)
+static const char *buscar_memoria(const char *dados, size_t tamanho, const char *alvo) {
+    size_t tam_alvo = strlen(alvo);
+    for (size_t i = 0; i + tam_alvo <= tamanho; i++) {
+        if (dados[i] == alvo[0] && memcmp(dados + i, alvo, tam_alvo) == 0) {
+            return dados + i;
+        }
+    }
+    return NULL;
+}
+
+// Localiza o valor de um cabeçalho HTTP ("Nome: valor\r\n") dentro de um bloco
+static const char *valor_cabecalho(const char *dados, size_t tamanho, const char *nome, size_t *tam_valor) {
+    const char *linha = buscar_memoria(dados, tamanho, nome);
+    if (!linha) {
+        return NULL;
+    }
+    const char *valor = linha + strlen(nome);
+    const char *fim = buscar_memoria(valor, dados + tamanho - valor, "\r\n");
+    *tam_valor = fim ? (size_t)(fim - valor) : (size_t)(dados + tamanho - valor);
+    return valor;
+}
+
+// Copia o caminho da linha de requisição ("GET /caminho?x HTTP/1.1")
+static void extrair_caminho(const char *request, char *caminho, size_t tamanho) {
+    const char *inicio = strchr(request, ' ');
+    size_t n = 0;
+    if (inicio) {
+        inicio++;
+        while (inicio[n] && inicio[n] != ' ' && inicio[n] != '?' && n < tamanho - 1) {
+            n++;
+        }
+        memcpy(caminho, inicio, n);
+    }
+    caminho[n] = '\0';
+}
+
+// Copia o modelo substituindo as tags <!--#nome--> pelo valor atual
+static int expandir_ssi(const char *modelo, int tamanho_modelo, char *saida, int tamanho) {
+    int n = 0;
+    int i = 0;
+    while (i < tamanho_modelo && n < tamanho - 1) {
+        if (modelo[i] == '<' && tamanho_modelo - i > 5 && memcmp(modelo + i, "<!--#", 5) == 0) {
+            const char *nome = modelo + i + 5;
+            const char *fim = buscar_memoria(nome, modelo + tamanho_modelo - nome, "-->");
+            int indice = -1;
+            for (int k = 0; fim && k < (int)config->num_tags_ssi; k++) {
+                if ((size_t)(fim - nome) == strlen(config->tags_ssi[k]) && memcmp(nome, config->tags_ssi[k], fim - nome) == 0) {
+                    indice = k;
+                    break;
+                }
+            }
+            if (indice >= 0) {
+                n += config->ssi(indice, saida + n, tamanho - n);
+                i = (fim + 3) - modelo;
+                continue;
+            }
+        }
+        saida[n++] = modelo[i++];
+    }
+    return n;
+}
+
+// Obtém o buffer da resposta gerada no pool indicado
+static bool alocar_buffer(conexao_http_t *con, pool_t *pool) {
+    con->buffer = (char *)pool_alocar(pool);
+    return con->buffer != NULL;
+}
+
+// Devolve o buffer da resposta ao pool de onde veio
+static void liberar_buffer(conexao_http_t *con) {
+    if (pool_contem(&pool_respostas, con->buffer)) {
+        pool_liberar(&pool_respostas, con->buffer);
+    } else {
+        pool_liberar(&pool_cabecalhos, con->buffer);
+    }
+    con->buffer = NULL;
+}
+
+static void liberar_requisicao(conexao_http_t *con) {
+    pool_liberar(&pool_requisicoes, con->requisicao);
+    con->requisicao = NULL;
+    con->recebidos = 0;
+}
+
+// Devolve o estado da conexão aos pools
+static void liberar_conexao(conexao_http_t *con) {
+    for (int i = 0; i < HTTP_MAX_FLUXOS; i++) {
+        if (fluxos[i] == con) {
+            fluxos[i] = NULL;
+        }
+    }
+    for (conexao_http_t **c = &esperando; *c; c = &(*c)->proxima_espera) {
+        if (*c == con) {
+            *c = con->proxima_espera;
+            break;
+        }
+    }
+    liberar_buffer(con);
+    liberar_requisicao(con);
+    pool_liberar(&pool_conexoes, con);
+}
+
+// Libera o estado e fecha a conexão. Retorna ERR_ABRT se foi preciso abortar.
+static err_t fechar_conexao(struct tcp_pcb *tpcb, conexao_http_t *con) {
+    tcp_arg(tpcb, NULL);
+    tcp_recv(tpcb, NULL);
+    tcp_sent(tpcb, NULL);
+    tcp_err(tpcb, NULL);
+    tcp_poll(tpcb, NULL, 0);
+    if (con) {
+        liberar_conexao(con);
+    }
+    if (tcp_close(tpcb) != ERR_OK) {
+        tcp_abort(tpcb);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
+}
+
+static err_t continuar_fluxo(struct tcp_pcb *tpcb, conexao_http_t *con);
+static err_t atender(struct tcp_pcb *tpcb, conexao_http_t *con);
+
+// Entrega ao lwIP o quanto couber da resposta pendente; o restante segue nos
+// callbacks tcp_sent/tcp_poll
+static err_t enviar_pendente(struct tcp_pcb *tpcb, conexao_http_t *con) {
+    while (con->restante > 0) {
+        u16_t espaco = tcp_sndbuf(tpcb);
+        if (espaco == 0 || tcp_sndqueuelen(tpcb) >= TCP_SND_QUEUELEN) {
+            break;
+        }
+        u16_t n = con->restante < espaco ? con->restante : espaco;
+        u8_t flags = con->copiar ? TCP_WRITE_FLAG_COPY : 0;
+        if (n < con->restante) {
+            flags |= TCP_WRITE_FLAG_MORE;
+        }
+        if (tcp_write(tpcb, con->dados, n, flags) != ERR_OK) {
+            erros_envio_http++;
+            break;
+        }
+        con->dados += n;
+        con->restante -= n;
+    }
+    tcp_output(tpcb);
+
+    if (con->restante == 0) {
+        if (con->fluxo) {
+            return continuar_fluxo(tpcb, con);
+        }
+        liberar_buffer(con);
+        if (con->fechar) {
+            return fechar_conexao(tpcb, con);
+        }
+        // Requisição que chegou durante a resposta
+        return atender(tpcb, con);
+    }
+    return ERR_OK;
+}
+
+static err_t iniciar_resposta(struct tcp_pcb *tpcb, conexao_http_t *con, const char *dados, uint32_t tamanho, bool copiar) {
+    con->dados = dados;
+    con->restante = tamanho;
+    con->copiar = copiar;
+    return enviar_pendente(tpcb, con);
+}
+
+// Gera o próximo trecho de um fluxo no bloco retido pela conexão. Os dados
+// são copiados pelo lwIP, então o bloco pode ser reescrito logo em seguida.
+static err_t continuar_fluxo(struct tcp_pcb *tpcb, conexao_http_t *con) {
+    int n = con->fluxo->gerar(&con->versao, con->buffer, TAMANHO_RESPOSTA);
+    if (n <= 0) {
+        return ERR_OK;
+    }
+    return iniciar_resposta(tpcb, con, con->buffer, n, true);
+}
+
+// Abre uma resposta contínua: cabeçalho sem Content-Length (o corpo termina
+// quando a conexão fecha) seguido do estado atual
+static err_t iniciar_fluxo(struct tcp_pcb *tpcb, conexao_http_t *con, const rota_binaria_t *rota) {
+    int livre = -1;
+    for (int i = 0; i < HTTP_MAX_FLUXOS; i++) {
+        if (!fluxos[i]) {
+            livre = i;
+            break;
+        }
+    }
+    if (livre < 0 || !alocar_buffer(con, &pool_respostas)) {
+        return iniciar_resposta(tpcb, con, RESPOSTA_OCUPADO, sizeof(RESPOSTA_OCUPADO) - 1, false);
+    }
+    fluxos[livre] = con;
+    con->pcb = tpcb;
+    con->fluxo = rota;
+    con->versao = 0;
+    con->fechar = false;
+    int n = snprintf(con->buffer, TAMANHO_RESPOSTA,
+                     "HTTP/1.1 200 OK\r\n"
+                     "Content-Type: %s\r\n"
+                     "Cache-Control: no-store\r\n"
+                     "Connection: close\r\n"
+                     "\r\n",
+                     rota->tipo);
+    return iniciar_resposta(tpcb, con, con->buffer, n, true);
+}
+
+// Escreve o cabeçalho logo antes do corpo já gerado em con->buffer e envia
+static err_t enviar_gerado(struct tcp_pcb *tpcb, conexao_http_t *con, const char *tipo, int tamanho_corpo) {
+    char cabecalho[RESERVA_CABECALHO];
+    int n = snprintf(cabecalho, sizeof(cabecalho),
+                     "HTTP/1.1 200 OK\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Length: %d\r\n"
+                     "Cache-Control: no-store\r\n"
+                     "\r\n",
+                     tipo, tamanho_corpo);
+    char *inicio = con->buffer + RESERVA_CABECALHO - n;
+    memcpy(inicio, cabecalho, n);
+    return iniciar_resposta(tpcb, con, inicio, n + tamanho_corpo, true);
+}
+
+// 304 quando o If-None-Match do cliente é o ETag gravado no cabeçalho do arquivo
+static bool etag_confere(const char *request, const struct fs_file *arquivo, char *procurado, size_t tamanho) {
+    const char *fim_cabecalho = buscar_memoria(arquivo->data, arquivo->len, "\r\n\r\n");
+    if (!fim_cabecalho) {
+        return false;
+    }
+    size_t tam_etag, tam_cliente;
+    const char *etag = valor_cabecalho(arquivo->data, fim_cabecalho + 2 - arquivo->data, "ETag: ", &tam_etag);
+    const char *cliente = valor_cabecalho(request, strlen(request), "If-None-Match: ", &tam_cliente);
+    if (!etag || !cliente) {
+        return false;
+    }
+    // O cliente pode enviar uma lista de ETags; basta conter o atual
+    if (tam_etag >= tamanho) {
+        return false;
+    }
+    memcpy(procurado, etag, tam_etag);
+    procurado[tam_etag] = '\0';
+    return buscar_memoria(cliente, tam_cliente, procurado) != NULL;
+}
+
+// Monta a resposta para uma requisição completa
+static err_t responder(struct tcp_pcb *tpcb, conexao_http_t *con, char *request) {
+    // Respostas geradas (texto, SSI) ocupam um bloco de resposta; sem bloco
+    // livre o cliente recebe 503 e tenta de novo
+    const int espaco = TAMANHO_RESPOSTA - RESERVA_CABECALHO;
+
+    // Rotas de diagnóstico respondem em texto simples
+    for (size_t i = 0; i < config->num_rotas_texto; i++) {
+        if (strstr(request, config->rotas_texto[i].caminho) != NULL) {
+            if (!alocar_buffer(con, &pool_respostas)) {
+                return iniciar_resposta(tpcb, con, RESPOSTA_OCUPADO, sizeof(RESPOSTA_OCUPADO) - 1, false);
+            }
+            int n = config->rotas_texto[i].gerar(con->buffer + RESERVA_CABECALHO, espaco);
+            if (n < 0) {
+                n = 0;
+            }
+            return enviar_gerado(tpcb, con, "text/plain", n < espaco ? n : espaco - 1);
+        }
+    }
+
+    // Comandos são enfileirados e o navegador é redirecionado para a página
+    // só depois de o laço principal aplicá-los (servidor_http_confirmar):
+    // a página recarregada já mostra o estado novo
+    switch (config->comando(&request)) {
+    case REQUISICAO_FILA_CHEIA:
+        return iniciar_resposta(tpcb, con, RESPOSTA_OCUPADO, sizeof(RESPOSTA_OCUPADO) - 1, false);
+    case REQUISICAO_ENFILEIRADA:
+        con->aguardando = true;
+        con->marca = ++comandos_aceitos;
+        con->pcb = tpcb;
+        con->proxima_espera = esperando;
+        esperando = con;
+        return ERR_OK;
+    case REQUISICAO_SEM_COMANDO:
+        break;
+    }
+
+    char caminho[64];
+    extrair_caminho(request, caminho, sizeof(caminho));
+
+    // Rotas binárias: resposta única com Content-Length ou fluxo contínuo
+    for (size_t i = 0; i < config->num_rotas_binarias; i++) {
+        const rota_binaria_t *rota = &config->rotas_binarias[i];
+        if (strcmp(caminho, rota->caminho) != 0) {
+            continue;
+        }
+        if (rota->continua) {
+            return iniciar_fluxo(tpcb, con, rota);
+        }
+        if (!alocar_buffer(con, &pool_respostas)) {
+            return iniciar_resposta(tpcb, con, RESPOSTA_OCUPADO, sizeof(RESPOSTA_OCUPADO) - 1, false);
+        }
+        uint32_t versao = 0;
+        int n = rota->gerar(&versao, con->buffer + RESERVA_CABECALHO, espaco);
+        return enviar_gerado(tpcb, con, rota->tipo, n > 0 ? n : 0);
+    }
+
+    // Demais caminhos vêm da imagem fsdata gravada na flash
+    if (strcmp(caminho, "/") == 0) {
+        strcpy(caminho, "/index.shtml");
+    }
+    struct fs_file arquivo;
+    if (fs_open(&arquivo, caminho) != ERR_OK) {
+        return iniciar_resposta(tpcb, con, RESPOSTA_NAO_ENCONTRADO, sizeof(RESPOSTA_NAO_ENCONTRADO) - 1, false);
+    }
+    fs_close(&arquivo);
+
+    // Página com campos ao vivo: apenas as tags SSI mudam a cada requisição
+    if (arquivo.flags & FS_FILE_FLAGS_SSI) {
+        if (!alocar_buffer(con, &pool_respostas)) {
+            return iniciar_resposta(tpcb, con, RESPOSTA_OCUPADO, sizeof(RESPOSTA_OCUPADO) - 1, false);
+        }
+        int n = expandir_ssi(arquivo.data, arquivo.len, con->buffer + RESERVA_CABECALHO, espaco);
+        return enviar_gerado(tpcb, con, "text/html; charset=utf-8", n);
+    }
+
+    // Revalidação com o mesmo ETag: 304 montado num bloco pequeno
+    char etag[48];
+    if (etag_confere(request, &arquivo, etag, sizeof(etag)) && alocar_buffer(con, &pool_cabecalhos)) {
+        int n = snprintf(con->buffer, TAMANHO_CABECALHO,
+                         "HTTP/1.1 304 Not Modified\r\n"
+                         "ETag: %s\r\n"
+                         "\r\n",
+                         etag);
+        return iniciar_resposta(tpcb, con, con->buffer, n, true);
+    }
+
+    // Arquivo estático comprimido, com cabeçalho incluso: enviado direto da flash
+    return iniciar_resposta(tpcb, con, arquivo.data, arquivo.len, false);
+}
+
+// Trata os dados recebidos numa conexão (requisições HTTP)
+static err_t receber_requisicao(void *arg, struct tcp_pcb *tpcb, struct pbuf *p) {
+    conexao_http_t *con = (conexao_http_t *)arg;
+    if (!p) {
+        if (con) {
+            gravacao_tcp_fechar(con->numero);
+        }
+        return fechar_conexao(tpcb, con);
+    }
+
+    uint32_t agora = time_us_32();
+    con->ociosos = 0;
+    tcp_recved(tpcb, p->tot_len);
+    gravacao_tcp_dados(con->numero, p);
+
+    // Numa conexão de fluxo o cliente não envia mais requisições
+    if (con->fluxo) {
+        pbuf_free(p);
+        return ERR_OK;
+    }
+
+    // Acumula no bloco da conexão até o fim dos cabeçalhos; o que chega antes
+    // do fim da resposta anterior (pipelining) espera nele
+    if (!con->requisicao) {
+        con->requisicao = (char *)pool_alocar(&pool_requisicoes);
+        if (!con->requisicao) {
+            // Os bytes perdidos desalinham a conexão: responde e fecha
+            pbuf_free(p);
+            if (con->restante > 0 || con->aguardando) {
+                return fechar_conexao(tpcb, con);
+            }
+            con->fechar = true;
+            return iniciar_resposta(tpcb, con, RESPOSTA_OCUPADO, sizeof(RESPOSTA_OCUPADO) - 1, false);
+        }
+        con->recebidos = 0;
+        con->excedeu = false;
+        con->chegada = agora;
+    }
+    con->ultimo_segmento = agora;
+    u16_t livre = TAMANHO_REQUISICAO - 1 - con->recebidos;
+    u16_t tamanho = p->tot_len < livre ? p->tot_len : livre;
+    pbuf_copy_partial(p, con->requisicao + con->recebidos, tamanho, 0);
+    con->recebidos += tamanho;
+    con->excedeu |= tamanho < p->tot_len;
+    pbuf_free(p);
+    return atender(tpcb, con);
+}
+
+// Responde às requisições completas do bloco da conexão, uma de cada vez: a
+// seguinte só depois de a anterior sair inteira e do seu comando ser aplicado
+static err_t atender(struct tcp_pcb *tpcb, conexao_http_t *con) {
+    if (con->atendendo) {
+        return ERR_OK;
+    }
+    con->atendendo = true;
+    while (con->requisicao && con->restante == 0 && !con->aguardando && !con->fluxo) {
+        char *request = con->requisicao;
+        const char *fim = buscar_memoria(request, con->recebidos, "\r\n\r\n");
+        if (!fim) {
+            if (!con->excedeu) {
+                break;           // O resto chega no próximo segmento
+            }
+            liberar_requisicao(con);
+            con->fechar = true;
+            con->atendendo = false;
+            histograma_registrar(&latencia_http, time_us_32() - con->chegada);
+            return iniciar_resposta(tpcb, con, RESPOSTA_GRANDE, sizeof(RESPOSTA_GRANDE) - 1, false);
+        }
+        uint16_t tamanho = fim + 4 - request;
+        char seguinte = request[tamanho];
+        request[tamanho] = '\0';
+
+        // Conexão persistente (HTTP/1.1), a não ser que o cliente peça para
+        // fechar ou que o que veio depois desta requisição não tenha cabido
+        con->fechar = strstr(request, "Connection: close") != NULL || strstr(request, "HTTP/1.0") != NULL ||
+                      con->excedeu;
+        bool fechar = con->fechar;
+
+        // Um comando fica em espera e é medido em servidor_http_confirmar.
+        // Os blocos do pool são estáticos: comparar con depois de liberado
+        // não toca em memória inválida.
+        uint32_t chegada = con->chegada;
+        err_t resultado = responder(tpcb, con, request);
+        if (esperando != con) {
+            histograma_registrar(&latencia_http, time_us_32() - chegada);
+        }
+        if (fechar || resultado != ERR_OK) {
+            // A conexão pode já ter sido liberada
+            return resultado;
+        }
+
+        request[tamanho] = seguinte;
+        con->recebidos -= tamanho;
+        memmove(request, request + tamanho, con->recebidos);
+        if (con->recebidos == 0 || con->fluxo) {
+            liberar_requisicao(con);
+        } else {
+            // A seguinte veio junto: conta a partir do segmento mais recente
+            con->chegada = con->ultimo_segmento;
+        }
+    }
+    con->atendendo = false;
+    return ERR_OK;
+}
+
+// Callback para recebimento de dados TCP. Roda no contexto de IRQ do CYW43:
+// não lê sensores nem altera estados diretamente.
+static err_t tcp_server_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
+    pilha_entrar(&pilha_recv);
+    err_t resultado = receber_requisicao(arg, tpcb, p);
+    pilha_sair(&pilha_recv);
+    return resultado;
+}
+
+// Continua o envio quando o lwIP libera espaço no buffer de envio
+static err_t tcp_server_sent(void *arg, struct tcp_pcb *tpcb, u16_t len) {
+    conexao_http_t *con = (conexao_http_t *)arg;
+    if (!con) {
+        return ERR_OK;
+    }
+    con->ociosos = 0;
+    return enviar_pendente(tpcb, con);
+}
+
+// Chamado a cada INTERVALO_POLL * 500 ms: nova tentativa caso um tcp_write
+// tenha falhado sem dados em voo, e fechamento das conexões paradas. Quem
+// espera o laço principal ou recebe um fluxo não conta como parado.
+static err_t tcp_server_poll(void *arg, struct tcp_pcb *tpcb) {
+    conexao_http_t *con = (conexao_http_t *)arg;
+    if (!con) {
+        return ERR_OK;
+    }
+    if (!con->aguardando && !con->fluxo) {
+        bool parcial = con->requisicao && con->restante == 0;
+        uint8_t limite = POLLS(parcial ? HTTP_PARCIAL_S : HTTP_OCIOSA_S);
+        if (++con->ociosos >= limite) {
+            parados++;
+            gravacao_tcp_fechar(con->numero);
+            return fechar_conexao(tpcb, con);
+        }
+    }
+    return enviar_pendente(tpcb, con);
+}
+
+// A conexão já foi liberada pelo lwIP; resta liberar o estado
+static void tcp_server_err(void *arg, err_t err) {
+    conexao_http_t *con = (conexao_http_t *)arg;
+    if (con) {
+        gravacao_tcp_fechar(con->numero);
+        liberar_conexao(con);
+    }
+}
+
+// Callback para aceitar novas conexões TCP
+static err_t tcp_server_accept(void *arg, struct tcp_pcb *newpcb, err_t err) {
+    if (err != ERR_OK || newpcb == NULL) {
+        return ERR_VAL;
+    }
+    // Sem bloco de conexão livre a PCB é recusada (o lwIP a aborta)
+    conexao_http_t *con = (conexao_http_t *)pool_alocar(&pool_conexoes);
+    if (!con) {
+        return ERR_MEM;
+    }
+    memset(con, 0, sizeof(conexao_http_t));
+    con->numero = ++conexoes_aceitas;
+    gravacao_tcp_abrir(con->numero);
+    tcp_arg(newpcb, con);
+    tcp_recv(newpcb, tcp_server_recv);
+    tcp_sent(newpcb, tcp_server_sent);
+    tcp_err(newpcb, tcp_server_err);
+    tcp_poll(newpcb, tcp_server_poll, INTERVALO_POLL);
+    return ERR_OK;
+}
+
+// Prepara os pools e coloca o servidor em escuta na porta indicada
+bool servidor_http_iniciar(const servidor_http_config_t *configuracao, u16_t porta) {
+    config = configuracao;
+    histograma_limpar(&latencia_http);
+    for (size_t i = 0; i < NUM_POOLS_HTTP; i++) {
+        pool_init(pools_http[i]);
+    }
+
+    struct tcp_pcb *server = tcp_new();
+    if (!server) {
+        printf("Falha ao criar servidor TCP\n");
+        return false;
+    }
+
+    // Associa o servidor à porta
+    if (tcp_bind(server, IP_ADDR_ANY, porta) != ERR_OK) {
+        printf("Falha ao associar servidor TCP à porta %u\n", porta);
+        return false;
+    }
+
+    // Coloca o servidor em modo de escuta
+    server = tcp_listen(server);
+    tcp_accept(server, tcp_server_accept);
+    return true;
+}
+
+// Avisa os fluxos abertos que há dados novos. Chamar no contexto lwIP (ou
+// entre cyw43_arch_lwip_begin/end); fluxos ainda enviando o trecho anterior
+// continuam pelo tcp_sent.
+void servidor_http_notificar(void) {
+    for (int i = 0; i < HTTP_MAX_FLUXOS; i++) {
+        conexao_http_t *con = fluxos[i];
+        if (con && con->restante == 0) {
+            continuar_fluxo(con->pcb, con);
+        }
+    }
+}
+
+// Número do último comando aceito. O laço principal guarda a marca antes de
+// retirar os comandos e, depois de aplicá-los, confirma até ela.
+uint32_t servidor_http_marca(void) {
+    return comandos_aceitos;
+}
+
+// Redireciona as conexões cujos comandos, até a marca, já foram aplicados.
+// Chamar no contexto lwIP (ou entre cyw43_arch_lwip_begin/end).
+void servidor_http_confirmar(uint32_t marca) {
+    conexao_http_t **c = &esperando;
+    while (*c) {
+        conexao_http_t *con = *c;
+        if ((int32_t)(marca - con->marca) < 0) {
+            c = &con->proxima_espera;
+            continue;
+        }
+        *c = con->proxima_espera;
+        con->aguardando = false;
+        con->ociosos = 0;
+        histograma_registrar(&latencia_http, time_us_32() - con->chegada);
+        iniciar_resposta(con->pcb, con, RESPOSTA_REDIRECIONAR, sizeof(RESPOSTA_REDIRECIONAR) - 1, false);
+    }
+}
+
+// Uso dos pools de memória e falhas de envio do servidor HTTP
+int servidor_http_memoria(char *buf, size_t tamanho) {
+    int n = pool_relatorio(pools_http, NUM_POOLS_HTTP, buf, tamanho);
+    if (n < 0 || (size_t)n >= tamanho) {
+        return n;
+    }
+    n += snprintf(buf + n, tamanho - n, "erros_envio=%lu\n", (unsigned long)erros_envio_http);
+    if ((size_t)n >= tamanho) {
+        return n;
+    }
+    n += snprintf(buf + n, tamanho - n, "conexoes_paradas=%lu\n", (unsigned long)parados);
+    return n;
+}
@@ -0,0 +1,82 @@
+#ifndef SERVIDOR_HTTP_H
+#define SERVIDOR_HTTP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lwip/tcp.h"
+#include "histograma.h"
+#include "pool.h"
+
+// Limites do servidor HTTP
+#define TAMANHO_REQUISICAO 1024    // Bytes da requisição considerados (linha e cabeçalhos)
+#define TAMANHO_RESPOSTA 2048      // Buffer das respostas geradas (SSI, texto, 304)
+#define RESERVA_CABECALHO 160      // Início do buffer reservado ao cabeçalho
+#define TAMANHO_CABECALHO 128      // Respostas curtas montadas na hora (304)
+
+// Conexões simultâneas atendidas; por padrão, uma por PCB TCP do lwIP
+#ifndef HTTP_MAX_CONEXOES
+#define HTTP_MAX_CONEXOES MEMP_NUM_TCP_PCB
+#endif
+
+// Respostas contínuas abertas ao mesmo tempo (cada uma retém um bloco de resposta)
+#define HTTP_MAX_FLUXOS 2
+
+// Conexões sem progresso são fechadas: uma requisição incompleta retém um
+// bloco do pool, e uma conexão persistente parada retém um PCB
+#define HTTP_PARCIAL_S 6           // Requisição incompleta sem bytes novos
+#define HTTP_OCIOSA_S 16           // Sem requisição, ou resposta que o cliente não lê
+
+// Resultado do tratamento de uma requisição de comando
+typedef enum {
+    REQUISICAO_SEM_COMANDO,
+    REQUISICAO_ENFILEIRADA,
+    REQUISICAO_FILA_CHEIA,
+} resultado_requisicao_t;
+
+// Rota de diagnóstico respondida em texto simples
+typedef struct {
+    const char *caminho;
+    int (*gerar)(char *buf, size_t tamanho);
+} rota_texto_t;
+
+// Rota binária, comparada com o caminho exato. gerar escreve os dados que
+// levam o cliente de *versao ao estado atual (0 = nada novo). Numa rota
+// contínua a resposta não tem tamanho definido: a conexão fica aberta e gerar
+// é chamado de novo a cada servidor_http_notificar().
+typedef struct {
+    const char *caminho;
+    const char *tipo;        // Content-Type
+    int (*gerar)(uint32_t *versao, char *buf, size_t tamanho);
+    bool continua;
+} rota_binaria_t;
+
+// Partes do servidor que dependem da aplicação. O servidor não conhece os
+// dispositivos: comandos e tags SSI são repassados a estes callbacks, que
+// rodam no contexto lwIP.
+typedef struct {
+    const rota_texto_t *rotas_texto;
+    size_t num_rotas_texto;
+    resultado_requisicao_t (*comando)(char **request);
+    u16_t (*ssi)(int indice, char *destino, int tamanho);  // Mesma assinatura de tSSIHandler
+    const char *const *tags_ssi;                            // Nomes na ordem dos índices
+    size_t num_tags_ssi;
+    const rota_binaria_t *rotas_binarias;
+    size_t num_rotas_binarias;
+} servidor_http_config_t;
+
+#define NUM_POOLS_HTTP 4
+
+extern pool_t *const pools_http[NUM_POOLS_HTTP];
+// Do primeiro segmento da requisição até a resposta começar a ser entregue ao
+// lwIP; num comando, até o laço principal aplicá-lo (servidor_http_confirmar)
+extern histograma_t latencia_http;
+extern uint32_t erros_envio_http;       // tcp_write recusado (ERR_MEM), reenviado depois
+
+bool servidor_http_iniciar(const servidor_http_config_t *config, u16_t porta);
+int servidor_http_memoria(char *buf, size_t tamanho);
+void servidor_http_notificar(void);
+uint32_t servidor_http_marca(void);
+void servidor_http_confirmar(uint32_t marca);
+
+#endif
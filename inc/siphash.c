@@ -0,0 +1,54 @@
+#include "siphash.h"
+
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+static uint64_t ler64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+#define SIPROUND()                                                 \
+    do {                                                           \
+        v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+        v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2;                     \
+        v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0;                     \
+        v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+    } while (0)
+
+uint64_t siphash24(const uint8_t chave[SIPHASH_TAMANHO_CHAVE], const uint8_t *dados, size_t tamanho) {
+    uint64_t k0 = ler64(chave);
+    uint64_t k1 = ler64(chave + 8);
+    uint64_t v0 = 0x736f6d6570736575ull ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dull ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ull ^ k0;
+    uint64_t v3 = 0x7465646279746573ull ^ k1;
+
+    size_t completos = tamanho & ~(size_t)7;
+    for (size_t i = 0; i < completos; i += 8) {
+        uint64_t m = ler64(dados + i);
+        v3 ^= m;
+        SIPROUND();
+        SIPROUND();
+        v0 ^= m;
+    }
+
+    // Último bloco: bytes restantes e o tamanho no byte mais significativo
+    uint64_t b = (uint64_t)tamanho << 56;
+    for (size_t i = 0; i < (tamanho & 7); i++) {
+        b |= (uint64_t)dados[completos + i] << (8 * i);
+    }
+    v3 ^= b;
+    SIPROUND();
+    SIPROUND();
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    SIPROUND();
+    SIPROUND();
+    SIPROUND();
+    SIPROUND();
+    return v0 ^ v1 ^ v2 ^ v3;
+}
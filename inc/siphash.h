@@ -0,0 +1,13 @@
+#ifndef SIPHASH_H
+#define SIPHASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// SipHash-2-4: MAC de 64 bits com chave de 128 bits, usado para autenticar
+// os datagramas do controle UDP. Só aritmética de 32/64 bits, sem tabelas.
+#define SIPHASH_TAMANHO_CHAVE 16
+
+uint64_t siphash24(const uint8_t chave[SIPHASH_TAMANHO_CHAVE], const uint8_t *dados, size_t tamanho);
+
+#endif
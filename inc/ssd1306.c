@@ -1,71 +1,106 @@
+#include <stdio.h>
+#include <string.h>
 #include "ssd1306.h"
 #include "font.h"
 
-void ssd1306_init(ssd1306_t *ssd, uint8_t width, uint8_t height, bool external_vcc, uint8_t address, i2c_inst_t *i2c) {
+// Byte de controle: Co=1 (só o próximo byte) ou Co=0 (o resto da transação),
+// D/C# escolhe comando ou dados
+#define CONTROL_COMMAND 0x80
+#define CONTROL_COMMAND_STREAM 0x00
+#define CONTROL_DATA_STREAM 0x40
+
+// Enfileira no barramento; com a fila cheia, espera uma vaga
+static void ssd1306_submit(transacao_i2c_t *t) {
+  while (!barramento_i2c_enfileirar(t)) {
+    barramento_i2c_vigiar();
+    tight_loop_contents();
+  }
+}
+
+// Falha com um painel maior que o quadro fixo ou sem memória para o buffer
+bool ssd1306_init(ssd1306_t *ssd, uint8_t width, uint8_t height, bool external_vcc, uint8_t address, i2c_inst_t *i2c) {
   ssd->width = width;
   ssd->height = height;
   ssd->pages = height / 8U;
   ssd->address = address;
   ssd->i2c_port = i2c;
   ssd->bufsize = ssd->pages * ssd->width + 1;
+  if (ssd->bufsize > SSD1306_MAX_BUFSIZE) {
+    printf("Display %ux%u maior que o quadro de %ux%u\n", width, height, WIDTH, HEIGHT);
+    return false;
+  }
   ssd->ram_buffer = calloc(ssd->bufsize, sizeof(uint8_t));
-  ssd->ram_buffer[0] = 0x40;
-  ssd->port_buffer[0] = 0x80;
+  if (!ssd->ram_buffer) {
+    printf("Sem memória para o buffer do display\n");
+    return false;
+  }
+  ssd->ram_buffer[0] = CONTROL_DATA_STREAM;
+
+  // Quadro numa só transação: a janela (colunas e páginas inteiras, cada
+  // comando com o seu byte de controle) seguida do fluxo de dados
+  const uint8_t window[] = {SET_COL_ADDR, 0, width - 1, SET_PAGE_ADDR, 0, ssd->pages - 1};
+  for (size_t i = 0; i < sizeof(window); ++i) {
+    ssd->frame_buffer[2 * i] = CONTROL_COMMAND;
+    ssd->frame_buffer[2 * i + 1] = window[i];
+  }
+  memset(&ssd->frame_transfer, 0, sizeof(ssd->frame_transfer));
+  ssd->frame_transfer.endereco = address;
+  ssd->frame_transfer.escrita = ssd->frame_buffer;
+  ssd->frame_transfer.tamanho = SSD1306_WINDOW_SIZE + ssd->bufsize;
+  memset(&ssd->command_transfer, 0, sizeof(ssd->command_transfer));
+  ssd->command_transfer.endereco = address;
+  ssd->command_transfer.escrita = ssd->command_buffer;
+  return true;
 }
 
 void ssd1306_config(ssd1306_t *ssd) {
-  ssd1306_command(ssd, SET_DISP | 0x00);
-  ssd1306_command(ssd, SET_MEM_ADDR);
-  ssd1306_command(ssd, 0x01);
-  ssd1306_command(ssd, SET_DISP_START_LINE | 0x00);
-  ssd1306_command(ssd, SET_SEG_REMAP | 0x01);
-  ssd1306_command(ssd, SET_MUX_RATIO);
-  ssd1306_command(ssd, HEIGHT - 1);
-  ssd1306_command(ssd, SET_COM_OUT_DIR | 0x08);
-  ssd1306_command(ssd, SET_DISP_OFFSET);
-  ssd1306_command(ssd, 0x00);
-  ssd1306_command(ssd, SET_COM_PIN_CFG);
-  ssd1306_command(ssd, 0x12);
-  ssd1306_command(ssd, SET_DISP_CLK_DIV);
-  ssd1306_command(ssd, 0x80);
-  ssd1306_command(ssd, SET_PRECHARGE);
-  ssd1306_command(ssd, 0xF1);
-  ssd1306_command(ssd, SET_VCOM_DESEL);
-  ssd1306_command(ssd, 0x30);
-  ssd1306_command(ssd, SET_CONTRAST);
-  ssd1306_command(ssd, 0xFF);
-  ssd1306_command(ssd, SET_ENTIRE_ON);
-  ssd1306_command(ssd, SET_NORM_INV);
-  ssd1306_command(ssd, SET_CHARGE_PUMP);
-  ssd1306_command(ssd, 0x14);
-  ssd1306_command(ssd, SET_DISP | 0x01);
+  const uint8_t commands[] = {
+    SET_DISP | 0x00,
+    SET_MEM_ADDR, 0x01,
+    SET_DISP_START_LINE | 0x00,
+    SET_SEG_REMAP | 0x01,
+    SET_MUX_RATIO, HEIGHT - 1,
+    SET_COM_OUT_DIR | 0x08,
+    SET_DISP_OFFSET, 0x00,
+    SET_COM_PIN_CFG, 0x12,
+    SET_DISP_CLK_DIV, 0x80,
+    SET_PRECHARGE, 0xF1,
+    SET_VCOM_DESEL, 0x30,
+    SET_CONTRAST, 0xFF,
+    SET_ENTIRE_ON,
+    SET_NORM_INV,
+    SET_CHARGE_PUMP, 0x14,
+    SET_DISP | 0x01,
+  };
+  ssd1306_command_list(ssd, commands, sizeof(commands));
 }
 
 void ssd1306_command(ssd1306_t *ssd, uint8_t command) {
-  ssd->port_buffer[1] = command;
-  i2c_write_blocking(
-    ssd->i2c_port,
-    ssd->address,
-    ssd->port_buffer,
-    2,
-    false
-  );
+  ssd1306_command_list(ssd, &command, 1);
+}
+
+// Envia os comandos numa só transação (byte de controle 0x00: todos os
+// bytes seguintes são comandos). Só espera a lista anterior, cujo buffer
+// é reaproveitado.
+void ssd1306_command_list(ssd1306_t *ssd, const uint8_t *commands, size_t count) {
+  while (count > 0) {
+    size_t n = count < SSD1306_MAX_COMMANDS ? count : SSD1306_MAX_COMMANDS;
+    barramento_i2c_esperar(&ssd->command_transfer);
+    ssd->command_buffer[0] = CONTROL_COMMAND_STREAM;
+    memcpy(ssd->command_buffer + 1, commands, n);
+    ssd->command_transfer.tamanho = 1 + n;
+    ssd1306_submit(&ssd->command_transfer);
+    commands += n;
+    count -= n;
+  }
 }
 
+// Copia o quadro e o envia em segundo plano. Se o anterior ainda estiver
+// no barramento, espera por ele (~24 ms a 400 kHz).
 void ssd1306_send_data(ssd1306_t *ssd) {
-  ssd1306_command(ssd, SET_COL_ADDR);
-  ssd1306_command(ssd, 0);
-  ssd1306_command(ssd, ssd->width - 1);
-  ssd1306_command(ssd, SET_PAGE_ADDR);
-  ssd1306_command(ssd, 0);
-  ssd1306_command(ssd, ssd->pages - 1);
-  i2c_write_blocking(
-    ssd->i2c_port,
-    ssd->address,
-    ssd->ram_buffer,
-    ssd->bufsize,
-    false
-  );
+  barramento_i2c_esperar(&ssd->frame_transfer);
+  memcpy(ssd->frame_buffer + SSD1306_WINDOW_SIZE, ssd->ram_buffer, ssd->bufsize);
+  ssd1306_submit(&ssd->frame_transfer);
 }
 
 void ssd1306_pixel(ssd1306_t *ssd, uint8_t x, uint8_t y, bool value) {
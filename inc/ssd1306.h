@@ -1,10 +1,18 @@
 #include <stdlib.h>
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "barramento_i2c.h"
 
 #define WIDTH 128
 #define HEIGHT 64
 
+// Comandos por transação em ssd1306_command_list (listas maiores são divididas)
+#define SSD1306_MAX_COMMANDS 32
+// Janela de endereçamento enviada antes de cada quadro: 6 comandos com Co=1
+#define SSD1306_WINDOW_SIZE 12
+// Byte de controle mais as páginas do maior painel aceito (o de WIDTH x HEIGHT)
+#define SSD1306_MAX_BUFSIZE (WIDTH * HEIGHT / 8 + 1)
+
 typedef enum {
   SET_CONTRAST = 0x81,
   SET_ENTIRE_ON = 0xA4,
@@ -31,12 +39,16 @@ typedef struct {
   bool external_vcc;
   uint8_t *ram_buffer;
   size_t bufsize;
-  uint8_t port_buffer[2];
+  // Quadro em envio (janela + ram_buffer): desenhar durante o envio não o altera
+  uint8_t frame_buffer[SSD1306_WINDOW_SIZE + SSD1306_MAX_BUFSIZE];
+  uint8_t command_buffer[1 + SSD1306_MAX_COMMANDS];
+  transacao_i2c_t frame_transfer, command_transfer;
 } ssd1306_t;
 
-void ssd1306_init(ssd1306_t *ssd, uint8_t width, uint8_t height, bool external_vcc, uint8_t address, i2c_inst_t *i2c);
+bool ssd1306_init(ssd1306_t *ssd, uint8_t width, uint8_t height, bool external_vcc, uint8_t address, i2c_inst_t *i2c);
 void ssd1306_config(ssd1306_t *ssd);
 void ssd1306_command(ssd1306_t *ssd, uint8_t command);
+void ssd1306_command_list(ssd1306_t *ssd, const uint8_t *commands, size_t count);
 void ssd1306_send_data(ssd1306_t *ssd);
 
 void ssd1306_pixel(ssd1306_t *ssd, uint8_t x, uint8_t y, bool value);
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <string.h>
+#include "supervisor.h"
+#include "pico/stdlib.h"
+#include "hardware/watchdog.h"
+#include "hardware/sync.h"
+
+#define MAGICA_MEMORIA 0x48495354u      // "HIST"
+
+// Histórico mantido entre reinícios na RAM não inicializada (zerada só
+// quando a soma não confere, como depois de faltar energia)
+typedef struct {
+    uint32_t magica;
+    uint32_t boots;
+    uint32_t reinicios;                         // Reinícios causados por falha
+    uint32_t perdas[SUPERVISOR_MAX_TAREFAS];    // Prazos perdidos por tarefa, acumulado
+    uint32_t num_falhas;                        // Total; o histórico guarda as últimas
+    falha_supervisor_t falhas[SUPERVISOR_HISTORICO];
+    bool falha_pendente;                        // Gravada agora, antes do watchdog_reboot
+    uint32_t soma;                              // FNV-1a dos campos anteriores
+} memoria_supervisor_t;
+
+static memoria_supervisor_t __uninitialized_ram(memoria);
+
+typedef struct {
+    const char *nome;
+    uint32_t orcamento_us;
+    uint32_t maximo_us;        // Maior duração desde o boot
+    uint32_t execucoes;
+} tarefa_supervisionada_t;
+
+static tarefa_supervisionada_t tarefas[SUPERVISOR_MAX_TAREFAS];
+static int num_tarefas;
+static uint32_t (*ler_contexto)(void);
+static uint8_t causa_boot;
+static bool ativo;
+
+// Tarefa em execução, lida pelo alarme de verificação
+static volatile int atual = -1;
+static volatile uint32_t inicio_atual;
+static volatile uint32_t ultima_volta;
+
+static uint32_t fnv1a(const void *dados, size_t tamanho) {
+    const uint8_t *p = dados;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < tamanho; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+static bool memoria_valida(void) {
+    return memoria.magica == MAGICA_MEMORIA && memoria.soma == fnv1a(&memoria, offsetof(memoria_supervisor_t, soma));
+}
+
+static void selar(void) {
+    memoria.soma = fnv1a(&memoria, offsetof(memoria_supervisor_t, soma));
+}
+
+static void registrar_falha(uint8_t causa, int tarefa, uint32_t inicio, uint32_t detectado, uint32_t contexto) {
+    falha_supervisor_t *f = &memoria.falhas[memoria.num_falhas % SUPERVISOR_HISTORICO];
+    memset(f, 0, sizeof(*f));
+    f->causa = causa;
+    f->tarefa = tarefa >= 0 && tarefa < num_tarefas ? (uint8_t)tarefa : SUPERVISOR_NENHUMA;
+    if (f->tarefa != SUPERVISOR_NENHUMA) {
+        strncpy(f->nome, tarefas[tarefa].nome, SUPERVISOR_TAMANHO_NOME - 1);
+        memoria.perdas[tarefa]++;
+    } else {
+        strncpy(f->nome, "laco", SUPERVISOR_TAMANHO_NOME - 1);
+    }
+    f->boot = memoria.boots;
+    f->inicio_us = inicio;
+    f->detectado_us = detectado;
+    f->contexto = contexto;
+    memoria.num_falhas++;
+    memoria.reinicios++;
+}
+
+// Grava a falha e reinicia já; roda no alarme de verificação
+static void falhar(uint8_t causa, int tarefa, uint32_t inicio, uint32_t agora) {
+    uint32_t contexto = tarefa >= 0 ? watchdog_hw->scratch[3] : (ler_contexto ? ler_contexto() : 0);
+    registrar_falha(causa, tarefa, inicio, agora, contexto);
+    memoria.falha_pendente = true;
+    selar();
+    watchdog_reboot(0, 0, 0);
+    while (true) {
+        tight_loop_contents();
+    }
+}
+
+static int64_t verificar(alarm_id_t id, void *dados) {
+    uint32_t agora = time_us_32();
+    int t = atual;
+    if (t >= 0 && agora - inicio_atual > tarefas[t].orcamento_us) {
+        falhar(FALHA_PRAZO, t, inicio_atual, agora);
+    }
+    if (agora - ultima_volta > SUPERVISOR_CICLO_MS * 1000u) {
+        falhar(FALHA_CICLO, -1, ultima_volta, agora);
+    }
+    return SUPERVISOR_VERIFICACAO_MS * 1000;
+}
+
+// Tarefa com orçamento de tempo por execução; retorna o índice (ou -1)
+int supervisor_registrar(const char *nome, uint32_t orcamento_ms) {
+    if (num_tarefas >= SUPERVISOR_MAX_TAREFAS) {
+        return -1;
+    }
+    tarefas[num_tarefas] = (tarefa_supervisionada_t){nome, orcamento_ms * 1000, 0, 0};
+    return num_tarefas++;
+}
+
+// Contexto gravado com a falha que causou este boot; false se o boot não
+// veio do supervisor. Não altera o histórico: pode ser chamada antes de
+// supervisor_iniciar, para restaurar o estado antes de ligar a rede.
+bool supervisor_contexto_anterior(uint32_t *contexto) {
+    if (!memoria_valida()) {
+        return false;
+    }
+    if (memoria.falha_pendente && watchdog_caused_reboot()) {
+        *contexto = memoria.falhas[(memoria.num_falhas - 1) % SUPERVISOR_HISTORICO].contexto;
+        return true;
+    }
+    if (watchdog_enable_caused_reboot() && watchdog_hw->scratch[0] == SUPERVISOR_MAGICA_TRILHA) {
+        *contexto = watchdog_hw->scratch[3];
+        return true;
+    }
+    return false;
+}
+
+// Lê a causa do último reinício, liga o watchdog e o alarme de verificação.
+// Chamar depois de registrar as tarefas, logo antes do laço principal.
+void supervisor_iniciar(uint32_t (*contexto)(void)) {
+    ler_contexto = contexto;
+    if (!memoria_valida()) {
+        memset(&memoria, 0, sizeof(memoria));
+        memoria.magica = MAGICA_MEMORIA;
+    }
+    // Falhas detectadas antes do reinício pertencem ao boot anterior
+    causa_boot = FALHA_NENHUMA;
+    if (memoria.falha_pendente && watchdog_caused_reboot()) {
+        causa_boot = memoria.falhas[(memoria.num_falhas - 1) % SUPERVISOR_HISTORICO].causa;
+    } else if (watchdog_enable_caused_reboot() && watchdog_hw->scratch[0] == SUPERVISOR_MAGICA_TRILHA) {
+        // Nem o alarme rodou: vale a trilha deixada nos registradores de scratch
+        uint32_t tarefa = watchdog_hw->scratch[1];
+        registrar_falha(FALHA_WATCHDOG, tarefa < (uint32_t)num_tarefas ? (int)tarefa : -1, watchdog_hw->scratch[2], 0,
+                        watchdog_hw->scratch[3]);
+        causa_boot = FALHA_WATCHDOG;
+    }
+    memoria.falha_pendente = false;
+    memoria.boots++;
+    selar();
+
+    watchdog_hw->scratch[0] = SUPERVISOR_MAGICA_TRILHA;
+    watchdog_hw->scratch[1] = SUPERVISOR_NENHUMA;
+    ultima_volta = time_us_32();
+    ativo = true;
+    watchdog_enable(SUPERVISOR_WATCHDOG_MS, true);
+    add_alarm_in_ms(SUPERVISOR_VERIFICACAO_MS, verificar, NULL, true);
+}
+
+void supervisor_comecar(int tarefa) {
+    if (tarefa < 0) {
+        return;
+    }
+    uint32_t agora = time_us_32();
+    watchdog_hw->scratch[1] = (uint32_t)tarefa;
+    watchdog_hw->scratch[2] = agora;
+    watchdog_hw->scratch[3] = ler_contexto ? ler_contexto() : 0;
+    inicio_atual = agora;
+    atual = tarefa;
+}
+
+// Fim da execução. Uma tarefa que passou do orçamento mas terminou antes da
+// verificação conta como prazo perdido, sem reinício.
+void supervisor_terminar(int tarefa) {
+    if (tarefa < 0) {
+        return;
+    }
+    uint32_t duracao = time_us_32() - inicio_atual;
+    atual = -1;
+    watchdog_hw->scratch[1] = SUPERVISOR_NENHUMA;
+
+    tarefa_supervisionada_t *t = &tarefas[tarefa];
+    t->execucoes++;
+    if (duracao > t->maximo_us) {
+        t->maximo_us = duracao;
+    }
+    if (duracao > t->orcamento_us && ativo) {
+        uint32_t estado_irq = save_and_disable_interrupts();
+        memoria.perdas[tarefa]++;
+        selar();
+        restore_interrupts(estado_irq);
+    }
+}
+
+// Uma volta do laço principal: alimenta o watchdog
+void supervisor_alimentar(void) {
+    ultima_volta = time_us_32();
+    if (ativo) {
+        watchdog_update();
+    }
+}
+
+static const char *nome_causa(uint8_t causa) {
+    switch (causa) {
+    case FALHA_PRAZO:
+        return "prazo";
+    case FALHA_CICLO:
+        return "ciclo";
+    case FALHA_WATCHDOG:
+        return "watchdog";
+    default:
+        return "normal";
+    }
+}
+
+// Relatório: boots, prazos por tarefa e as últimas falhas
+int supervisor_relatorio(char *buf, size_t tamanho) {
+    int n = snprintf(buf, tamanho, "boots=%lu reinicios=%lu ultimo_boot=%s watchdog_ms=%u\n",
+                     (unsigned long)memoria.boots, (unsigned long)memoria.reinicios, nome_causa(causa_boot),
+                     SUPERVISOR_WATCHDOG_MS);
+    for (int i = 0; i < num_tarefas && n >= 0 && (size_t)n < tamanho; i++) {
+        const tarefa_supervisionada_t *t = &tarefas[i];
+        n += snprintf(buf + n, tamanho - n, "%s orcamento=%lums maximo=%luus execucoes=%lu perdas=%lu\n", t->nome,
+                      (unsigned long)(t->orcamento_us / 1000), (unsigned long)t->maximo_us,
+                      (unsigned long)t->execucoes, (unsigned long)memoria.perdas[i]);
+    }
+
+    // Mais recente primeiro
+    uint32_t guardadas = memoria.num_falhas < SUPERVISOR_HISTORICO ? memoria.num_falhas : SUPERVISOR_HISTORICO;
+    for (uint32_t k = 0; k < guardadas && n >= 0 && (size_t)n < tamanho; k++) {
+        const falha_supervisor_t *f = &memoria.falhas[(memoria.num_falhas - 1 - k) % SUPERVISOR_HISTORICO];
+        n += snprintf(buf + n, tamanho - n,
+                      "falha boot=%lu causa=%s tarefa=%s inicio=%luus detectado=%luus decorrido=%luus contexto=%08lx\n",
+                      (unsigned long)f->boot, nome_causa(f->causa), f->nome, (unsigned long)f->inicio_us,
+                      (unsigned long)f->detectado_us,
+                      (unsigned long)(f->detectado_us ? f->detectado_us - f->inicio_us : 0),
+                      (unsigned long)f->contexto);
+    }
+    return n;
+}
@@ -0,0 +1,57 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Supervisor do laço principal sobre o watchdog do RP2040.
+//
+// Cada tarefa supervisionada (tarefas periódicas e etapas do laço) tem um
+// orçamento de tempo por execução. Um alarme de timer verifica a cada
+// SUPERVISOR_VERIFICACAO_MS a tarefa em execução e o intervalo entre voltas do
+// laço; ao estourar um prazo, grava a falha na RAM não inicializada (mantida
+// no reset) e reinicia a placa pelo watchdog. O watchdog de hardware,
+// alimentado pelo laço, cobre o caso de as interrupções também pararem: a
+// trilha nos registradores de scratch diz qual tarefa estava em execução.
+//
+// Registradores de scratch usados (o SDK usa os de 4 a 7 em watchdog_reboot):
+//   0: SUPERVISOR_MAGICA_TRILHA   1: tarefa em execução (ou SUPERVISOR_NENHUMA)
+//   2: início da tarefa (time_us_32)   3: contexto no início
+#define SUPERVISOR_MAX_TAREFAS 12
+#define SUPERVISOR_HISTORICO 8
+#define SUPERVISOR_TAMANHO_NOME 12
+#define SUPERVISOR_NENHUMA 0xFFu
+#define SUPERVISOR_MAGICA_TRILHA 0x56505553u   // "SUPV"
+
+#define SUPERVISOR_WATCHDOG_MS 4000      // Reinício se o laço e o alarme pararem
+#define SUPERVISOR_VERIFICACAO_MS 100
+#define SUPERVISOR_CICLO_MS 2000         // Intervalo máximo entre voltas do laço
+
+typedef enum {
+    FALHA_NENHUMA,
+    FALHA_PRAZO,       // Tarefa passou do orçamento
+    FALHA_CICLO,       // Laço parado fora de uma tarefa supervisionada
+    FALHA_WATCHDOG,    // Watchdog de hardware (interrupções paradas)
+} causa_falha_t;
+
+// Falha registrada antes do reinício
+typedef struct {
+    uint8_t causa;
+    uint8_t tarefa;
+    char nome[SUPERVISOR_TAMANHO_NOME];
+    uint32_t boot;             // Número do boot em que ocorreu
+    uint32_t inicio_us;        // Início da tarefa (ou última volta do laço)
+    uint32_t detectado_us;     // Momento da detecção (0 se pelo watchdog)
+    uint32_t contexto;
+} falha_supervisor_t;
+
+int supervisor_registrar(const char *nome, uint32_t orcamento_ms);
+bool supervisor_contexto_anterior(uint32_t *contexto);
+void supervisor_iniciar(uint32_t (*contexto)(void));
+void supervisor_comecar(int tarefa);
+void supervisor_terminar(int tarefa);
+void supervisor_alimentar(void);
+int supervisor_relatorio(char *buf, size_t tamanho);
+
+#endif
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""
+Compara o tamanho do firmware entre duas revisões do git.
+
+Compila cada revisão numa árvore de trabalho temporária (git worktree) com o
+mesmo SDK da Pico e mostra o arm-none-eabi-size das duas ELF, seção a seção,
+como tabela Markdown pronta para o README ou para a mensagem de commit.
+
+Exemplos:
+  comparar_tamanho.py ec4c793~1 ec4c793        # ponto fixo (antes/depois)
+  comparar_tamanho.py HEAD~1                   # depois = árvore atual
+  comparar_tamanho.py v1 v2 --sdk ~/pico-sdk --manter
+
+Precisa de PICO_SDK_PATH (ou --sdk), cmake e arm-none-eabi-size no PATH.
+"""
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+ALVO = 'Projeto_webserver'
+RAIZ = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def compilar(fonte, destino, sdk):
+    subprocess.run(['cmake', '-S', fonte, '-B', destino, '-DPICO_SDK_PATH=' + sdk],
+                   check=True, stdout=subprocess.DEVNULL)
+    subprocess.run(['cmake', '--build', destino, '--target', ALVO, '-j', str(os.cpu_count() or 1)],
+                   check=True, stdout=subprocess.DEVNULL)
+    return os.path.join(destino, ALVO + '.elf')
+
+
+def tamanho(elf):
+    # Formato Berkeley: text data bss dec hex nome
+    saida = subprocess.run(['arm-none-eabi-size', elf], check=True, capture_output=True, text=True).stdout
+    campos = saida.splitlines()[1].split()
+    text, data, bss = (int(c) for c in campos[:3])
+    # Flash = código e constantes + valores iniciais das variáveis
+    return {'text': text, 'data': data, 'bss': bss, 'flash': text + data, 'ram': data + bss}
+
+
+def revisao(ref, temporario, sdk):
+    if ref is None:
+        fonte = RAIZ
+    else:
+        fonte = os.path.join(temporario, 'fonte-' + ref.replace('/', '_').replace('~', '_'))
+        subprocess.run(['git', '-C', RAIZ, 'worktree', 'add', '--detach', fonte, ref],
+                       check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    destino = os.path.join(temporario, 'build-' + os.path.basename(fonte))
+    return tamanho(compilar(fonte, destino, sdk))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Tamanho do firmware entre duas revisões')
+    parser.add_argument('antes', help='revisão de referência')
+    parser.add_argument('depois', nargs='?', help='revisão comparada (padrão: árvore atual)')
+    parser.add_argument('--sdk', default=os.environ.get('PICO_SDK_PATH'), help='caminho do pico-sdk')
+    parser.add_argument('--manter', action='store_true', help='não apaga as compilações temporárias')
+    args = parser.parse_args()
+    if not args.sdk:
+        sys.exit('defina PICO_SDK_PATH ou use --sdk')
+
+    temporario = tempfile.mkdtemp(prefix='tamanho-')
+    try:
+        antes = revisao(args.antes, temporario, args.sdk)
+        depois = revisao(args.depois, temporario, args.sdk)
+    finally:
+        if not args.manter:
+            for nome in os.listdir(temporario):
+                if nome.startswith('fonte-'):
+                    subprocess.run(['git', '-C', RAIZ, 'worktree', 'remove', '--force',
+                                    os.path.join(temporario, nome)], check=False)
+            shutil.rmtree(temporario, ignore_errors=True)
+
+    print('| seção | %s | %s | diferença |' % (args.antes, args.depois or 'atual'))
+    print('|---|---:|---:|---:|')
+    for secao in ('text', 'data', 'bss', 'flash', 'ram'):
+        print('| %s | %d | %d | %+d |' % (secao, antes[secao], depois[secao], depois[secao] - antes[secao]))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""
+Cliente do protocolo de controle UDP (inc/controle_udp.h) e medidor de
+latência.
+
+Consulta a sessão atual, envia lotes de operações e mede o tempo de ida e
+volta até a confirmação, que traz a palavra de estados resultante.
+
+Exemplos:
+  controle_udp.py 192.168.0.50 --chave 0123456789abcdef consulta
+  controle_udp.py 192.168.0.50 --chave ... ligar:sala,cozinha alternar:tv
+  controle_udp.py 192.168.0.50 --chave ... --repetir 200 alternar:sala
+  controle_udp.py 192.168.0.50 --chave ... --repetir 50 --em-rajada 5 alternar:quarto
+
+Operações: ligar, desligar, alternar. Dispositivos: sala, cozinha, quarto,
+banheiro, quintal, tv, alarme (bits de estado_palavra()).
+"""
+
+import argparse
+import socket
+import statistics
+import struct
+import sys
+import time
+
+PORTA = 4210
+VERSAO = 1
+CONSULTA, COMANDOS = 0, 1
+OPERACOES = {'ligar': 1, 'desligar': 2, 'alternar': 3}
+DISPOSITIVOS = ['sala', 'cozinha', 'quarto', 'banheiro', 'quintal', 'tv', 'alarme', 'acionado']
+STATUS = {0: 'ok', 1: 'sessao_invalida', 2: 'repetido', 3: 'fila_cheia'}
+MASCARA_64 = (1 << 64) - 1
+
+
+def _rotl(x, b):
+    return ((x << b) | (x >> (64 - b))) & MASCARA_64
+
+
+def siphash24(chave, dados):
+    k0, k1 = struct.unpack('<QQ', chave)
+    v = [0x736f6d6570736575 ^ k0, 0x646f72616e646f6d ^ k1,
+         0x6c7967656e657261 ^ k0, 0x7465646279746573 ^ k1]
+
+    def rodada():
+        v[0] = (v[0] + v[1]) & MASCARA_64; v[1] = _rotl(v[1], 13); v[1] ^= v[0]; v[0] = _rotl(v[0], 32)
+        v[2] = (v[2] + v[3]) & MASCARA_64; v[3] = _rotl(v[3], 16); v[3] ^= v[2]
+        v[0] = (v[0] + v[3]) & MASCARA_64; v[3] = _rotl(v[3], 21); v[3] ^= v[0]
+        v[2] = (v[2] + v[1]) & MASCARA_64; v[1] = _rotl(v[1], 17); v[1] ^= v[2]; v[2] = _rotl(v[2], 32)
+
+    completos = len(dados) & ~7
+    for i in range(0, completos, 8):
+        m, = struct.unpack_from('<Q', dados, i)
+        v[3] ^= m
+        rodada(); rodada()
+        v[0] ^= m
+    b = (len(dados) & 0xFF) << 56
+    for i, byte in enumerate(dados[completos:]):
+        b |= byte << (8 * i)
+    v[3] ^= b
+    rodada(); rodada()
+    v[0] ^= b
+    v[2] ^= 0xFF
+    for _ in range(4):
+        rodada()
+    return v[0] ^ v[1] ^ v[2] ^ v[3]
+
+
+def assinar(chave, corpo):
+    return corpo + struct.pack('<Q', siphash24(chave, corpo))
+
+
+def montar(chave, tipo, sessao, seq, operacoes):
+    corpo = b'LC' + struct.pack('<BBIIB', VERSAO, tipo, sessao, seq, len(operacoes))
+    for operacao, mascara in operacoes:
+        corpo += struct.pack('<BB', operacao, mascara)
+    return assinar(chave, corpo)
+
+
+def ler_resposta(chave, dados):
+    if len(dados) != 28 or dados[:2] != b'LC':
+        raise ValueError('resposta malformada')
+    if struct.unpack('<Q', dados[20:])[0] != siphash24(chave, dados[:20]):
+        raise ValueError('MAC da resposta inválido')
+    _, tipo, sessao, seq, status, operacoes, _, estado = struct.unpack('<BBIIBBHI', dados[2:20])
+    return {'tipo': tipo & 0x7F, 'sessao': sessao, 'seq': seq, 'status': status,
+            'operacoes': operacoes, 'estado': estado}
+
+
+def ler_operacao(texto):
+    nome, _, alvos = texto.partition(':')
+    if nome not in OPERACOES or not alvos:
+        raise argparse.ArgumentTypeError('use operacao:disp1,disp2 (%s)' % texto)
+    mascara = 0
+    for alvo in alvos.split(','):
+        if alvo not in DISPOSITIVOS[:7]:
+            raise argparse.ArgumentTypeError('dispositivo desconhecido: %s' % alvo)
+        mascara |= 1 << DISPOSITIVOS.index(alvo)
+    return OPERACOES[nome], mascara
+
+
+def descrever(estado):
+    ligados = [nome for i, nome in enumerate(DISPOSITIVOS) if estado & (1 << i)]
+    return '0x%02x (%s)' % (estado, ', '.join(ligados) or 'nada ligado')
+
+
+class Cliente:
+    def __init__(self, host, porta, chave, espera):
+        self.destino = (host, porta)
+        self.chave = chave
+        self.socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.socket.settimeout(espera)
+        self.sessao = 0
+        self.seq = 0
+
+    def trocar(self, datagrama, seq, tentativas=3):
+        for _ in range(tentativas):
+            inicio = time.perf_counter()
+            self.socket.sendto(datagrama, self.destino)
+            while True:
+                try:
+                    dados, _ = self.socket.recvfrom(64)
+                except socket.timeout:
+                    break
+                resposta = ler_resposta(self.chave, dados)
+                if resposta['seq'] == seq or resposta['tipo'] == CONSULTA:
+                    return resposta, time.perf_counter() - inicio
+        raise TimeoutError('sem resposta de %s:%d' % self.destino)
+
+    def consultar(self):
+        resposta, _ = self.trocar(montar(self.chave, CONSULTA, 0, 0, []), None)
+        self.sessao = resposta['sessao']
+        self.seq = resposta['seq']
+        return resposta
+
+    def enviar(self, operacoes):
+        self.seq += 1
+        datagrama = montar(self.chave, COMANDOS, self.sessao, self.seq, operacoes)
+        resposta, rtt = self.trocar(datagrama, self.seq)
+        if resposta['status'] == 1:
+            # Dispositivo reiniciado: nova sessão
+            self.consultar()
+            return self.enviar(operacoes)
+        return resposta, rtt
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Cliente do controle UDP')
+    parser.add_argument('host')
+    parser.add_argument('operacoes', nargs='*', help="'consulta' ou operacao:disp1,disp2")
+    parser.add_argument('--porta', type=int, default=PORTA)
+    parser.add_argument('--chave', required=True, help='chave de 16 bytes (CHAVE_CONTROLE)')
+    parser.add_argument('--repetir', type=int, default=1, help='lotes enviados para medir latência')
+    parser.add_argument('--em-rajada', type=int, default=1,
+                        help='repete as operações N vezes no mesmo datagrama')
+    parser.add_argument('--intervalo', type=float, default=0.0, help='pausa entre lotes (s)')
+    parser.add_argument('--espera', type=float, default=0.5, help='tempo de espera da resposta (s)')
+    args = parser.parse_args()
+
+    chave = args.chave.encode()
+    if len(chave) != 16:
+        parser.error('a chave precisa ter 16 bytes')
+
+    cliente = Cliente(args.host, args.porta, chave, args.espera)
+    consulta = cliente.consultar()
+    print('sessao=%08x seq=%d estado=%s' % (consulta['sessao'], consulta['seq'], descrever(consulta['estado'])))
+    if not args.operacoes or args.operacoes == ['consulta']:
+        return 0
+
+    operacoes = [ler_operacao(o) for o in args.operacoes] * args.em_rajada
+    if len(operacoes) > 16:
+        parser.error('no máximo 16 operações por datagrama')
+
+    tempos = []
+    contagem = {}
+    for _ in range(args.repetir):
+        resposta, rtt = cliente.enviar(operacoes)
+        tempos.append(rtt * 1000)
+        nome = STATUS.get(resposta['status'], str(resposta['status']))
+        contagem[nome] = contagem.get(nome, 0) + 1
+        if args.repetir == 1:
+            print('%s seq=%d estado=%s rtt=%.2f ms' % (nome, resposta['seq'], descrever(resposta['estado']), rtt * 1000))
+        if args.intervalo:
+            time.sleep(args.intervalo)
+
+    if args.repetir > 1:
+        tempos.sort()
+        def percentil(p):
+            return tempos[min(len(tempos) - 1, int(p * len(tempos)))]
+        print('lotes=%d operacoes_por_lote=%d %s' % (len(tempos), len(operacoes),
+              ' '.join('%s=%d' % item for item in sorted(contagem.items()))))
+        print('rtt_ms p50=%.2f p90=%.2f p99=%.2f max=%.2f media=%.2f' % (
+            percentil(0.5), percentil(0.9), percentil(0.99), tempos[-1], statistics.mean(tempos)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
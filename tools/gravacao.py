@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""
+Extrai gravações de entradas do firmware (inc/gravacao.h) do log do stdio USB
+e mostra o seu conteúdo.
+
+O firmware envia a gravação em linhas "@GRV <posicao> <base64>" misturadas ao
+resto do log; posicao é o deslocamento do primeiro byte da linha no fluxo, e
+posição 0 começa uma gravação nova.
+
+Uso:
+  gravacao.py extrair log.txt -o sessao.grv     junta as linhas num arquivo
+  gravacao.py extrair /dev/ttyACM0 -o sessao.grv
+                                                lê da porta até Ctrl-C
+  gravacao.py listar sessao.grv                 mostra os registros
+
+Com várias gravações no log, a segunda em diante vai para sessao-2.grv,
+sessao-3.grv etc. O arquivo resultante é a entrada de bench/reproduzir.
+"""
+
+import argparse
+import base64
+import os
+import re
+import stat
+import sys
+
+VERSAO = 1
+CABECALHO, ECO, ADC, NIVEL, BORDA = 0x01, 0x10, 0x11, 0x12, 0x13
+TCP_ABRIR, TCP_DADOS, TCP_FECHAR, UDP_DADOS, UDP_SESSAO, PERDA, FIM = 0x20, 0x21, 0x22, 0x23, 0x24, 0x30, 0x3F
+
+LINHA = re.compile(r'@GRV (\d+) ([A-Za-z0-9+/=]+)\s*$')
+
+
+class ErroGravacao(Exception):
+    pass
+
+
+def varint(dados, pos):
+    valor = deslocamento = 0
+    while True:
+        if pos >= len(dados) or deslocamento > 28:
+            raise ErroGravacao('varint truncado no byte %d' % pos)
+        b = dados[pos]
+        pos += 1
+        valor |= (b & 0x7F) << deslocamento
+        if not b & 0x80:
+            return valor, pos
+        deslocamento += 7
+
+
+def registros(dados):
+    """Gera (t_us, tipo, campos) com t_us relativo ao início da gravação."""
+    pos = 0
+    t = 0
+    while pos < len(dados):
+        inicio = pos
+        tipo = dados[pos]
+        dt, pos = varint(dados, pos + 1)
+        t += dt
+        try:
+            if tipo == CABECALHO:
+                versao = dados[pos]
+                estado, pos = varint(dados, pos + 1)
+                inicio_us = int.from_bytes(dados[pos:pos + 4], 'little')
+                pos += 4
+                t = 0
+                campos = {'versao': versao, 'estado': '0x%x' % estado, 'inicio_us': inicio_us}
+            elif tipo in (ECO, ADC):
+                id_, (valor, pos) = dados[pos], varint(dados, pos + 1)
+                campos = {'pino' if tipo == ECO else 'canal': id_, 'pulso_us' if tipo == ECO else 'valor': valor}
+            elif tipo == NIVEL:
+                campos = {'pino': dados[pos], 'nivel': dados[pos + 1]}
+                pos += 2
+            elif tipo == BORDA:
+                campos = {'pino': dados[pos], 'eventos': '0x%x' % dados[pos + 1], 'nivel': dados[pos + 2]}
+                pos += 3
+            elif tipo in (TCP_ABRIR, TCP_FECHAR):
+                conexao, pos = varint(dados, pos)
+                campos = {'conexao': conexao}
+            elif tipo in (TCP_DADOS, UDP_DADOS):
+                id_, pos = varint(dados, pos)
+                tamanho, pos = varint(dados, pos)
+                if pos + tamanho > len(dados):
+                    raise IndexError
+                campos = {'conexao' if tipo == TCP_DADOS else 'porta': id_, 'dados': bytes(dados[pos:pos + tamanho])}
+                pos += tamanho
+            elif tipo == UDP_SESSAO:
+                if pos + 4 > len(dados):
+                    raise IndexError
+                campos = {'sessao': '%08x' % int.from_bytes(dados[pos:pos + 4], 'little')}
+                pos += 4
+            elif tipo == PERDA:
+                bytes_, pos = varint(dados, pos)
+                campos = {'bytes': bytes_}
+            elif tipo == FIM:
+                campos = {}
+            else:
+                raise ErroGravacao('tipo 0x%02x desconhecido no byte %d' % (tipo, inicio))
+        except IndexError:
+            raise ErroGravacao('registro truncado no byte %d' % inicio)
+        yield t, tipo, campos
+        if tipo == FIM:
+            return
+
+
+NOMES = {CABECALHO: 'cabecalho', ECO: 'eco', ADC: 'adc', NIVEL: 'nivel', BORDA: 'borda',
+         TCP_ABRIR: 'tcp_abrir', TCP_DADOS: 'tcp_dados', TCP_FECHAR: 'tcp_fechar',
+         UDP_DADOS: 'udp_dados', UDP_SESSAO: 'udp_sessao', PERDA: 'perda', FIM: 'fim'}
+
+
+def linhas_da_entrada(caminho):
+    if caminho == '-':
+        yield from sys.stdin
+        return
+    porta = stat.S_ISCHR(os.stat(caminho).st_mode)
+    with open(caminho, 'rb', buffering=0) as f:
+        if porta:
+            print('lendo de %s (Ctrl-C encerra)' % caminho, file=sys.stderr)
+        pendente = b''
+        try:
+            while True:
+                bloco = f.read(4096) if not porta else f.read(1)
+                if not bloco:
+                    break
+                pendente += bloco
+                *prontas, pendente = pendente.split(b'\n')
+                for linha in prontas:
+                    yield linha.decode('ascii', 'replace')
+        except KeyboardInterrupt:
+            pass
+        if pendente:
+            yield pendente.decode('ascii', 'replace')
+
+
+def extrair(args):
+    gravacoes = []
+    atual = None
+    for linha in linhas_da_entrada(args.entrada):
+        m = LINHA.search(linha)
+        if not m:
+            continue
+        posicao = int(m.group(1))
+        try:
+            dados = base64.b64decode(m.group(2), validate=True)
+        except ValueError:
+            print('linha corrompida na posição %d ignorada' % posicao, file=sys.stderr)
+            continue
+        if posicao == 0:
+            atual = {'dados': bytearray(), 'lacuna': None}
+            gravacoes.append(atual)
+        if atual is None or atual['lacuna'] is not None:
+            continue
+        esperado = len(atual['dados'])
+        if posicao > esperado:
+            # O resto não pode ser decodificado sem os bytes que faltam
+            atual['lacuna'] = (esperado, posicao - esperado)
+            continue
+        atual['dados'] += dados[esperado - posicao:]
+
+    if not gravacoes:
+        print('nenhuma gravação encontrada', file=sys.stderr)
+        return 1
+    base, extensao = os.path.splitext(args.saida)
+    for i, gravacao in enumerate(gravacoes, 1):
+        caminho = args.saida if i == 1 else '%s-%d%s' % (base, i, extensao)
+        with open(caminho, 'wb') as f:
+            f.write(gravacao['dados'])
+        situacao = 'completa' if _terminada(gravacao['dados']) else 'sem GRAV_FIM'
+        if gravacao['lacuna']:
+            situacao = 'truncada: faltam %d bytes na posição %d' % (gravacao['lacuna'][1], gravacao['lacuna'][0])
+        print('%s: %d bytes, %s' % (caminho, len(gravacao['dados']), situacao), file=sys.stderr)
+    return 0
+
+
+def _terminada(dados):
+    try:
+        return any(tipo == FIM for _, tipo, _ in registros(dados))
+    except ErroGravacao:
+        return False
+
+
+def listar(args):
+    with open(args.arquivo, 'rb') as f:
+        dados = f.read()
+    contagem = {}
+    try:
+        for t, tipo, campos in registros(dados):
+            contagem[NOMES[tipo]] = contagem.get(NOMES[tipo], 0) + 1
+            if args.resumo:
+                continue
+            texto = ' '.join('%s=%s' % (k, v if k != 'dados' else repr(v[:60])) for k, v in campos.items())
+            print('%10.3f ms  %-10s %s' % (t / 1000, NOMES[tipo], texto))
+    except ErroGravacao as erro:
+        print('%s: %s' % (args.arquivo, erro), file=sys.stderr)
+        return 1
+    print(' '.join('%s=%d' % item for item in sorted(contagem.items())), file=sys.stderr)
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Gravações de entradas do firmware')
+    sub = parser.add_subparsers(dest='comando', required=True)
+    p = sub.add_parser('extrair', help='junta as linhas @GRV de um log ou porta serial')
+    p.add_argument('entrada', help='log, porta serial ou - para a entrada padrão')
+    p.add_argument('-o', '--saida', required=True, help='arquivo .grv')
+    p.set_defaults(funcao=extrair)
+    p = sub.add_parser('listar', help='mostra os registros de um arquivo .grv')
+    p.add_argument('arquivo')
+    p.add_argument('--resumo', action='store_true', help='só a contagem por tipo')
+    p.set_defaults(funcao=listar)
+    args = parser.parse_args()
+    return args.funcao(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+Gera a imagem fsdata (fsdata_custom.c) usada pelo fs.c do lwIP a partir de um
+diretório com a interface web.
+
+- Arquivos estáticos (HTML, CSS, JS, ...) são comprimidos com gzip e gravados
+  com o cabeçalho HTTP completo (Content-Encoding, Content-Length, ETag e
+  Cache-Control), prontos para serem enviados direto da flash.
+- Arquivos .shtml/.shtm/.ssi ficam sem compressão e sem cabeçalho, marcados
+  com FS_FILE_FLAGS_SSI: o firmware substitui as tags <!--#tag--> e monta o
+  cabeçalho a cada requisição.
+
+Uso: makefsdata.py <diretorio_web> <saida.c>
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+TIPOS = {
+    '.html': 'text/html; charset=utf-8',
+    '.htm': 'text/html; charset=utf-8',
+    '.shtml': 'text/html; charset=utf-8',
+    '.shtm': 'text/html; charset=utf-8',
+    '.ssi': 'text/html; charset=utf-8',
+    '.css': 'text/css',
+    '.js': 'application/javascript',
+    '.json': 'application/json',
+    '.svg': 'image/svg+xml',
+    '.png': 'image/png',
+    '.ico': 'image/x-icon',
+    '.txt': 'text/plain',
+}
+EXTENSOES_SSI = ('.shtml', '.shtm', '.ssi')
+CACHE_CONTROL = 'public, max-age=86400'
+
+
+def cabecalho(tipo, corpo, etag, comprimido):
+    linhas = ['HTTP/1.1 200 OK', 'Content-Type: ' + tipo]
+    if comprimido:
+        linhas.append('Content-Encoding: gzip')
+        linhas.append('Vary: Accept-Encoding')
+    linhas.append('Content-Length: %d' % len(corpo))
+    linhas.append('Cache-Control: ' + CACHE_CONTROL)
+    linhas.append('ETag: "%s"' % etag)
+    return ('\r\n'.join(linhas) + '\r\n\r\n').encode('ascii')
+
+
+def identificador(nome):
+    return 'file_' + re.sub(r'[^A-Za-z0-9]', '_', nome)
+
+
+def bytes_c(dados):
+    linhas = []
+    for i in range(0, len(dados), 16):
+        linhas.append(''.join('0x%02x,' % b for b in dados[i:i + 16]))
+    return '\n'.join(linhas)
+
+
+def gerar(diretorio, saida):
+    arquivos = []
+    for raiz, _, nomes in os.walk(diretorio):
+        for nome in nomes:
+            caminho = os.path.join(raiz, nome)
+            url = '/' + os.path.relpath(caminho, diretorio).replace(os.sep, '/')
+            arquivos.append((url, caminho))
+    arquivos.sort()
+
+    blocos = []
+    anterior = 'file_NULL'
+    total_original = 0
+    total_gravado = 0
+    for url, caminho in arquivos:
+        with open(caminho, 'rb') as f:
+            original = f.read()
+        ext = os.path.splitext(url)[1].lower()
+        tipo = TIPOS.get(ext, 'application/octet-stream')
+        nome = url.encode('ascii') + b'\0'
+        ident = identificador(url)
+
+        if ext in EXTENSOES_SSI:
+            conteudo = original
+            flags = 'FS_FILE_FLAGS_SSI'
+        else:
+            comprimido = gzip.compress(original, compresslevel=9, mtime=0)
+            usar_gzip = len(comprimido) < len(original)
+            corpo = comprimido if usar_gzip else original
+            etag = hashlib.sha1(original).hexdigest()[:16]
+            conteudo = cabecalho(tipo, corpo, etag, usar_gzip) + corpo
+            flags = ('FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_HEADER_PERSISTENT | '
+                     'FS_FILE_FLAGS_HEADER_HTTPVER_1_1')
+
+        total_original += len(original)
+        total_gravado += len(conteudo)
+        blocos.append(
+            '/* %s: %d bytes, %d gravados */\n'
+            'static const unsigned char FSDATA_ALIGN_PRE data_%s[] FSDATA_ALIGN_POST = {\n'
+            '%s\n%s\n};\n\n'
+            'const struct fsdata_file %s[] = {{\n'
+            '    %s,\n'
+            '    data_%s,\n'
+            '    data_%s + %d,\n'
+            '    sizeof(data_%s) - %d,\n'
+            '    %s\n'
+            '}};\n'
+            % (url, len(original), len(conteudo), ident, bytes_c(nome), bytes_c(conteudo),
+               ident, anterior, ident, ident, len(nome), ident, len(nome), flags))
+        anterior = ident
+
+    with open(saida, 'w', newline='\n') as f:
+        f.write('/* Gerado por tools/makefsdata.py a partir de %s. Não editar. */\n\n'
+                % os.path.basename(os.path.normpath(diretorio)))
+        f.write('#include "lwip/apps/fs.h"\n#include "lwip/def.h"\n\n')
+        f.write('#define file_NULL (struct fsdata_file *) NULL\n\n')
+        f.write('#ifndef FSDATA_ALIGN_PRE\n#define FSDATA_ALIGN_PRE\n#endif\n')
+        f.write('#ifndef FSDATA_ALIGN_POST\n#define FSDATA_ALIGN_POST\n#endif\n\n')
+        f.write('\n'.join(blocos))
+        f.write('\n#define FS_ROOT %s\n#define FS_NUMFILES %d\n' % (anterior, len(arquivos)))
+
+    print('makefsdata: %d arquivos, %d bytes -> %d bytes em flash'
+          % (len(arquivos), total_original, total_gravado))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        sys.exit('uso: makefsdata.py <diretorio_web> <saida.c>')
+    gerar(sys.argv[1], sys.argv[2])
@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+"""
+Compila regras de automação para o bytecode do motor de regras (inc/regras.h)
+e as envia ao firmware.
+
+Arquivo de regras, uma por linha (# inicia comentário):
+
+  <saida> <seguir|acionar>: <condicao>
+
+  luz_frente seguir: escuro && dist_frente < 15
+  alarme acionar: alarme && (eixo_x < 1800 || eixo_x > 2200 || dist_alarme < 15)
+
+A condição usa as entradas do firmware, constantes inteiras (-32768..32767),
+os comparadores < > <= >= == != e os operadores ! && || com parênteses.
+Uma entrada sozinha vale como verdadeira quando diferente de zero.
+
+Uso:
+  regras.py <arquivo> --host 192.168.0.50      compila e carrega no firmware
+  regras.py <arquivo> --hex                    só mostra a tabela em hexadecimal
+
+Os nomes de entradas e saídas são lidos de GET /regras; com --hex e sem
+--host, valem os nomes padrão do firmware.
+"""
+
+import argparse
+import re
+import struct
+import sys
+import urllib.error
+import urllib.request
+
+VERSAO = 1
+OP_ENTRADA, OP_CONST = 0x01, 0x02
+OP_MENOR, OP_MAIOR, OP_IGUAL, OP_NAO = 0x10, 0x11, 0x12, 0x13
+OP_SE_FALSO, OP_SE_VERDADEIRO = 0x20, 0x21
+MODOS = {'seguir': 0, 'acionar': 1}
+MAX_REGRAS = 8
+TAMANHO_TABELA = 192
+PILHA = 8
+
+ENTRADAS_PADRAO = ['escuro', 'dist_frente', 'dist_alarme', 'eixo_x', 'eixo_y', 'alarme']
+SAIDAS_PADRAO = ['luz_frente', 'alarme']
+
+TOKEN = re.compile(r'\s*(?:(\d+)|([A-Za-z_]\w*)|(&&|\|\||<=|>=|==|!=|[<>!()-]))')
+
+
+class ErroRegra(Exception):
+    pass
+
+
+def tokens(texto):
+    pos = 0
+    saida = []
+    texto = texto.rstrip()
+    while pos < len(texto):
+        m = TOKEN.match(texto, pos)
+        if not m:
+            raise ErroRegra('símbolo inesperado em "%s"' % texto[pos:])
+        numero, nome, operador = m.groups()
+        saida.append(('num', int(numero)) if numero else ('nome', nome) if nome else ('op', operador))
+        pos = m.end()
+    return saida
+
+
+class Compilador:
+    """Descida recursiva; cada nível devolve o bytecode da subexpressão."""
+
+    def __init__(self, texto, entradas):
+        self.itens = tokens(texto)
+        self.pos = 0
+        self.entradas = entradas
+
+    def espiar(self):
+        return self.itens[self.pos] if self.pos < len(self.itens) else (None, None)
+
+    def consumir(self, valor=None):
+        item = self.espiar()
+        if item[0] is None or (valor is not None and item[1] != valor):
+            raise ErroRegra('esperado "%s"' % (valor or 'expressão'))
+        self.pos += 1
+        return item
+
+    def compilar(self):
+        codigo = self.ou()
+        if self.espiar()[0] is not None:
+            raise ErroRegra('sobrou "%s"' % self.espiar()[1])
+        return codigo
+
+    def encadear(self, operador, salto, proximo):
+        codigo = proximo()
+        while self.espiar() == ('op', operador):
+            self.consumir()
+            direita = proximo()
+            if len(direita) > 255:
+                raise ErroRegra('expressão longa demais para um salto')
+            codigo += bytes([salto, len(direita)]) + direita
+        return codigo
+
+    def ou(self):
+        return self.encadear('||', OP_SE_VERDADEIRO, self.e)
+
+    def e(self):
+        return self.encadear('&&', OP_SE_FALSO, self.unario)
+
+    def unario(self):
+        if self.espiar() == ('op', '!'):
+            self.consumir()
+            return self.unario() + bytes([OP_NAO])
+        return self.comparacao()
+
+    def comparacao(self):
+        codigo = self.termo()
+        tipo, valor = self.espiar()
+        if tipo == 'op' and valor in ('<', '>', '<=', '>=', '==', '!='):
+            self.consumir()
+            codigo += self.termo()
+            codigo += {
+                '<': bytes([OP_MENOR]), '>': bytes([OP_MAIOR]), '==': bytes([OP_IGUAL]),
+                '<=': bytes([OP_MAIOR, OP_NAO]), '>=': bytes([OP_MENOR, OP_NAO]),
+                '!=': bytes([OP_IGUAL, OP_NAO]),
+            }[valor]
+        return codigo
+
+    def termo(self):
+        tipo, valor = self.consumir()
+        if tipo == 'op' and valor == '(':
+            codigo = self.ou()
+            self.consumir(')')
+            return codigo
+        if tipo == 'op' and valor == '-' and self.espiar()[0] == 'num':
+            return self.constante(-self.consumir()[1])
+        if tipo == 'num':
+            return self.constante(valor)
+        if tipo == 'nome':
+            if valor not in self.entradas:
+                raise ErroRegra('entrada desconhecida: %s (entradas: %s)' % (valor, ', '.join(self.entradas)))
+            return bytes([OP_ENTRADA, self.entradas.index(valor)])
+        raise ErroRegra('inesperado "%s"' % valor)
+
+    def constante(self, valor):
+        if not -32768 <= valor <= 32767:
+            raise ErroRegra('constante fora de int16: %d' % valor)
+        return bytes([OP_CONST]) + struct.pack('<h', valor)
+
+
+def profundidade_maxima(codigo):
+    # Limite conservador: conta cada empilhamento sem descontar os saltos
+    nivel = maximo = 0
+    pc = 0
+    while pc < len(codigo):
+        op = codigo[pc]
+        if op in (OP_ENTRADA, OP_CONST):
+            nivel += 1
+            pc += 2 if op == OP_ENTRADA else 3
+        elif op in (OP_MENOR, OP_MAIOR, OP_IGUAL):
+            nivel -= 1
+            pc += 1
+        elif op in (OP_SE_FALSO, OP_SE_VERDADEIRO):
+            nivel -= 1
+            pc += 2
+        else:
+            pc += 1
+        maximo = max(maximo, nivel)
+    return maximo
+
+
+def compilar_arquivo(texto, entradas, saidas):
+    regras = []
+    for numero, linha in enumerate(texto.splitlines(), 1):
+        linha = linha.split('#', 1)[0].strip()
+        if not linha:
+            continue
+        m = re.match(r'(\w+)\s+(\w+)\s*:\s*(.+)$', linha)
+        try:
+            if not m:
+                raise ErroRegra('formato: <saida> <seguir|acionar>: <condicao>')
+            saida, modo, condicao = m.groups()
+            if saida not in saidas:
+                raise ErroRegra('saída desconhecida: %s (saídas: %s)' % (saida, ', '.join(saidas)))
+            if modo not in MODOS:
+                raise ErroRegra('modo desconhecido: %s' % modo)
+            codigo = Compilador(condicao, entradas).compilar()
+            if profundidade_maxima(codigo) > PILHA:
+                raise ErroRegra('expressão excede a pilha de %d níveis' % PILHA)
+        except ErroRegra as erro:
+            raise ErroRegra('linha %d: %s' % (numero, erro))
+        regras.append((saidas.index(saida), MODOS[modo], codigo))
+
+    if len(regras) > MAX_REGRAS:
+        raise ErroRegra('no máximo %d regras' % MAX_REGRAS)
+    if sum(len(c) for _, _, c in regras) > TAMANHO_TABELA:
+        raise ErroRegra('código maior que %d bytes' % TAMANHO_TABELA)
+    tabela = bytes([ord('R'), VERSAO, len(regras)])
+    for saida, modo, codigo in regras:
+        tabela += bytes([saida, modo, len(codigo)]) + codigo
+    return tabela
+
+
+def buscar(host, caminho):
+    with urllib.request.urlopen('http://%s%s' % (host, caminho), timeout=5) as resposta:
+        return resposta.read().decode('utf-8', 'replace')
+
+
+def nomes_do_firmware(host):
+    relatorio = buscar(host, '/regras')
+    campos = dict(linha.split('=', 1) for linha in relatorio.splitlines() if '=' in linha and ' ' not in linha.split('=', 1)[0])
+    entradas = [nome.rstrip('*') for nome in campos['entradas'].split(',')]
+    saidas = campos['saidas'].split(',')
+    return entradas, saidas
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compilador do motor de regras')
+    parser.add_argument('arquivo')
+    parser.add_argument('--host', help='endereço do firmware')
+    parser.add_argument('--hex', action='store_true', help='só mostra a tabela compilada')
+    args = parser.parse_args()
+    if not args.host and not args.hex:
+        parser.error('informe --host ou --hex')
+
+    with open(args.arquivo, encoding='utf-8') as f:
+        texto = f.read()
+    entradas, saidas = (nomes_do_firmware(args.host) if args.host else (ENTRADAS_PADRAO, SAIDAS_PADRAO))
+    try:
+        tabela = compilar_arquivo(texto, entradas, saidas)
+    except ErroRegra as erro:
+        print('%s: %s' % (args.arquivo, erro), file=sys.stderr)
+        return 1
+
+    if args.hex:
+        print(tabela.hex())
+        print('%d bytes' % len(tabela), file=sys.stderr)
+        return 0
+
+    try:
+        buscar(args.host, '/carregar_regras?t=' + tabela.hex())
+    except urllib.error.HTTPError as erro:
+        print('recusado pelo firmware: HTTP %d' % erro.code, file=sys.stderr)
+        return 1
+    print(buscar(args.host, '/regras'), end='')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
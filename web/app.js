@@ -0,0 +1,71 @@
+// Envia os comandos sem recarregar a página inteira: o servidor responde com
+// 303 para "/", e apenas o bloco #estado (campos SSI) é substituído. Nos
+// formulários com vários botões (cenas), o botão clicado vira o parâmetro.
+// Os pedidos saem um de cada vez, na ordem: um comando espera o anterior (ou
+// a atualização em andamento) e nunca é descartado; só a atualização
+// periódica é pulada quando já há algo em andamento.
+(function () {
+  'use strict';
+
+  var INTERVALO_ATUALIZACAO_MS = 5000;
+  var fila = Promise.resolve();
+  var pendentes = 0;
+
+  function substituirEstado(html) {
+    var doc = new DOMParser().parseFromString(html, 'text/html');
+    var novo = doc.getElementById('estado');
+    var atual = document.getElementById('estado');
+    if (novo && atual) {
+      atual.replaceWith(novo);
+    }
+  }
+
+  function buscar(url) {
+    return fetch(url, { cache: 'no-store' })
+      .then(function (resposta) {
+        if (!resposta.ok) {
+          throw new Error('HTTP ' + resposta.status);
+        }
+        return resposta.text();
+      })
+      .then(substituirEstado)
+      .catch(function (erro) {
+        console.warn('Falha ao atualizar:', erro);
+      });
+  }
+
+  function enfileirar(url) {
+    pendentes++;
+    fila = fila.then(function () {
+      return buscar(url);
+    }).then(function () {
+      pendentes--;
+    });
+    return fila;
+  }
+
+  document.addEventListener('submit', function (evento) {
+    var form = evento.target;
+    evento.preventDefault();
+    var botao = evento.submitter || form.querySelector('button');
+    var url = form.getAttribute('action');
+    if (botao && botao.name) {
+      url += '?' + encodeURIComponent(botao.name) + '=' + encodeURIComponent(botao.value);
+    }
+    if (botao) {
+      botao.disabled = true;
+    }
+    enfileirar(url).then(function () {
+      // Botões fora de #estado não são substituídos
+      if (botao) {
+        botao.disabled = false;
+      }
+    });
+  });
+
+  setInterval(function () {
+    if (!document.hidden && pendentes === 0) {
+      enfileirar('/');
+    }
+  }, INTERVALO_ATUALIZACAO_MS);
+})();
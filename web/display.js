@@ -0,0 +1,109 @@
+// Espelho do OLED: lê o fluxo /display/fluxo (quadro-chave seguido de deltas
+// XOR + RLE por página, formato em inc/espelho_display.h) e desenha no canvas.
+(function () {
+  'use strict';
+
+  var LARGURA = 128;
+  var PAGINAS = 8;
+  var CABECALHO = 8;
+  var ESPERA_RECONEXAO_MS = 2000;
+
+  var quadro = new Uint8Array(LARGURA * PAGINAS);
+  var canvas = document.getElementById('oled');
+  var contexto = canvas.getContext('2d');
+  var imagem = contexto.createImageData(LARGURA, PAGINAS * 8);
+  var situacao = document.getElementById('situacao');
+  var recebidos = 0;
+
+  function desenhar() {
+    for (var y = 0; y < PAGINAS * 8; y++) {
+      for (var x = 0; x < LARGURA; x++) {
+        var aceso = (quadro[(y >> 3) * LARGURA + x] >> (y & 7)) & 1;
+        var i = (y * LARGURA + x) * 4;
+        imagem.data[i] = aceso ? 120 : 0;
+        imagem.data[i + 1] = aceso ? 200 : 10;
+        imagem.data[i + 2] = aceso ? 255 : 20;
+        imagem.data[i + 3] = 255;
+      }
+    }
+    contexto.putImageData(imagem, 0, 0);
+  }
+
+  // Aplica os 128 bytes de uma página (XOR), decodificando o RLE
+  function aplicarPagina(dados, pos, pagina) {
+    var x = 0;
+    var base = pagina * LARGURA;
+    while (x < LARGURA) {
+      var controle = dados[pos++];
+      var n;
+      if (controle < 0x80) {
+        for (n = controle + 1; n > 0; n--) {
+          quadro[base + x++] ^= dados[pos++];
+        }
+      } else if (controle < 0xC0) {
+        x += (controle & 0x3F) + 1;
+      } else {
+        var valor = dados[pos++];
+        for (n = (controle & 0x3F) + 1; n > 0; n--) {
+          quadro[base + x++] ^= valor;
+        }
+      }
+    }
+    return pos;
+  }
+
+  function aplicarMensagem(dados) {
+    if (dados[0] === 0) {
+      quadro.fill(0);
+    }
+    var versao = (dados[1] | (dados[2] << 8) | (dados[3] << 16) | (dados[4] << 24)) >>> 0;
+    var mascara = dados[5];
+    var pos = CABECALHO;
+    for (var p = 0; p < PAGINAS; p++) {
+      if (mascara & (1 << p)) {
+        pos = aplicarPagina(dados, pos, p);
+      }
+    }
+    recebidos += dados.length;
+    desenhar();
+    situacao.textContent = 'Versão ' + versao + ' (' + dados.length + ' bytes, total ' + recebidos + ')';
+  }
+
+  // Junta os pedaços recebidos e separa as mensagens pelo tamanho do cabeçalho
+  function ler(leitor, pendente) {
+    return leitor.read().then(function (resultado) {
+      if (resultado.done) {
+        throw new Error('fluxo encerrado');
+      }
+      var dados = new Uint8Array(pendente.length + resultado.value.length);
+      dados.set(pendente);
+      dados.set(resultado.value, pendente.length);
+      while (dados.length >= CABECALHO) {
+        var tamanho = dados[6] | (dados[7] << 8);
+        if (dados.length < tamanho) {
+          break;
+        }
+        aplicarMensagem(dados.subarray(0, tamanho));
+        dados = dados.slice(tamanho);
+      }
+      return ler(leitor, dados);
+    });
+  }
+
+  function conectar() {
+    fetch('/display/fluxo', { cache: 'no-store' })
+      .then(function (resposta) {
+        if (!resposta.ok || !resposta.body) {
+          throw new Error('HTTP ' + resposta.status);
+        }
+        return ler(resposta.body.getReader(), new Uint8Array(0));
+      })
+      .catch(function (erro) {
+        situacao.textContent = 'Reconectando (' + erro.message + ')...';
+        setTimeout(conectar, ESPERA_RECONEXAO_MS);
+      });
+  }
+
+  desenhar();
+  conectar();
+})();